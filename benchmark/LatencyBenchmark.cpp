@@ -0,0 +1,367 @@
+/**
+ * End-to-end latency and loss benchmark.
+ *
+ * Writer threads create, modify, rename and delete files at a target rate
+ * across a directory tree. Every operation is timestamped before the
+ * syscall and matched to the notification that reports it. The time until
+ * the observer runs is the end-to-end latency. Operations without a
+ * notification are reported as lost, notifications without an operation
+ * as extra.
+ *
+ * Usage: ./inotify_latency_benchmark [--directory=PATH] [--threads=N] [--rate=OPS_PER_THREAD]
+ *                                    [--duration=SECONDS] [--depth=N] [--fanout=N] [--mode=NAME]
+ *                                    [--cpu=N]
+ *
+ * --rate=0 runs the writers as fast as possible. Modes are builder, subtree,
+ * name_filter, bounded_queue, busy_poll, static or all. --cpu pins the reader
+ * of the busy_poll mode.
+ */
+#include <inotify-cpp/NotifierBuilder.h>
+#include <inotify-cpp/StaticNotifier.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace inotify;
+
+namespace fs = inotifypp::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    fs::path directory;
+    unsigned threads = 4;
+    unsigned rate = 1000;
+    std::chrono::seconds duration { 5 };
+    unsigned depth = 4;
+    unsigned fanout = 2;
+    std::string mode = "all";
+    int cpu = -1;
+};
+
+struct Result {
+    std::uint64_t operations;
+    std::uint64_t delivered;
+    std::uint64_t lost;
+    std::uint64_t extra;
+    std::uint64_t overflows;
+    std::vector<double> latencies;
+    double seconds;
+};
+
+class LatencyRecorder {
+  public:
+    void expect(const fs::path& path, Event event)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending[{ path.string(), event }].push_back(Clock::now());
+        ++mOperations;
+    }
+
+    void deliver(const Notification& notification)
+    {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (notification.event == Event::q_overflow) {
+            ++mOverflows;
+            return;
+        }
+
+        auto pending = mPending.find({ notification.path.string(), notification.event });
+        if (pending == mPending.end()) {
+            ++mExtra;
+            return;
+        }
+
+        mLatencies.push_back(
+            std::chrono::duration<double, std::micro>(now - pending->second.front()).count());
+        pending->second.pop_front();
+        if (pending->second.empty()) {
+            mPending.erase(pending);
+        }
+    }
+
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::size_t pending = 0;
+        for (auto& operations : mPending) {
+            pending += operations.second.size();
+        }
+        return pending;
+    }
+
+    Result result(double seconds)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::uint64_t lost = 0;
+        for (auto& operations : mPending) {
+            lost += operations.second.size();
+        }
+
+        return Result {
+            mOperations, mLatencies.size(), lost, mExtra, mOverflows, mLatencies, seconds
+        };
+    }
+
+  private:
+    std::mutex mMutex;
+    std::map<std::pair<std::string, Event>, std::deque<Clock::time_point>> mPending;
+    std::vector<double> mLatencies;
+    std::uint64_t mOperations = 0;
+    std::uint64_t mExtra = 0;
+    std::uint64_t mOverflows = 0;
+};
+
+auto parseOptions(int argc, char** argv) -> Options
+{
+    Options options;
+    options.directory
+        = fs::temp_directory_path() / ("inotify-cpp-benchmark-" + std::to_string(getpid()));
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        auto separator = argument.find('=');
+        auto key = argument.substr(0, separator);
+        auto value = separator == std::string::npos ? "" : argument.substr(separator + 1);
+
+        if (key == "--directory") {
+            options.directory = value;
+        } else if (key == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (key == "--rate") {
+            options.rate = std::stoul(value);
+        } else if (key == "--duration") {
+            options.duration = std::chrono::seconds(std::stoul(value));
+        } else if (key == "--depth") {
+            options.depth = std::stoul(value);
+        } else if (key == "--fanout") {
+            options.fanout = std::stoul(value);
+        } else if (key == "--mode") {
+            options.mode = value;
+        } else if (key == "--cpu") {
+            options.cpu = std::stoi(value);
+        } else {
+            std::cout << "Unknown option " << argument << std::endl;
+            exit(1);
+        }
+    }
+
+    return options;
+}
+
+auto createTree(const fs::path& root, unsigned depth, unsigned fanout) -> std::vector<fs::path>
+{
+    std::vector<fs::path> directories { root };
+    fs::create_directories(root);
+
+    for (std::size_t level = 0, begin = 0; level < depth; ++level) {
+        auto end = directories.size();
+        for (auto i = begin; i < end; ++i) {
+            for (unsigned child = 0; child < fanout; ++child) {
+                auto directory = directories[i] / ("d" + std::to_string(child));
+                fs::create_directories(directory);
+                directories.push_back(directory);
+            }
+        }
+        begin = end;
+    }
+
+    return directories;
+}
+
+/**
+ * One cycle per file: create (mknod, no open/close events), modify
+ * (close_write), rename (moved_to) and delete (remove).
+ */
+void writeFiles(
+    unsigned id,
+    const Options& options,
+    const std::vector<fs::path>& directories,
+    LatencyRecorder& recorder)
+{
+    std::mt19937 random(id);
+    std::uniform_int_distribution<std::size_t> pickDirectory(0, directories.size() - 1);
+    auto interval = options.rate ? std::chrono::nanoseconds(1000000000 / options.rate)
+                                 : std::chrono::nanoseconds(0);
+    auto end = Clock::now() + options.duration;
+    auto next = Clock::now();
+    const char data[] = "benchmark";
+
+    auto pace = [&]() {
+        next += interval;
+        std::this_thread::sleep_until(next);
+    };
+
+    for (unsigned n = 0; Clock::now() < end; ++n) {
+        auto& directory = directories[pickDirectory(random)];
+        auto path = directory / ("t" + std::to_string(id) + "-" + std::to_string(n));
+        auto renamed = directory / ("t" + std::to_string(id) + "-" + std::to_string(n) + ".renamed");
+
+        recorder.expect(path, Event::create);
+        mknod(path.c_str(), S_IFREG | 0644, 0);
+        pace();
+
+        recorder.expect(path, Event::close_write);
+        auto fd = open(path.c_str(), O_WRONLY);
+        if (write(fd, data, sizeof(data)) == -1) {
+            std::cout << "Failed to write " << path << std::endl;
+        }
+        close(fd);
+        pace();
+
+        recorder.expect(renamed, Event::moved_to);
+        rename(path.c_str(), renamed.c_str());
+        pace();
+
+        recorder.expect(renamed, Event::remove);
+        unlink(renamed.c_str());
+        pace();
+    }
+}
+
+template <typename Notifier>
+auto measure(Notifier& notifier, const Options& options, const fs::path& root, LatencyRecorder& recorder)
+    -> Result
+{
+    auto directories = createTree(root, options.depth, options.fanout);
+    notifier.watchPathRecursively(root);
+
+    std::thread eventLoop([&notifier]() { notifier.run(); });
+
+    auto start = Clock::now();
+    std::vector<std::thread> writers;
+    for (unsigned id = 0; id < options.threads; ++id) {
+        writers.emplace_back(
+            [&, id]() { writeFiles(id, options, directories, recorder); });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Drain until all operations are matched or nothing arrives anymore
+    auto pending = recorder.pending();
+    for (auto attempts = 0; pending && attempts < 10; ++attempts) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto stillPending = recorder.pending();
+        if (stillPending == pending) {
+            break;
+        }
+        pending = stillPending;
+    }
+
+    notifier.stop();
+    eventLoop.join();
+    return recorder.result(seconds);
+}
+
+auto runMode(const std::string& mode, const Options& options) -> Result
+{
+    auto root = options.directory / mode;
+    LatencyRecorder recorder;
+    auto observer = [&recorder](Notification notification) { recorder.deliver(notification); };
+    std::vector<Event> events { Event::create, Event::close_write, Event::moved_to, Event::remove };
+
+    if (mode == "static") {
+        auto handler = [&recorder](const Notification& notification) {
+            recorder.deliver(notification);
+        };
+        auto notifier = BuildStaticNotifier(
+            on<Event::create>(handler),
+            on<Event::close_write>(handler),
+            on<Event::moved_to>(handler),
+            on<Event::remove>(handler),
+            on<Event::q_overflow>(handler));
+        return measure(notifier, options, root, recorder);
+    }
+
+    auto notifier = BuildNotifier().onEvent(Event::q_overflow, observer);
+    if (mode == "builder") {
+        notifier.onEvents(events, observer);
+    } else if (mode == "subtree") {
+        notifier.onEvents(root, events, observer);
+    } else if (mode == "name_filter") {
+        notifier.setNameFilter(NameFilter().excludeExtension(".tmp").excludeGlob(".*.swp"))
+            .onEvents(events, observer);
+    } else if (mode == "bounded_queue") {
+        notifier.setEventQueueCapacity(1024, QueueOverflowPolicy::drop_oldest)
+            .onEvents(events, observer);
+    } else if (mode == "busy_poll") {
+        BusyPollOptions busyPollOptions;
+        busyPollOptions.cpu = options.cpu;
+        notifier.enableBusyPolling(busyPollOptions).onEvents(events, observer);
+    } else {
+        std::cout << "Unknown mode " << mode << std::endl;
+        exit(1);
+    }
+
+    return measure(notifier, options, root, recorder);
+}
+
+auto percentile(const std::vector<double>& sortedLatencies, double fraction) -> double
+{
+    if (sortedLatencies.empty()) {
+        return 0;
+    }
+
+    auto index = static_cast<std::size_t>(fraction * sortedLatencies.size());
+    return sortedLatencies[std::min(index, sortedLatencies.size() - 1)];
+}
+
+void printResult(const std::string& mode, Result result)
+{
+    std::sort(result.latencies.begin(), result.latencies.end());
+
+    std::cout << std::left << std::setw(15) << mode << std::right << std::setw(10)
+              << result.operations << std::setw(10) << result.delivered << std::setw(8)
+              << result.lost << std::setw(8) << result.extra << std::setw(10) << result.overflows
+              << std::setw(12) << std::fixed << std::setprecision(0)
+              << result.operations / result.seconds << std::setw(10) << std::setprecision(1)
+              << percentile(result.latencies, 0.5) << std::setw(10)
+              << percentile(result.latencies, 0.99) << std::setw(10)
+              << percentile(result.latencies, 0.999) << std::endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+    auto options = parseOptions(argc, argv);
+    std::vector<std::string> modes {
+        "builder", "subtree", "name_filter", "bounded_queue", "busy_poll", "static"
+    };
+    if (options.mode != "all") {
+        modes = { options.mode };
+    }
+
+    std::cout << std::left << std::setw(15) << "mode" << std::right << std::setw(10) << "ops"
+              << std::setw(10) << "delivered" << std::setw(8) << "lost" << std::setw(8) << "extra"
+              << std::setw(10) << "overflows" << std::setw(12) << "ops/s" << std::setw(10)
+              << "p50[us]" << std::setw(10) << "p99[us]" << std::setw(10) << "p999[us]"
+              << std::endl;
+
+    for (auto& mode : modes) {
+        printResult(mode, runMode(mode, options));
+    }
+
+    fs::remove_all(options.directory);
+    return 0;
+}
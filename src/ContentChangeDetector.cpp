@@ -0,0 +1,313 @@
+#include <inotify-cpp/ContentChangeDetector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace inotify {
+
+namespace {
+
+const std::uint64_t prime1 = 11400714785074694791ULL;
+const std::uint64_t prime2 = 14029467366897019727ULL;
+const std::uint64_t prime3 = 1609587929392839161ULL;
+const std::uint64_t prime4 = 9650029242287828579ULL;
+const std::uint64_t prime5 = 2870177450012600261ULL;
+
+std::uint64_t rotl(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t read64(const std::uint8_t* data)
+{
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+std::uint32_t read32(const std::uint8_t* data)
+{
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+std::uint64_t round(std::uint64_t accumulator, std::uint64_t input)
+{
+    accumulator += input * prime2;
+    accumulator = rotl(accumulator, 31);
+    return accumulator * prime1;
+}
+
+std::uint64_t mergeRound(std::uint64_t accumulator, std::uint64_t value)
+{
+    accumulator ^= round(0, value);
+    return accumulator * prime1 + prime4;
+}
+}
+
+ContentChangeDetector::ContentChangeDetector(
+    EventObserver changedObserver, EventObserver unchangedObserver, ContentChangeOptions options)
+    : mChangedObserver(changedObserver)
+    , mUnchangedObserver(unchangedObserver)
+    , mOptions(options)
+    , mStatistics { 0, 0, 0, 0, 0, 0, 0 }
+{
+    mOptions.chunkSize = std::max(mOptions.chunkSize, std::size_t(1));
+    mOptions.cacheSize = std::max(mOptions.cacheSize, std::size_t(1));
+
+    for (std::size_t i = 0; i < std::max(mOptions.threads, std::size_t(1)); ++i) {
+        mWorkers.emplace_back(new Worker());
+    }
+    for (auto& worker : mWorkers) {
+        auto currentWorker = worker.get();
+        worker->thread = std::thread([this, currentWorker]() { work(*currentWorker); });
+    }
+}
+
+ContentChangeDetector::~ContentChangeDetector()
+{
+    for (auto& worker : mWorkers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stopped = true;
+        worker->condition.notify_one();
+    }
+
+    for (auto& worker : mWorkers) {
+        worker->thread.join();
+    }
+}
+
+/**
+ * @brief Queues the file of the notification for hashing.
+ */
+void ContentChangeDetector::submit(const Notification& notification)
+{
+    auto& worker
+        = *mWorkers[std::hash<std::string>()(notification.path.string()) % mWorkers.size()];
+
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.notifications.push_back(notification);
+    worker.condition.notify_one();
+}
+
+ContentHashStatistics ContentChangeDetector::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    auto statistics = mStatistics;
+    statistics.bytesPerSecond = statistics.hashingSeconds > 0
+        ? statistics.hashedBytes / statistics.hashingSeconds
+        : 0;
+    return statistics;
+}
+
+/**
+ * @brief Hashes the file chunk by chunk.
+ *
+ * @return false if the file can not be read
+ */
+bool ContentChangeDetector::hashFile(
+    const inotifypp::filesystem::path& file, std::size_t chunkSize, std::uint64_t& digest)
+{
+    std::vector<std::uint8_t> buffer(std::max(chunkSize, std::size_t(1)));
+    std::uint64_t hashedBytes;
+    return hashFile(file, buffer, digest, hashedBytes);
+}
+
+/**
+ * @brief Hashes the file in chunks of the size of the buffer.
+ *
+ * The file is read rather than mapped, so a concurrent truncation ends
+ * the hash early instead of faulting on pages past the new end.
+ *
+ * @param hashedBytes number of bytes that were read and hashed
+ * @return false if the file can not be read
+ */
+bool ContentChangeDetector::hashFile(
+    const inotifypp::filesystem::path& file,
+    std::vector<std::uint8_t>& buffer,
+    std::uint64_t& digest,
+    std::uint64_t& hashedBytes)
+{
+    auto fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || !S_ISREG(status.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    digest = hash(nullptr, 0, static_cast<std::uint64_t>(status.st_size));
+    hashedBytes = 0;
+
+    while (true) {
+        auto length = read(fd, buffer.data(), buffer.size());
+        if (length == -1 && errno == EINTR) {
+            continue;
+        }
+        if (length == -1) {
+            close(fd);
+            return false;
+        }
+        if (length == 0) {
+            break;
+        }
+
+        digest = hash(buffer.data(), static_cast<std::size_t>(length), digest);
+        hashedBytes += static_cast<std::uint64_t>(length);
+    }
+
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief XXH64 of the data.
+ */
+std::uint64_t ContentChangeDetector::hash(const void* data, std::size_t length, std::uint64_t seed)
+{
+    auto input = static_cast<const std::uint8_t*>(data);
+    auto end = input + length;
+    std::uint64_t result;
+
+    if (length >= 32) {
+        auto v1 = seed + prime1 + prime2;
+        auto v2 = seed + prime2;
+        auto v3 = seed;
+        auto v4 = seed - prime1;
+
+        for (auto limit = end - 32; input <= limit; input += 32) {
+            v1 = round(v1, read64(input));
+            v2 = round(v2, read64(input + 8));
+            v3 = round(v3, read64(input + 16));
+            v4 = round(v4, read64(input + 24));
+        }
+
+        result = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        result = mergeRound(result, v1);
+        result = mergeRound(result, v2);
+        result = mergeRound(result, v3);
+        result = mergeRound(result, v4);
+    } else {
+        result = seed + prime5;
+    }
+
+    result += length;
+
+    for (; input + 8 <= end; input += 8) {
+        result ^= round(0, read64(input));
+        result = rotl(result, 27) * prime1 + prime4;
+    }
+
+    if (input + 4 <= end) {
+        result ^= static_cast<std::uint64_t>(read32(input)) * prime1;
+        result = rotl(result, 23) * prime2 + prime3;
+        input += 4;
+    }
+
+    for (; input < end; ++input) {
+        result ^= *input * prime5;
+        result = rotl(result, 11) * prime1;
+    }
+
+    result ^= result >> 33;
+    result *= prime2;
+    result ^= result >> 29;
+    result *= prime3;
+    result ^= result >> 32;
+    return result;
+}
+
+void ContentChangeDetector::work(Worker& worker)
+{
+    std::vector<std::uint8_t> buffer(mOptions.chunkSize);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.condition.wait(
+            lock, [&]() { return worker.stopped || !worker.notifications.empty(); });
+        if (worker.stopped) {
+            return;
+        }
+
+        auto notification = worker.notifications.front();
+        worker.notifications.pop_front();
+        lock.unlock();
+
+        std::uint64_t digest = 0;
+        std::uint64_t hashedBytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto hashed = hashFile(notification.path, buffer, digest, hashedBytes);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+        bool changed = true;
+        if (!hashed) {
+            // Unchanged content can not be proven, the next hash starts over
+            std::lock_guard<std::mutex> cacheLock(mCacheMutex);
+            ++mStatistics.failedFiles;
+            forgetDigest(notification.path.string());
+        } else {
+            std::lock_guard<std::mutex> cacheLock(mCacheMutex);
+            ++mStatistics.hashedFiles;
+            mStatistics.hashedBytes += hashedBytes;
+            mStatistics.hashingSeconds += seconds.count();
+            changed = contentChanged(notification.path.string(), digest);
+            ++(changed ? mStatistics.changedFiles : mStatistics.unchangedFiles);
+        }
+
+        if (changed) {
+            mChangedObserver(notification);
+        } else if (mUnchangedObserver) {
+            mUnchangedObserver(notification);
+        }
+    }
+}
+
+/**
+ * @brief Updates the cached digest of the path and tells whether it differs.
+ * The caller holds mCacheMutex.
+ */
+bool ContentChangeDetector::contentChanged(const std::string& path, std::uint64_t digest)
+{
+    auto cached = mDigestIndex.find(path);
+    if (cached != mDigestIndex.end()) {
+        mDigests.splice(mDigests.begin(), mDigests, cached->second);
+        auto changed = cached->second->second != digest;
+        cached->second->second = digest;
+        return changed;
+    }
+
+    mDigests.emplace_front(path, digest);
+    mDigestIndex[path] = mDigests.begin();
+    if (mDigests.size() > mOptions.cacheSize) {
+        mDigestIndex.erase(mDigests.back().first);
+        mDigests.pop_back();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Removes the cached digest of the path. The caller holds mCacheMutex.
+ */
+void ContentChangeDetector::forgetDigest(const std::string& path)
+{
+    auto cached = mDigestIndex.find(path);
+    if (cached != mDigestIndex.end()) {
+        mDigests.erase(cached->second);
+        mDigestIndex.erase(cached);
+    }
+}
+}
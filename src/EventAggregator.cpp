@@ -0,0 +1,250 @@
+#include <inotify-cpp/EventAggregator.h>
+
+#include <algorithm>
+
+namespace fs = inotifypp::filesystem;
+
+namespace inotify {
+
+namespace {
+
+bool isCountedComponent(const fs::path& component)
+{
+    auto name = component.string();
+    return !name.empty() && name != "." && name != "/";
+}
+
+/**
+ * Number of components of prefix if it is a component wise prefix of path,
+ * -1 otherwise.
+ */
+int matchPrefix(const fs::path& prefix, const fs::path& path)
+{
+    auto component = path.begin();
+    int matched = 0;
+    for (auto& prefixComponent : prefix) {
+        if (component == path.end() || *component != prefixComponent) {
+            return -1;
+        }
+        ++component;
+        ++matched;
+    }
+
+    return matched;
+}
+}
+
+EventAggregator::EventAggregator(
+    AggregationOptions options,
+    std::function<fs::path(int)> watchPath,
+    EventSummaryObserver observer)
+    : mOptions(options)
+    , mWatchPath(watchPath)
+    , mObserver(observer)
+    , mAggregatedEventCount(0)
+    , mStopped(false)
+{
+    for (auto& root : mOptions.roots) {
+        if (!isCountedComponent(root.filename())) {
+            root = root.parent_path();
+        }
+    }
+
+    mFlushThread = std::thread([this]() { flushPeriodically(); });
+}
+
+EventAggregator::~EventAggregator()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+        mCondition.notify_one();
+    }
+
+    mFlushThread.join();
+    flush();
+}
+
+/**
+ * @brief Counts an event of the watch wd. The path is only looked at to
+ *        sample names.
+ */
+void EventAggregator::add(
+    int wd,
+    std::uint32_t mask,
+    const fs::path& path,
+    std::chrono::steady_clock::time_point eventTime)
+{
+    if (!(mask & static_cast<std::uint32_t>(mOptions.events))) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& summary = count(wd, mask, path, eventTime);
+    if (summary.sampleNames.size() < mOptions.sampleSize) {
+        summary.sampleNames.push_back(path.filename().string());
+    }
+}
+
+/**
+ * @brief Counts all records of a batch, without constructing any path.
+ */
+void EventAggregator::add(const EventBatch& batch, std::chrono::steady_clock::time_point eventTime)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (!(batch.masks[i] & static_cast<std::uint32_t>(mOptions.events))) {
+            continue;
+        }
+
+        auto& summary = count(batch.wds[i], batch.masks[i], fs::path(), eventTime);
+        if (summary.sampleNames.size() < mOptions.sampleSize && batch.nameLengths[i]) {
+            summary.sampleNames.push_back(batch.name(i));
+        }
+    }
+}
+
+/**
+ * @brief Drops the cached directory of a removed watch, so that a reused
+ *        watch descriptor is resolved again.
+ */
+void EventAggregator::forgetWatch(int wd)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSummaryOfWd.erase(wd);
+}
+
+/**
+ * @brief Emits the summaries of all directories with events since the
+ *        last flush.
+ */
+void EventAggregator::flush()
+{
+    std::vector<EventSummary> summaries;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto index : mTouchedSummaries) {
+            summaries.push_back(std::move(mSummaries[index]));
+        }
+
+        // Directories are resolved again in the next window, so idle ones are not kept
+        mTouchedSummaries.clear();
+        mSummaries.clear();
+        mSummaryOfDirectory.clear();
+        mSummaryOfWd.clear();
+    }
+
+    for (auto& summary : summaries) {
+        mObserver(std::move(summary));
+    }
+}
+
+std::uint64_t EventAggregator::getAggregatedEventCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mAggregatedEventCount;
+}
+
+Event EventAggregator::getEvents() const
+{
+    return mOptions.events;
+}
+
+/**
+ * Requires mMutex.
+ */
+EventSummary& EventAggregator::count(
+    int wd,
+    std::uint32_t mask,
+    const fs::path& path,
+    std::chrono::steady_clock::time_point eventTime)
+{
+    auto& summary = mSummaries[summaryOf(wd, mask, path)];
+    if (!summary.count) {
+        mTouchedSummaries.push_back(&summary - mSummaries.data());
+        summary.firstEventTime = eventTime;
+    }
+
+    summary.events = summary.events | static_cast<Event>(mask);
+    summary.lastEventTime = eventTime;
+    ++summary.count;
+    ++mAggregatedEventCount;
+    return summary;
+}
+
+/**
+ * Requires mMutex. Without a watch path function the parent of an entry
+ * path is the watch path; the path of an event with IN_ISDIR may be the
+ * watch path itself, so such events are not cached.
+ */
+std::size_t EventAggregator::summaryOf(int wd, std::uint32_t mask, const fs::path& path)
+{
+    auto cached = mSummaryOfWd.find(wd);
+    if (cached != mSummaryOfWd.end()) {
+        return cached->second;
+    }
+
+    auto watchPath = mWatchPath ? mWatchPath(wd) : path.parent_path();
+    auto cacheable = mWatchPath ? !watchPath.empty() : !(mask & IN_ISDIR);
+    auto directory = wd < 0 ? fs::path() : aggregationDirectory(watchPath);
+    auto summary = mSummaryOfDirectory.find(directory);
+    if (summary == mSummaryOfDirectory.end()) {
+        summary = mSummaryOfDirectory.emplace(directory, mSummaries.size()).first;
+        mSummaries.push_back(EventSummary { directory,
+                                            static_cast<Event>(0),
+                                            0,
+                                            std::chrono::steady_clock::time_point(),
+                                            std::chrono::steady_clock::time_point(),
+                                            {} });
+    }
+
+    if (cacheable) {
+        mSummaryOfWd[wd] = summary->second;
+    }
+    return summary->second;
+}
+
+fs::path EventAggregator::aggregationDirectory(const fs::path& watchPath)
+{
+    fs::path directory;
+    int rootLength = mOptions.roots.empty() ? 0 : -1;
+    for (auto& root : mOptions.roots) {
+        auto matched = matchPrefix(root, watchPath);
+        if (matched > rootLength) {
+            rootLength = matched;
+            directory = root;
+        }
+    }
+
+    if (rootLength < 0) {
+        return watchPath;
+    }
+
+    auto component = watchPath.begin();
+    std::advance(component, rootLength);
+    for (std::size_t depth = 0; component != watchPath.end() && depth < mOptions.depth;
+         ++component) {
+        directory /= *component;
+        if (isCountedComponent(*component)) {
+            ++depth;
+        }
+    }
+
+    return directory;
+}
+
+void EventAggregator::flushPeriodically()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopped) {
+        mCondition.wait_for(lock, mOptions.window, [this]() { return mStopped; });
+        if (mStopped) {
+            return;
+        }
+
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+}
@@ -0,0 +1,129 @@
+#include <inotify-cpp/EventBatch.h>
+
+#include <cstring>
+
+#include <sys/inotify.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace inotify {
+
+namespace {
+
+/**
+ * The kernel pads names with NULs up to a multiple of sizeof(inotify_event),
+ * so the terminating NUL always lies in the last 16 bytes of the name field
+ * and a single vector compare finds it.
+ */
+std::uint32_t nameLength(const char* name, std::uint32_t length)
+{
+    if (length == 0) {
+        return 0;
+    }
+
+#if defined(__SSE2__)
+    if (length % 16 == 0) {
+        auto lastChunk = name + length - 16;
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lastChunk));
+        auto zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+        if (zeros) {
+            return length - 16 + static_cast<std::uint32_t>(__builtin_ctz(zeros));
+        }
+        return length;
+    }
+#endif
+
+    return static_cast<std::uint32_t>(strnlen(name, length));
+}
+}
+
+EventBatch::EventBatch()
+    : buffer(nullptr)
+{
+}
+
+void EventBatch::clear()
+{
+    wds.clear();
+    masks.clear();
+    cookies.clear();
+    nameOffsets.clear();
+    nameLengths.clear();
+    buffer = nullptr;
+}
+
+void EventBatch::reserve(std::size_t records)
+{
+    wds.reserve(records);
+    masks.reserve(records);
+    cookies.reserve(records);
+    nameOffsets.reserve(records);
+    nameLengths.reserve(records);
+}
+
+std::size_t EventBatch::size() const
+{
+    return wds.size();
+}
+
+bool EventBatch::empty() const
+{
+    return wds.empty();
+}
+
+std::string EventBatch::name(std::size_t index) const
+{
+    return std::string(
+        reinterpret_cast<const char*>(buffer) + nameOffsets[index], nameLengths[index]);
+}
+
+std::size_t EventBatch::countMatching(std::uint32_t eventMask) const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < masks.size(); ++i) {
+        count += (masks[i] & eventMask) != 0;
+    }
+    return count;
+}
+
+void EventBatch::countByWd(
+    std::uint32_t eventMask, std::unordered_map<int, std::uint64_t>& counts) const
+{
+    for (std::size_t i = 0; i < masks.size(); ++i) {
+        if (masks[i] & eventMask) {
+            ++counts[wds[i]];
+        }
+    }
+}
+
+std::size_t decodeEventBatch(const std::uint8_t* buffer, std::size_t length, EventBatch& batch)
+{
+    batch.clear();
+    batch.buffer = buffer;
+    batch.reserve(length / sizeof(inotify_event));
+
+    std::size_t offset = 0;
+    while (offset + sizeof(inotify_event) <= length) {
+        inotify_event record;
+        std::memcpy(&record, buffer + offset, sizeof(inotify_event));
+
+        auto nameOffset = offset + sizeof(inotify_event);
+        if (nameOffset + record.len > length) {
+            break;
+        }
+
+        batch.wds.push_back(record.wd);
+        batch.masks.push_back(record.mask);
+        batch.cookies.push_back(record.cookie);
+        batch.nameOffsets.push_back(static_cast<std::uint32_t>(nameOffset));
+        batch.nameLengths.push_back(
+            nameLength(reinterpret_cast<const char*>(buffer + nameOffset), record.len));
+
+        offset = nameOffset + record.len;
+    }
+
+    return offset;
+}
+}
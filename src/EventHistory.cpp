@@ -0,0 +1,179 @@
+#include <inotify-cpp/EventHistory.h>
+
+#include <algorithm>
+
+namespace inotify {
+
+namespace {
+
+/**
+ * Approximate memory of an interned path in addition to its characters:
+ * the string headers in the path table and the id map and a hash node.
+ */
+const std::size_t internedPathOverhead = 96;
+}
+
+EventHistory::EventHistory(std::size_t capacityBytes)
+    : mCapacityBytes(capacityBytes)
+    , mSizeInBytes(0)
+    , mFirstSequence(1)
+{
+}
+
+/**
+ * @brief Retains the event and evicts the oldest events if the capacity
+ *        is exceeded.
+ *
+ * @return sequence number of the event
+ */
+std::uint64_t EventHistory::append(const FileSystemEvent& event)
+{
+    std::uint64_t sequence = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRecords.push_back(Record { event.mask,
+                                    event.cookie,
+                                    internPath(event.path.string()),
+                                    event.eventTime.time_since_epoch().count() });
+        mSizeInBytes += sizeof(Record);
+        sequence = mFirstSequence + mRecords.size() - 1;
+        evict();
+    }
+
+    mAppended.notify_all();
+    return sequence;
+}
+
+/**
+ * @brief Copies up to maxEntries entries following the cursor to entries.
+ *
+ * @param cursor sequence of the last processed entry, 0 to start with the
+ *        first event ever appended
+ */
+HistoryStatus EventHistory::read(
+    std::uint64_t cursor, std::size_t maxEntries, std::vector<HistoryEntry>& entries) const
+{
+    entries.clear();
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (cursor + 1 < mFirstSequence) {
+        return HistoryStatus::aged_out;
+    }
+
+    if (cursor >= mFirstSequence + mRecords.size()) {
+        return HistoryStatus::ahead;
+    }
+
+    auto begin = std::min<std::uint64_t>(cursor + 1 - mFirstSequence, mRecords.size());
+    auto end = begin + std::min<std::uint64_t>(maxEntries, mRecords.size() - begin);
+    entries.reserve(end - begin);
+
+    for (auto index = begin; index < end; ++index) {
+        auto& record = mRecords[index];
+        auto time = std::chrono::steady_clock::duration(record.time);
+        entries.push_back(HistoryEntry { mFirstSequence + index,
+                                         static_cast<Event>(record.mask),
+                                         record.cookie,
+                                         mPaths[record.pathId].path,
+                                         std::chrono::steady_clock::time_point(time) });
+    }
+
+    return HistoryStatus::ok;
+}
+
+/**
+ * @brief Blocks until an entry following the cursor was appended or the
+ *        timeout expired.
+ *
+ * @return true if an entry following the cursor is retained or the cursor
+ *         aged out or is ahead
+ */
+bool EventHistory::waitFor(std::uint64_t cursor, std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mAppended.wait_for(lock, timeout, [&]() {
+        return cursor + 1 < mFirstSequence + mRecords.size()
+            || cursor >= mFirstSequence + mRecords.size();
+    });
+}
+
+/**
+ * @return sequence of the oldest retained entry, getLastSequence() + 1 if empty
+ */
+std::uint64_t EventHistory::getFirstSequence() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFirstSequence;
+}
+
+/**
+ * @return sequence of the newest entry, 0 if nothing was appended yet
+ */
+std::uint64_t EventHistory::getLastSequence() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFirstSequence + mRecords.size() - 1;
+}
+
+std::size_t EventHistory::size() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRecords.size();
+}
+
+std::size_t EventHistory::getSizeInBytes() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSizeInBytes;
+}
+
+std::uint32_t EventHistory::internPath(const std::string& path)
+{
+    auto pathId = mPathIds.find(path);
+    if (pathId != mPathIds.end()) {
+        ++mPaths[pathId->second].references;
+        return pathId->second;
+    }
+
+    std::uint32_t id = 0;
+    if (mFreePathIds.empty()) {
+        id = static_cast<std::uint32_t>(mPaths.size());
+        mPaths.push_back(InternedPath { path, 1 });
+    } else {
+        id = mFreePathIds.back();
+        mFreePathIds.pop_back();
+        mPaths[id] = InternedPath { path, 1 };
+    }
+
+    mPathIds.emplace(path, id);
+    mSizeInBytes += 2 * path.size() + internedPathOverhead;
+    return id;
+}
+
+void EventHistory::releasePath(std::uint32_t pathId)
+{
+    auto& internedPath = mPaths[pathId];
+    if (--internedPath.references) {
+        return;
+    }
+
+    mSizeInBytes -= 2 * internedPath.path.size() + internedPathOverhead;
+    mPathIds.erase(internedPath.path);
+    internedPath.path.clear();
+    internedPath.path.shrink_to_fit();
+    mFreePathIds.push_back(pathId);
+}
+
+/**
+ * @brief Evicts the oldest records, but always retains the newest one.
+ */
+void EventHistory::evict()
+{
+    while (mSizeInBytes > mCapacityBytes && mRecords.size() > 1) {
+        releasePath(mRecords.front().pathId);
+        mRecords.pop_front();
+        mSizeInBytes -= sizeof(Record);
+        ++mFirstSequence;
+    }
+}
+}
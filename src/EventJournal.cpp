@@ -0,0 +1,484 @@
+#include <inotify-cpp/EventJournal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = inotifypp::filesystem;
+
+namespace inotify {
+
+namespace {
+
+const std::uint64_t segmentMagic = 0x6c6e72756f6a7069; // "ipjourn"
+const std::uint32_t eventRecordType = 1;
+const std::uint32_t pathRecordType = 2;
+const std::string segmentPrefix = "segment-";
+const std::string segmentSuffix = ".journal";
+
+struct SegmentHeader {
+    std::uint64_t magic;
+    std::uint64_t firstSequence;
+};
+
+struct EventRecord {
+    std::uint32_t type;
+    std::uint32_t pathId;
+    std::uint64_t sequence;
+    std::int64_t time;
+    std::uint32_t mask;
+    std::uint32_t cookie;
+};
+
+struct PathRecord {
+    std::uint32_t type;
+    std::uint32_t pathId;
+    std::uint32_t length;
+    std::uint32_t reserved;
+};
+
+std::size_t padded(std::size_t length)
+{
+    return (length + 7) / 8 * 8;
+}
+
+std::runtime_error journalError(const std::string& message)
+{
+    std::stringstream errorStream;
+    errorStream << message << " " << strerror(errno) << ".";
+    return std::runtime_error(errorStream.str());
+}
+
+fs::path segmentPath(const fs::path& directory, std::uint64_t firstSequence)
+{
+    char name[64];
+    std::snprintf(
+        name,
+        sizeof(name),
+        "%s%020llu%s",
+        segmentPrefix.c_str(),
+        static_cast<unsigned long long>(firstSequence),
+        segmentSuffix.c_str());
+    return directory / name;
+}
+
+/**
+ * @return true if the name is the one of a segment, whose first sequence is stored
+ */
+bool parseSegmentName(const std::string& name, std::uint64_t& firstSequence)
+{
+    if (name.size() <= segmentPrefix.size() + segmentSuffix.size()
+        || name.compare(0, segmentPrefix.size(), segmentPrefix) != 0
+        || name.compare(name.size() - segmentSuffix.size(), segmentSuffix.size(), segmentSuffix)
+            != 0) {
+        return false;
+    }
+
+    auto digits = name.substr(
+        segmentPrefix.size(), name.size() - segmentPrefix.size() - segmentSuffix.size());
+    if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+
+    errno = 0;
+    firstSequence = std::strtoull(digits.c_str(), nullptr, 10);
+    return errno != ERANGE;
+}
+
+template <typename Record> void appendBytes(std::vector<std::uint8_t>& buffer, const Record& record)
+{
+    auto bytes = reinterpret_cast<const std::uint8_t*>(&record);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(Record));
+}
+}
+
+EventJournalWriter::EventJournalWriter(JournalOptions options)
+    : mOptions(options)
+    , mFd(-1)
+    , mSegmentBytes(0)
+    , mNextSequence(0)
+    , mStopped(false)
+{
+    fs::create_directories(mOptions.directory);
+
+    // Continue the sequence of an existing journal, which ends in its last segment
+    EventJournalReader reader(mOptions.directory);
+    mNextSequence = reader.getLastSegmentSequence();
+    JournalEntry entry;
+    if (reader.seek(mNextSequence)) {
+        while (reader.next(entry)) {
+            mNextSequence = entry.sequence + 1;
+        }
+    }
+
+    mBuffer.reserve(mOptions.batchSize + 4096);
+    openSegment();
+
+    if (mOptions.flushInterval.count() > 0) {
+        mFlushThread = std::thread([this]() { flushPeriodically(); });
+    }
+}
+
+EventJournalWriter::~EventJournalWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+        mCondition.notify_one();
+    }
+
+    if (mFlushThread.joinable()) {
+        mFlushThread.join();
+    }
+
+    try {
+        flushBuffer();
+    } catch (const std::exception&) {
+    }
+    closeSegment();
+}
+
+/**
+ * @brief Appends the event to the journal.
+ *
+ * @return sequence number of the event
+ */
+std::uint64_t EventJournalWriter::append(const FileSystemEvent& event)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    rethrowFlushError();
+
+    if (mSegmentBytes >= mOptions.segmentSize) {
+        flushBuffer();
+        closeSegment();
+        openSegment();
+    }
+
+    auto pathId = internPath(event.path.string());
+
+    auto age = std::chrono::steady_clock::now() - event.eventTime;
+    auto time = std::chrono::system_clock::now()
+        - std::chrono::duration_cast<std::chrono::system_clock::duration>(age);
+
+    EventRecord record {};
+    record.type = eventRecordType;
+    record.pathId = pathId;
+    record.sequence = mNextSequence++;
+    record.time
+        = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    record.mask = event.mask;
+    record.cookie = event.cookie;
+    appendBytes(mBuffer, record);
+    mSegmentBytes += sizeof(EventRecord);
+
+    if (mOptions.durability == JournalDurability::record
+        || mBuffer.size() >= mOptions.batchSize) {
+        flushBuffer();
+    }
+
+    return record.sequence;
+}
+
+/**
+ * @brief Writes all buffered records and syncs them unless
+ *        the durability is none.
+ */
+void EventJournalWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    rethrowFlushError();
+    flushBuffer();
+}
+
+std::uint64_t EventJournalWriter::getNextSequence() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNextSequence;
+}
+
+/**
+ * Requires mMutex to be held.
+ */
+void EventJournalWriter::flushBuffer()
+{
+    writeBuffer();
+    if (mOptions.durability != JournalDurability::none && fdatasync(mFd) == -1) {
+        throw journalError("Failed to sync journal !");
+    }
+}
+
+/**
+ * Throws the error of a background flush to the caller that
+ * appends or flushes next. Requires mMutex to be held.
+ */
+void EventJournalWriter::rethrowFlushError()
+{
+    if (mFlushError) {
+        auto error = mFlushError;
+        mFlushError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void EventJournalWriter::openSegment()
+{
+    auto path = segmentPath(mOptions.directory, mNextSequence);
+    mFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd == -1) {
+        throw journalError("Failed to open journal segment " + path.string() + " !");
+    }
+
+    SegmentHeader header { segmentMagic, mNextSequence };
+    appendBytes(mBuffer, header);
+    mSegmentBytes = sizeof(SegmentHeader);
+    mPathIds.clear();
+}
+
+void EventJournalWriter::closeSegment()
+{
+    if (mFd != -1) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+/**
+ * Paths are written once per segment, thus every segment can be read
+ * on its own. Path ids are valid within their segment.
+ */
+std::uint32_t EventJournalWriter::internPath(const std::string& path)
+{
+    auto interned = mPathIds.emplace(path, static_cast<std::uint32_t>(mPathIds.size()));
+    auto pathId = interned.first->second;
+    if (interned.second) {
+        PathRecord record { pathRecordType, pathId, static_cast<std::uint32_t>(path.size()), 0 };
+        appendBytes(mBuffer, record);
+        mBuffer.insert(mBuffer.end(), path.begin(), path.end());
+        mBuffer.resize(mBuffer.size() + padded(path.size()) - path.size(), 0);
+        mSegmentBytes += sizeof(PathRecord) + padded(path.size());
+    }
+
+    return pathId;
+}
+
+void EventJournalWriter::writeBuffer()
+{
+    std::size_t written = 0;
+    while (written < mBuffer.size()) {
+        auto result = write(mFd, mBuffer.data() + written, mBuffer.size() - written);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw journalError("Failed to write journal !");
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    mBuffer.clear();
+}
+
+void EventJournalWriter::flushPeriodically()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopped) {
+        mCondition.wait_for(lock, mOptions.flushInterval, [this]() { return mStopped; });
+        if (mStopped) {
+            return;
+        }
+
+        if (mBuffer.empty() || mFlushError) {
+            continue;
+        }
+
+        try {
+            flushBuffer();
+        } catch (const std::exception&) {
+            mFlushError = std::current_exception();
+        }
+    }
+}
+
+EventJournalReader::EventJournalReader(fs::path directory)
+    : mSegmentIndex(0)
+    , mData(nullptr)
+    , mSize(0)
+    , mOffset(0)
+    , mEntryOffset(0)
+{
+    if (fs::is_directory(directory)) {
+        for (fs::directory_iterator it(directory), end; it != end; ++it) {
+            // Other files in the directory are skipped
+            std::uint64_t firstSequence = 0;
+            if (parseSegmentName(it->path().filename().string(), firstSequence)) {
+                mSegments.emplace_back(firstSequence, it->path());
+            }
+        }
+    }
+    std::sort(mSegments.begin(), mSegments.end());
+
+    if (!mSegments.empty()) {
+        openSegment(0);
+    }
+}
+
+EventJournalReader::~EventJournalReader()
+{
+    closeSegment();
+}
+
+/**
+ * @brief Positions the reader at the first entry whose sequence
+ *        is not lower than the given one. Segments are found by
+ *        their name, records by scanning the mapped segment.
+ *
+ * @return false if there is no such entry
+ */
+bool EventJournalReader::seek(std::uint64_t sequence)
+{
+    if (mSegments.empty()) {
+        return false;
+    }
+
+    auto segment = std::upper_bound(
+        mSegments.begin(),
+        mSegments.end(),
+        sequence,
+        [](std::uint64_t sequence, const std::pair<std::uint64_t, fs::path>& segment) {
+            return sequence < segment.first;
+        });
+    auto index = segment == mSegments.begin() ? 0 : segment - mSegments.begin() - 1;
+    openSegment(static_cast<std::size_t>(index));
+
+    JournalEntry entry;
+    while (next(entry)) {
+        if (entry.sequence >= sequence) {
+            // Path records before the entry are already known, just step back to the entry
+            mOffset = mEntryOffset;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool EventJournalReader::next(JournalEntry& entry)
+{
+    while (mSegmentIndex < mSegments.size()) {
+        if (mOffset + sizeof(std::uint32_t) > mSize) {
+            if (!openSegment(mSegmentIndex + 1)) {
+                return false;
+            }
+            continue;
+        }
+
+        std::uint32_t type;
+        std::memcpy(&type, mData + mOffset, sizeof(type));
+
+        if (type == pathRecordType && mOffset + sizeof(PathRecord) <= mSize) {
+            PathRecord record;
+            std::memcpy(&record, mData + mOffset, sizeof(record));
+            auto pathOffset = mOffset + sizeof(PathRecord);
+            if (pathOffset + record.length <= mSize) {
+                mPaths[record.pathId].assign(
+                    reinterpret_cast<const char*>(mData + pathOffset), record.length);
+                mOffset = pathOffset + padded(record.length);
+                continue;
+            }
+        }
+
+        if (type == eventRecordType && mOffset + sizeof(EventRecord) <= mSize) {
+            EventRecord record;
+            std::memcpy(&record, mData + mOffset, sizeof(record));
+            mEntryOffset = mOffset;
+            mOffset += sizeof(EventRecord);
+
+            entry.sequence = record.sequence;
+            entry.time = std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(record.time)));
+            entry.mask = record.mask;
+            entry.cookie = record.cookie;
+            entry.pathId = record.pathId;
+            entry.path = mPaths[record.pathId];
+            return true;
+        }
+
+        // Truncated or unwritten tail of the segment
+        if (!openSegment(mSegmentIndex + 1)) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return sequence of the oldest retained segment, entries before it are gone
+ */
+std::uint64_t EventJournalReader::getFirstSequence() const
+{
+    return mSegments.empty() ? 0 : mSegments.front().first;
+}
+
+/**
+ * @return sequence of the newest segment, entries after it are in that segment
+ */
+std::uint64_t EventJournalReader::getLastSegmentSequence() const
+{
+    return mSegments.empty() ? 0 : mSegments.back().first;
+}
+
+bool EventJournalReader::openSegment(std::size_t index)
+{
+    closeSegment();
+    mSegmentIndex = index;
+    mPaths.clear();
+    if (index >= mSegments.size()) {
+        return false;
+    }
+
+    auto fd = open(mSegments[index].second.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw journalError("Failed to open journal segment " + mSegments[index].second.string() + " !");
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || static_cast<std::size_t>(status.st_size) < sizeof(SegmentHeader)) {
+        close(fd);
+        return true;
+    }
+
+    mSize = static_cast<std::size_t>(status.st_size);
+    auto memory = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw journalError("Failed to map journal segment " + mSegments[index].second.string() + " !");
+    }
+    madvise(memory, mSize, MADV_SEQUENTIAL);
+
+    mData = static_cast<const std::uint8_t*>(memory);
+    SegmentHeader header;
+    std::memcpy(&header, mData, sizeof(header));
+    mOffset = header.magic == segmentMagic ? sizeof(SegmentHeader) : mSize;
+    return true;
+}
+
+void EventJournalReader::closeSegment()
+{
+    if (mData) {
+        munmap(const_cast<std::uint8_t*>(mData), mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+    mOffset = 0;
+}
+}
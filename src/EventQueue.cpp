@@ -0,0 +1,144 @@
+#include <inotify-cpp/EventQueue.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace inotify {
+
+EventQueue::EventQueue()
+    : mCapacity(std::numeric_limits<std::size_t>::max())
+    , mPolicy(QueueOverflowPolicy::block)
+    , mStatistics { 0, 0, 0, 0, 0, 0 }
+    , mFrontPosition(0)
+{
+}
+
+/**
+ * @brief Limits the number of queued events.
+ *
+ * @param capacity maximum number of queued events, at least one
+ * @param policy applied when an event is pushed to the full queue
+ */
+void EventQueue::setCapacity(std::size_t capacity, QueueOverflowPolicy policy)
+{
+    mCapacity = std::max<std::size_t>(capacity, 1);
+    mPolicy = policy;
+
+    mNewestEventOf.clear();
+    if (mPolicy == QueueOverflowPolicy::coalesce) {
+        for (std::size_t i = 0; i < mEvents.size(); ++i) {
+            mNewestEventOf[mEvents[i].path.string()] = mFrontPosition + i;
+        }
+    }
+}
+
+std::size_t EventQueue::getCapacity() const
+{
+    return mCapacity;
+}
+
+QueueOverflowPolicy EventQueue::getPolicy() const
+{
+    return mPolicy;
+}
+
+bool EventQueue::push(const FileSystemEvent& event)
+{
+    ++mStatistics.pushedEvents;
+
+    if (mEvents.size() >= mCapacity) {
+        switch (mPolicy) {
+        // The reader respects available() for block, an overflow is a usage error
+        case QueueOverflowPolicy::block:
+        case QueueOverflowPolicy::drop_oldest:
+            popFront();
+            ++mStatistics.droppedOldestEvents;
+            pushBack(event);
+            return false;
+        case QueueOverflowPolicy::drop_newest:
+            ++mStatistics.droppedNewestEvents;
+            return false;
+        case QueueOverflowPolicy::coalesce: {
+            auto newestEvent = mNewestEventOf.find(event.path.string());
+            if (newestEvent != mNewestEventOf.end()) {
+                auto& queuedEvent = mEvents[newestEvent->second - mFrontPosition];
+                if (queuedEvent.mask == event.mask) {
+                    queuedEvent.count += event.count;
+                    ++mStatistics.coalescedEvents;
+                    return true;
+                }
+            }
+            popFront();
+            ++mStatistics.droppedOldestEvents;
+            pushBack(event);
+            return false;
+        }
+        }
+    }
+
+    pushBack(event);
+    mStatistics.maxSize = std::max(mStatistics.maxSize, mEvents.size());
+    return true;
+}
+
+FileSystemEvent& EventQueue::front()
+{
+    return mEvents.front();
+}
+
+void EventQueue::pop()
+{
+    popFront();
+}
+
+bool EventQueue::empty() const
+{
+    return mEvents.empty();
+}
+
+std::size_t EventQueue::size() const
+{
+    return mEvents.size();
+}
+
+std::size_t EventQueue::available() const
+{
+    if (mPolicy != QueueOverflowPolicy::block) {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    return mEvents.size() < mCapacity ? mCapacity - mEvents.size() : 0;
+}
+
+void EventQueue::countBlockedRead()
+{
+    ++mStatistics.blockedReads;
+}
+
+EventQueueStatistics EventQueue::getStatistics() const
+{
+    return mStatistics;
+}
+
+void EventQueue::popFront()
+{
+    if (mPolicy == QueueOverflowPolicy::coalesce) {
+        auto newestEvent = mNewestEventOf.find(mEvents.front().path.string());
+        if (newestEvent != mNewestEventOf.end() && newestEvent->second == mFrontPosition) {
+            mNewestEventOf.erase(newestEvent);
+        }
+    }
+
+    mEvents.pop_front();
+    ++mFrontPosition;
+}
+
+void EventQueue::pushBack(const FileSystemEvent& event)
+{
+    if (mPolicy == QueueOverflowPolicy::coalesce) {
+        mNewestEventOf[event.path.string()] = mFrontPosition + mEvents.size();
+    }
+
+    mEvents.push_back(event);
+}
+}
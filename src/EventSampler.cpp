@@ -0,0 +1,102 @@
+#include <inotify-cpp/EventSampler.h>
+
+#include <algorithm>
+
+namespace inotify {
+
+namespace {
+
+std::uint64_t pathKey(int wd, std::uint32_t mask, const char* name, std::size_t length)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    hash ^= (static_cast<std::uint64_t>(static_cast<std::uint32_t>(wd)) << 32) | mask;
+    hash *= 0xff51afd7ed558ccdULL;
+    return hash ^ (hash >> 33);
+}
+}
+
+EventSampler::EventSampler(SamplingOptions options)
+    : mOptions(options)
+    , mStatistics { 0, 0 }
+{
+    mOptions.rate = std::max<std::uint32_t>(mOptions.rate, 1);
+    mOptions.maxPaths = std::max<std::size_t>(mOptions.maxPaths, 1);
+}
+
+/**
+ * @param count number of events the record represents if it is delivered
+ * @return true if the record should be delivered
+ */
+bool EventSampler::accept(
+    int wd, std::uint32_t mask, const char* name, std::size_t length, std::uint32_t& count)
+{
+    count = 1;
+    if (mask & mOptions.mustDeliver) {
+        return true;
+    }
+
+    auto key = pathKey(wd, mask, name, length);
+    auto path = mPaths.find(key);
+    if (path == mPaths.end()) {
+        if (mPaths.size() >= mOptions.maxPaths) {
+            mPaths.clear();
+        }
+        path = mPaths.emplace(key, PathState { 0, {}, wd, mask, std::string(name, length) })
+                   .first;
+    }
+
+    auto& state = path->second;
+    ++state.pending;
+
+    bool due = false;
+    if (mOptions.interval.count()) {
+        auto now = std::chrono::steady_clock::now();
+        due = state.lastDelivery == std::chrono::steady_clock::time_point()
+            || now - state.lastDelivery >= mOptions.interval;
+        if (due) {
+            state.lastDelivery = now;
+        }
+    } else {
+        due = state.pending >= mOptions.rate;
+    }
+
+    if (!due) {
+        ++mStatistics.sampledEvents;
+        return false;
+    }
+
+    count = state.pending;
+    state.pending = 0;
+    ++mStatistics.deliveredEvents;
+    return true;
+}
+
+/**
+ * @brief Takes the counts of all paths with events that were not delivered.
+ *        They are delivered with the returned samples.
+ */
+std::vector<PendingSample> EventSampler::flush()
+{
+    std::vector<PendingSample> samples;
+    for (auto& path : mPaths) {
+        auto& state = path.second;
+        if (state.pending) {
+            samples.push_back(PendingSample { state.wd, state.mask, state.name, state.pending });
+            ++mStatistics.deliveredEvents;
+            state.pending = 0;
+        }
+    }
+
+    return samples;
+}
+
+SamplingStatistics EventSampler::getStatistics() const
+{
+    return mStatistics;
+}
+}
@@ -10,6 +10,23 @@ FileSystemEvent::FileSystemEvent(
     const std::chrono::steady_clock::time_point& eventTime)
     : wd(wd)
     , mask(mask)
+    , cookie(0)
+    , count(1)
+    , path(path)
+    , eventTime(eventTime)
+{
+}
+
+FileSystemEvent::FileSystemEvent(
+    const int wd,
+    uint32_t mask,
+    uint32_t cookie,
+    const inotifypp::filesystem::path& path,
+    const std::chrono::steady_clock::time_point& eventTime)
+    : wd(wd)
+    , mask(mask)
+    , cookie(cookie)
+    , count(1)
     , path(path)
     , eventTime(eventTime)
 {
@@ -0,0 +1,173 @@
+#include <inotify-cpp/HeavyHitters.h>
+
+#include <algorithm>
+
+namespace inotify {
+
+namespace {
+
+std::uint64_t mix(std::uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+std::uint64_t directoryKey(int wd)
+{
+    return mix(static_cast<std::uint32_t>(wd));
+}
+
+std::uint64_t fileKey(int wd, const char* name, std::size_t length)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return mix(hash ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(wd)) << 32));
+}
+}
+
+HeavyHitters::HeavyHitters(std::size_t topK, std::size_t sketchWidth, std::size_t sketchDepth)
+    : mTopK(std::max<std::size_t>(topK, 1))
+    , mSketchWidth(std::max<std::size_t>(sketchWidth, 1))
+    , mSketchDepth(std::max<std::size_t>(sketchDepth, 1))
+    , mSketch(mSketchWidth * mSketchDepth, 0)
+    , mEventCount(0)
+{
+    mDirectories.reserve(mTopK);
+    mFiles.reserve(mTopK);
+}
+
+/**
+ * @brief Counts one event of the watch and, if name is not empty, of the
+ *        name inside of the watched directory.
+ */
+void HeavyHitters::add(int wd, const char* name, std::size_t length)
+{
+    ++mEventCount;
+
+    auto key = directoryKey(wd);
+    offer(mDirectories, key, wd, "", 0, increment(key));
+
+    if (length) {
+        key = fileKey(wd, name, length);
+        offer(mFiles, key, wd, name, length, increment(key));
+    }
+}
+
+/**
+ * @brief Drops the candidates of a removed watch, so a reused watch
+ *        descriptor does not report the old directory.
+ */
+void HeavyHitters::forgetWatch(int wd)
+{
+    auto hasWatch = [wd](const Candidate& candidate) { return candidate.wd == wd; };
+    mDirectories.erase(
+        std::remove_if(mDirectories.begin(), mDirectories.end(), hasWatch), mDirectories.end());
+    mFiles.erase(std::remove_if(mFiles.begin(), mFiles.end(), hasWatch), mFiles.end());
+}
+
+void HeavyHitters::clear()
+{
+    std::fill(mSketch.begin(), mSketch.end(), 0);
+    mDirectories.clear();
+    mFiles.clear();
+    mEventCount = 0;
+}
+
+/**
+ * @return busiest watches, highest count first
+ */
+std::vector<HeavyHitter> HeavyHitters::getDirectories() const
+{
+    return sorted(mDirectories);
+}
+
+/**
+ * @return busiest names, highest count first
+ */
+std::vector<HeavyHitter> HeavyHitters::getFiles() const
+{
+    return sorted(mFiles);
+}
+
+std::uint64_t HeavyHitters::getEventCount() const
+{
+    return mEventCount;
+}
+
+/**
+ * @brief Conservative update: only the counters holding the current
+ *        minimum are raised.
+ *
+ * @return new estimate of the key
+ */
+std::uint64_t HeavyHitters::increment(std::uint64_t key)
+{
+    auto step = mix(key) | 1;
+    auto estimate = mSketch[key % mSketchWidth];
+    for (std::size_t row = 1; row < mSketchDepth; ++row) {
+        auto column = (key + row * step) % mSketchWidth;
+        estimate = std::min(estimate, mSketch[row * mSketchWidth + column]);
+    }
+
+    ++estimate;
+    for (std::size_t row = 0; row < mSketchDepth; ++row) {
+        auto& counter = mSketch[row * mSketchWidth + (key + row * step) % mSketchWidth];
+        counter = std::max(counter, estimate);
+    }
+
+    return estimate;
+}
+
+void HeavyHitters::offer(
+    std::vector<Candidate>& candidates,
+    std::uint64_t key,
+    int wd,
+    const char* name,
+    std::size_t length,
+    std::uint64_t count)
+{
+    auto minimum = candidates.end();
+    for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+        if (candidate->key == key) {
+            candidate->count = count;
+            return;
+        }
+
+        if (minimum == candidates.end() || candidate->count < minimum->count) {
+            minimum = candidate;
+        }
+    }
+
+    if (candidates.size() < mTopK) {
+        candidates.push_back(Candidate { key, wd, std::string(name, length), count });
+        return;
+    }
+
+    if (count > minimum->count) {
+        *minimum = Candidate { key, wd, std::string(name, length), count };
+    }
+}
+
+std::vector<HeavyHitter> HeavyHitters::sorted(const std::vector<Candidate>& candidates)
+{
+    std::vector<HeavyHitter> heavyHitters;
+    heavyHitters.reserve(candidates.size());
+    for (auto& candidate : candidates) {
+        heavyHitters.push_back(HeavyHitter { candidate.wd, candidate.name, candidate.count });
+    }
+
+    std::sort(
+        heavyHitters.begin(),
+        heavyHitters.end(),
+        [](const HeavyHitter& lhs, const HeavyHitter& rhs) { return lhs.count > rhs.count; });
+    return heavyHitters;
+}
+}
@@ -1,18 +1,50 @@
 
 #include <inotify-cpp/Inotify.h>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include <cstring>
+
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Probes.h"
+
 namespace fs = inotifypp::filesystem;
 
 namespace inotify {
 
+namespace {
+
+/**
+ * Inotify instance whose state the current thread may access directly,
+ * because it runs its event loop or applies its commands.
+ */
+thread_local const Inotify* tCommandOwner = nullptr;
+
+/**
+ * @return true if the path is the subtree or one of its descendants
+ */
+bool isInSubtree(const fs::path& path, const fs::path& subtree)
+{
+    return std::mismatch(subtree.begin(), subtree.end(), path.begin(), path.end()).first
+        == subtree.end();
+}
+}
+
 Inotify::Inotify()
     : mError(0)
     , mEventTimeout(0)
@@ -20,13 +52,28 @@ Inotify::Inotify()
     , mEventMask(IN_ALL_EVENTS)
     , mThreadSleep(250)
     , mIgnoredDirectories(std::vector<std::string>())
+    , mEventsLost(false)
+    , mKernelOverflowCount(0)
+    , mWatchGeneration(0)
+    , mStaleEventCount(0)
+    , mSymlinkPolicy(SymlinkPolicy::fan_out)
+    , mWatchMasksOutdated(false)
     , mInotifyFd(0)
     , mOnEventTimeout([](FileSystemEvent) {})
-    , mEventBuffer(MAX_EVENTS * (EVENT_SIZE + 16), 0)
+    , mNameFilteredEventCount(0)
+    , mBusyPolling(false)
+    , mBusyPollStatistics {}
+    , mTotalWakeLatency(0)
+    , mRecordsPending(false)
+    , mEventBufferOffset(0)
+    , mEventBufferLength(0)
+    , mCommandFd(-1)
     , mPipeReadIdx(0)
     , mPipeWriteIdx(1)
 {
     mStopped = false;
+    mCommandsPending = false;
+    mEventLoopActive = false;
 
     if (pipe2(mStopPipeFd, O_NONBLOCK) == -1) {
         mError = errno;
@@ -60,6 +107,23 @@ Inotify::Inotify()
         throw std::runtime_error(errorStream.str());
     }
 
+    mCommandFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mCommandFd == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't initialize command eventfd ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    mCommandEpollEvent.events = EPOLLIN | EPOLLET;
+    mCommandEpollEvent.data.fd = mCommandFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mCommandFd, &mCommandEpollEvent) == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't add command filedescriptor to epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
     mStopPipeEpollEvent.events = EPOLLIN | EPOLLET;
     mStopPipeEpollEvent.data.fd = mStopPipeFd[mPipeReadIdx];
     if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mStopPipeFd[mPipeReadIdx], &mStopPipeEpollEvent) == -1) {
@@ -74,6 +138,7 @@ Inotify::~Inotify()
 {
     epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mInotifyFd, 0);
     epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mStopPipeFd[mPipeReadIdx], 0);
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mCommandFd, 0);
 
     if (!close(mInotifyFd)) {
         mError = errno;
@@ -83,6 +148,7 @@ Inotify::~Inotify()
         mError = errno;
     }
 
+    close(mCommandFd);
     close(mStopPipeFd[mPipeReadIdx]);
     close(mStopPipeFd[mPipeWriteIdx]);
 }
@@ -90,41 +156,175 @@ Inotify::~Inotify()
 /**
  * @brief Adds the given path and all files and subdirectories
  *        to the set of watched files/directories.
- *        Symlinks will be followed!
+ *        Symlinks are treated by the symlink policy.
  *
  * @param path that will be watched recursively
  *
  */
 void Inotify::watchDirectoryRecursively(fs::path path)
 {
-    std::vector<fs::path> paths;
+    watchDirectoryRecursively(path, IN_ALL_EVENTS);
+}
+
+/**
+ * @brief Same as watchDirectoryRecursively(path) but all watches
+ *        of the tree report only events of the given mask.
+ *
+ * @param path that will be watched recursively
+ * @param eventMask events of interest for this tree
+ *
+ */
+void Inotify::watchDirectoryRecursively(fs::path path, uint32_t eventMask)
+{
+    SymlinkPolicy symlinkPolicy;
+    MountOptions mountOptions;
+    runCommand([&]() {
+        symlinkPolicy = mSymlinkPolicy;
+        mountOptions = mMountOptions;
+    });
+    watchFiles(collectWatchPaths(path, symlinkPolicy, mountOptions), eventMask);
+}
+
+/**
+ * @brief Lists the path and all directories and symlinks
+ *        below it, which are the watches needed to watch it
+ *        recursively. Every physical directory is crawled
+ *        once, identified by device and inode. Further paths
+ *        of a visited directory or file are listed, but not
+ *        crawled, if the policy is fan_out. Mounts are
+ *        detected by a changed device and only crossed if
+ *        the mount options admit them.
+ *
+ * @param path of the tree
+ * @param symlinkPolicy treatment of symlinks below the path
+ * @param mountOptions mounts below the path to descend into
+ * @return paths to watch
+ *
+ */
+std::vector<fs::path> Inotify::collectWatchPaths(
+    const fs::path& path, SymlinkPolicy symlinkPolicy, const MountOptions& mountOptions)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) == -1) {
+        throw std::invalid_argument(
+            "Can´t watch Path! Path does not exist. Path: " + path.string());
+    }
+
+    std::vector<fs::path> paths { path };
+    std::set<std::pair<dev_t, ino_t>> visited { { status.st_dev, status.st_ino } };
+    std::vector<std::pair<fs::path, dev_t>> directories;
+    if (S_ISDIR(status.st_mode)) {
+        directories.emplace_back(path, status.st_dev);
+    }
+
+    // Read once the crawl crosses a mount
+    std::unique_ptr<MountTable> mountTable;
 
-    if (fs::exists(path)) {
-        paths.push_back(path);
+    while (!directories.empty()) {
+        auto directory = std::move(directories.back().first);
+        auto device = directories.back().second;
+        directories.pop_back();
 
-        if (fs::is_directory(path)) {
-            inotifypp::error_code ec;
-            fs::recursive_directory_iterator it(
-                path, fs::directory_options::follow_directory_symlink, ec);
-            fs::recursive_directory_iterator end;
+        inotifypp::error_code ec;
+        fs::directory_iterator it(directory, ec);
+        fs::directory_iterator end;
 
-            for (; it != end; it.increment(ec)) {
-                fs::path currentPath = *it;
+        for (; it != end; it.increment(ec)) {
+            // The type of the entry is known from reading the directory
+            auto type = it->symlink_status(ec).type();
+            auto symlink = type == fs::file_type::symlink;
+            if ((symlink && symlinkPolicy == SymlinkPolicy::skip)
+                || (!symlink && type != fs::file_type::directory)) {
+                continue;
+            }
+
+            // Broken symlinks and entries that were removed meanwhile are skipped
+            auto& currentPath = it->path();
+            if (stat(currentPath.c_str(), &status) == -1) {
+                continue;
+            }
 
-                if (!fs::is_directory(currentPath) && !fs::is_symlink(currentPath)) {
+            if (status.st_dev != device && !mountOptions.empty()) {
+                if (!mountTable) {
+                    mountTable = std::make_unique<MountTable>(MountTable::read());
+                }
+                if (!mountTable->admits(status.st_dev, currentPath, mountOptions)) {
                     continue;
                 }
+            }
+
+            if (!visited.emplace(status.st_dev, status.st_ino).second) {
+                if (symlinkPolicy == SymlinkPolicy::fan_out) {
+                    paths.push_back(currentPath);
+                }
+                continue;
+            }
 
-                paths.push_back(currentPath);
+            paths.push_back(currentPath);
+            if (S_ISDIR(status.st_mode)) {
+                directories.emplace_back(currentPath, status.st_dev);
+            }
+        }
+    }
+
+    return paths;
+}
+
+/**
+ * @brief Sets the treatment of symlinks by subsequent calls of
+ *        watchDirectoryRecursively and whether events of a watch
+ *        that is shared by several paths are reported for every
+ *        path (see SymlinkPolicy).
+ */
+void Inotify::setSymlinkPolicy(SymlinkPolicy symlinkPolicy)
+{
+    runCommand([&]() { mSymlinkPolicy = symlinkPolicy; });
+}
+
+/**
+ * @brief Sets the mounts that subsequent calls of
+ *        watchDirectoryRecursively descend into.
+ */
+void Inotify::setMountOptions(MountOptions mountOptions)
+{
+    runCommand([&]() { mMountOptions = mountOptions; });
+}
+
+/**
+ * @brief Adds watches for all given files/directories. While the
+ *        event loop runs they are added in slices of
+ *        WATCHES_PER_COMMAND, so events are read in between.
+ *
+ * @param files that will be watched
+ * @param eventMask events of interest for these watches
+ *
+ */
+void Inotify::watchFiles(std::vector<fs::path> files, uint32_t eventMask)
+{
+    auto watches = std::make_shared<std::vector<fs::path>>(std::move(files));
+    std::vector<std::future<void>> results;
+    for (std::size_t begin = 0; begin < watches->size(); begin += WATCHES_PER_COMMAND) {
+        auto end = std::min<std::size_t>(begin + WATCHES_PER_COMMAND, watches->size());
+        results.push_back(submitCommand([this, watches, begin, end, eventMask]() {
+            for (auto i = begin; i < end; ++i) {
+                watchFile((*watches)[i], eventMask);
+            }
+        }));
+    }
+
+    std::exception_ptr error;
+    for (auto& result : results) {
+        try {
+            result.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
             }
         }
-    } else {
-        throw std::invalid_argument(
-            "Can´t watch Path! Path does not exist. Path: " + path.string());
     }
 
-    for (auto& path : paths) {
-        watchFile(path);
+    if (error) {
+        std::rethrow_exception(error);
     }
 }
 
@@ -140,48 +340,185 @@ void Inotify::watchDirectoryRecursively(fs::path path)
  */
 void Inotify::watchFile(fs::path filePath)
 {
-    if (fs::exists(filePath)) {
-        mError = 0;
-        int wd = 0;
-        if (!isIgnored(filePath.string())) {
-            wd = inotify_add_watch(mInotifyFd, filePath.string().c_str(), mEventMask);
+    watchFile(filePath, IN_ALL_EVENTS);
+}
+
+/**
+ * @brief Adds a single file/directorie to the list of
+ *        watches which reports only events of the
+ *        given mask. The mask is further narrowed by the
+ *        global event mask.
+ *
+ * @param path that will be watched
+ * @param eventMask events of interest for this watch
+ *
+ */
+void Inotify::watchFile(fs::path filePath, uint32_t eventMask)
+{
+    runCommand([&]() {
+        if (fs::exists(filePath)) {
+            mRequestedEventMasks[filePath] = eventMask;
+            addWatch(filePath, watchMaskFor(filePath));
+        } else {
+            throw std::invalid_argument(
+                "Can´t watch Path! Path does not exist. Path: " + filePath.string());
         }
+    });
+}
 
-        if (wd == -1) {
-            mError = errno;
-            std::stringstream errorStream;
-            if (mError == 28) {
-                errorStream << "Failed to watch! " << strerror(mError)
-                            << ". Please increase number of watches in "
-                               "\"/proc/sys/fs/inotify/max_user_watches\".";
-                throw std::runtime_error(errorStream.str());
-            }
+void Inotify::addWatch(const fs::path& filePath, uint32_t eventMask)
+{
+    if (eventMask == 0) {
+        mParkedWatches.insert(filePath);
+        return;
+    }
+
+    mError = 0;
+    int wd = inotify_add_watch(mInotifyFd, filePath.string().c_str(), eventMask);
+
+    auto watch = mDirectorieMap.left.find(wd);
+    if (watch != mDirectorieMap.left.end() && watch->second != filePath) {
+        addPathAlias(wd, filePath, eventMask);
+        return;
+    }
 
+    if (wd == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        if (mError == 28) {
             errorStream << "Failed to watch! " << strerror(mError)
-                        << ". Path: " << filePath.string();
+                        << ". Please increase number of watches in "
+                           "\"/proc/sys/fs/inotify/max_user_watches\".";
             throw std::runtime_error(errorStream.str());
         }
-        mDirectorieMap.left.insert({wd, filePath});
+
+        errorStream << "Failed to watch! " << strerror(mError)
+                    << ". Path: " << filePath.string();
+        throw std::runtime_error(errorStream.str());
+    }
+
+    // Known once, so decoding a record of the watch needs no stat
+    struct stat status {};
+    stat(filePath.c_str(), &status);
+
+    // The path was replaced, e.g. deleted and created again, before the
+    // IN_IGNORED record of its previous watch was read
+    auto previous = mDirectorieMap.right.find(filePath);
+    if (previous != mDirectorieMap.right.end() && previous->second != wd) {
+        retireWatch(previous->second, true);
+    }
+
+    mParkedWatches.erase(filePath);
+    mDirectorieMap.left.insert({wd, filePath});
+    mWatchEntries[wd]
+        = WatchEntry { ++mWatchGeneration, S_ISDIR(status.st_mode), status.st_dev };
+    mWatchMasks[wd] = eventMask;
+    if (!mPathAliases.empty()) {
+        collectPathAliases(wd, filePath);
+    }
+}
+
+/**
+ * @brief Registers another path of a watched inode, e.g. a symlink or a
+ *        hard link. The kernel returned the descriptor of the existing
+ *        watch and replaced its mask, so the union of both masks is
+ *        installed. The alias is removed with the watch.
+ */
+void Inotify::addPathAlias(int wd, const fs::path& alias, uint32_t eventMask)
+{
+    auto installedMask = mWatchMasks[wd];
+    if ((eventMask | installedMask) != eventMask) {
+        inotify_add_watch(mInotifyFd, alias.string().c_str(), eventMask | installedMask);
+    }
+
+    mWatchMasks[wd] = eventMask | installedMask;
+    mParkedWatches.erase(alias);
+    auto& target = mDirectorieMap.left.at(wd);
+    mPathAliases.emplace(target, alias);
+    updatePathAliases(target);
+}
+
+/**
+ * @brief Collects the paths by which the entries of the watched path are
+ *        reachable, too. Every alias of the watched path or one of its
+ *        ancestors is stored with the length of the path it replaces, so
+ *        decoding a record looks them up by descriptor.
+ */
+void Inotify::collectPathAliases(int wd, const fs::path& watchPath)
+{
+    std::vector<std::pair<std::size_t, fs::path>> pathAliases;
+    auto ancestor = watchPath;
+    while (!ancestor.empty()) {
+        auto aliases = mPathAliases.equal_range(ancestor);
+        for (auto alias = aliases.first; alias != aliases.second; ++alias) {
+            pathAliases.emplace_back(ancestor.string().size(), alias->second);
+        }
+
+        auto parent = ancestor.parent_path();
+        if (parent == ancestor) {
+            break;
+        }
+        ancestor = parent;
+    }
+
+    if (pathAliases.empty()) {
+        mPathAliasesOfWatch.erase(wd);
     } else {
-        throw std::invalid_argument(
-            "Can´t watch Path! Path does not exist. Path: " + filePath.string());
+        mPathAliasesOfWatch[wd] = std::move(pathAliases);
+    }
+}
+
+/**
+ * @brief Collects the path aliases of the watches in the subtree again,
+ *        after an alias of it was added or removed. The watched paths of
+ *        the subtree are adjacent in the ordered watch map.
+ */
+void Inotify::updatePathAliases(const fs::path& subtree)
+{
+    for (auto watch = mDirectorieMap.right.lower_bound(subtree);
+         watch != mDirectorieMap.right.end();
+         ++watch) {
+        if (!isInSubtree(watch->first, subtree)) {
+            break;
+        }
+        collectPathAliases(watch->second, watch->first);
     }
 }
 
 void Inotify::ignoreFileOnce(fs::path file)
 {
-    mOnceIgnoredDirectories.push_back(file.string());
+    runCommand([&]() { mOnceIgnoredDirectories.push_back(file.string()); });
 }
 
 void Inotify::ignoreFile(fs::path file)
 {
-    mIgnoredDirectories.push_back(file.string());
+    runCommand([&]() {
+        mIgnoredDirectories.push_back(file.string());
+        mWatchMasksOutdated = true;
+    });
 }
 
 
 void Inotify::unwatchFile(fs::path file)
 {
-    removeWatch(mDirectorieMap.right.at(file));
+    runCommand([&]() {
+        mRequestedEventMasks.erase(file);
+        if (mParkedWatches.erase(file)) {
+            mPathAliases.erase(file);
+            return;
+        }
+
+        for (auto alias = mPathAliases.begin(); alias != mPathAliases.end(); ++alias) {
+            if (alias->second == file) {
+                auto target = alias->first;
+                mPathAliases.erase(alias);
+                updatePathAliases(target);
+                return;
+            }
+        }
+
+        removeWatch(mDirectorieMap.right.at(file));
+    });
 }
 
 /**
@@ -194,184 +531,1346 @@ void Inotify::unwatchFile(fs::path file)
 void Inotify::removeWatch(int wd)
 {
     int result = inotify_rm_watch(mInotifyFd, wd);
-    if (result == -1) {
+
+    // EINVAL: the kernel removed the watch already, e.g. because its file
+    // was deleted, and queued the IN_IGNORED record
+    if (result == -1 && errno != EINVAL) {
         mError = errno;
         std::stringstream errorStream;
         errorStream << "Failed to remove watch! " << strerror(mError) << ".";
         throw std::runtime_error(errorStream.str());
     }
-}
 
-fs::path Inotify::wdToPath(int wd)
-{
-    return mDirectorieMap.left.at(wd);
+    retireWatch(wd);
 }
 
-void Inotify::setEventMask(uint32_t eventMask)
+/**
+ * @brief Forgets the state of a watch. The path aliases of its path are
+ *        kept if the path stays watched, e.g. while it is parked.
+ */
+void Inotify::forgetWatch(int wd, bool keepPathAliases)
 {
-    mEventMask = eventMask;
+    auto watch = mDirectorieMap.left.find(wd);
+    mPathAliasesOfWatch.erase(wd);
+    if (watch != mDirectorieMap.left.end()) {
+        auto path = watch->second;
+        mDirectorieMap.left.erase(watch);
+        if (!keepPathAliases && mPathAliases.erase(path)) {
+            updatePathAliases(path);
+        }
+    }
+    mWatchEntries.erase(wd);
+    mWatchMasks.erase(wd);
+    if (mHeavyHitters) {
+        mHeavyHitters->forgetWatch(wd);
+        mHotWatches.erase(wd);
+    }
+    if (mOnWatchRemoved) {
+        mOnWatchRemoved(wd);
+    }
 }
 
-uint32_t Inotify::getEventMask()
+/**
+ * @brief Forgets a watch that was removed from the kernel, so its path can
+ *        be watched again before the IN_IGNORED record arrives. Until then
+ *        the records of the descriptor are stale, even if the kernel reuses
+ *        it for a new watch.
+ */
+void Inotify::retireWatch(int wd, bool keepPathAliases)
 {
-    return mEventMask;
+    auto watch = mWatchEntries.find(wd);
+    mRetiredWatches.emplace(wd, watch != mWatchEntries.end() ? watch->second.generation : 0);
+    forgetWatch(wd, keepPathAliases);
 }
 
-void Inotify::setEventTimeout(
-    std::chrono::milliseconds eventTimeout, std::function<void(FileSystemEvent)> onEventTimeout)
+/**
+ * @brief The last record of a watch descriptor. Records are read in the
+ *        order they were queued, so it belongs to the oldest retired watch
+ *        of the descriptor, or to the current watch if none is retired.
+ */
+void Inotify::handleIgnored(int wd)
 {
-    mLastEventTime -= eventTimeout;
-    mEventTimeout = eventTimeout;
-    mOnEventTimeout = onEventTimeout;
+    auto retired = mRetiredWatches.lower_bound(wd);
+    if (retired != mRetiredWatches.end() && retired->first == wd) {
+        mRetiredWatches.erase(retired);
+        return;
+    }
+
+    forgetWatch(wd);
 }
 
 /**
- * @brief Blocking wait on new events of watched files/directories
- *        specified on the eventmask. FileSystemEvents
- *        will be returned one by one. Thus this
- *        function can be called in some while(true)
- *        loop.
+ * @brief Forgets the watches of the unmounted file system at once. The
+ *        kernel removed them and queues an IN_UNMOUNT and IN_IGNORED record
+ *        for each, which are dropped by a lookup of the retired watch.
  *
- * @return A new FileSystemEvent
+ * The mount point is the topmost watched ancestor of the watch on the same
+ * device. Only watches below it are released: another mount of the device,
+ * e.g. a new file system that reuses the device number, keeps its watches,
+ * as do watches whose device is unknown.
  *
+ * @return mount point, if it was watched, or the path of the watch
  */
-inotifypp::optional<FileSystemEvent> Inotify::getNextEvent()
+fs::path Inotify::releaseFileSystem(int wd)
 {
-    std::vector<FileSystemEvent> newEvents;
+    auto device = mWatchEntries.at(wd).device;
+    auto mountPoint = mDirectorieMap.left.at(wd);
+    if (device == 0) {
+        retireWatch(wd);
+        return mountPoint;
+    }
 
-    while (mEventQueue.empty() && !mStopped) {
-        auto length = readEventsIntoBuffer(mEventBuffer);
-        readEventsFromBuffer(mEventBuffer.data(), length, newEvents);
-        filterEvents(newEvents, mEventQueue);
+    for (auto ancestor = mountPoint.parent_path(); !ancestor.empty();
+         ancestor = ancestor.parent_path()) {
+        auto watch = mDirectorieMap.right.find(ancestor);
+        if (watch != mDirectorieMap.right.end()) {
+            if (mWatchEntries.at(watch->second).device != device) {
+                break;
+            }
+            mountPoint = ancestor;
+        }
+        if (ancestor == ancestor.parent_path()) {
+            break;
+        }
     }
 
-    if (mStopped) {
-        return inotifypp::nullopt();
+    // The file system is gone, a device that is still mounted is another one
+    auto mountTable = MountTable::read();
+    auto mounted = mountTable.find(device);
+
+    std::vector<int> watches { wd };
+    for (auto watch = mDirectorieMap.right.lower_bound(mountPoint);
+         watch != mDirectorieMap.right.end() && isInSubtree(watch->first, mountPoint);
+         ++watch) {
+        auto entry = mWatchEntries.find(watch->second);
+        if (watch->second == wd || entry == mWatchEntries.end()
+            || entry->second.device != device
+            || (mounted && isInSubtree(fs::absolute(watch->first), mounted->mountPoint))) {
+            continue;
+        }
+        watches.push_back(watch->second);
     }
 
-    auto event = mEventQueue.front();
-    mEventQueue.pop();
-    return event;
+    for (auto unmountedWd : watches) {
+        retireWatch(unmountedWd);
+    }
+
+    return mountPoint;
 }
 
-void Inotify::stop()
+/**
+ * @return true if the record belongs to no current watch. It is counted
+ *         and reported to the stale event observer.
+ */
+bool Inotify::dropStaleEvent(const inotify_event* event)
 {
-    mStopped = true;
-    sendStopSignal();
+    uint32_t generation = 0;
+    StaleReason reason = StaleReason::removed;
+
+    auto retired = mRetiredWatches.lower_bound(event->wd);
+    if (retired != mRetiredWatches.end() && retired->first == event->wd) {
+        generation = retired->second;
+    } else if (mWatchEntries.count(event->wd) && mDirectorieMap.left.count(event->wd)) {
+        return false;
+    } else {
+        reason = StaleReason::unknown;
+    }
+
+    ++mStaleEventCount;
+    if (mOnStaleEvent) {
+        mOnStaleEvent(StaleEvent { event->wd,
+                                   event->mask,
+                                   event->cookie,
+                                   std::string(event->name, strnlen(event->name, event->len)),
+                                   generation,
+                                   reason });
+    }
+
+    return true;
 }
 
-void Inotify::sendStopSignal()
+/**
+ * @brief Sets the global event mask. Events that are added
+ *        are pushed to existing watches immediately, so no
+ *        event gets lost. Reduced masks are applied lazily
+ *        in bulk by the event loop (see updateWatchMasks).
+ *
+ * @param eventMask of all watches
+ *
+ */
+void Inotify::setEventMask(uint32_t eventMask)
 {
-    std::vector<std::uint8_t> buf(1,0);
-    write(mStopPipeFd[mPipeWriteIdx], buf.data(), buf.size());
+    runCommand([&]() {
+        auto addedEvents = eventMask & ~mEventMask;
+        mEventMask = eventMask;
+        mWatchMasksOutdated = true;
+
+        if (addedEvents) {
+            updateWatchMasks();
+        }
+    });
 }
 
-bool Inotify::hasStopped()
+uint32_t Inotify::getEventMask()
 {
-    return mStopped;
+    uint32_t eventMask = 0;
+    runCommand([&]() { eventMask = mEventMask; });
+    return eventMask;
 }
 
-bool Inotify::isIgnored(std::string file)
+/**
+ * @brief Sets a function that adds path specific events
+ *        to the global event mask of a watch. Call
+ *        invalidateWatchMasks and updateWatchMasks when the
+ *        result of the provider changes.
+ */
+void Inotify::setWatchMaskProvider(
+    std::function<uint32_t(const fs::path&)> watchMaskProvider)
 {
-    for (unsigned i = 0; i < mOnceIgnoredDirectories.size(); ++i) {
-        size_t pos = file.find(mOnceIgnoredDirectories[i]);
-        if (pos != std::string::npos) {
-            mOnceIgnoredDirectories.erase(mOnceIgnoredDirectories.begin() + i);
-            return true;
+    runCommand([&]() {
+        mWatchMaskProvider = watchMaskProvider;
+        mWatchMasksOutdated = true;
+    });
+}
+
+void Inotify::invalidateWatchMasks()
+{
+    runCommand([&]() { mWatchMasksOutdated = true; });
+}
+
+/**
+ * @brief Returns the mask that is currently installed
+ *        in the kernel for the given path. 0 if the
+ *        path is not watched or parked.
+ */
+uint32_t Inotify::getWatchMask(fs::path file)
+{
+    uint32_t eventMask = 0;
+    runCommand([&]() {
+        auto watch = mDirectorieMap.right.find(file);
+        if (watch != mDirectorieMap.right.end()) {
+            eventMask = mWatchMasks[watch->second];
         }
+    });
+
+    return eventMask;
+}
+
+uint32_t Inotify::watchMaskFor(const fs::path& file)
+{
+    if (isIgnoredPermanently(file.string())) {
+        return 0;
     }
 
-    for (unsigned i = 0; i < mIgnoredDirectories.size(); ++i) {
-        size_t pos = file.find(mIgnoredDirectories[i]);
-        if (pos != std::string::npos) {
-            return true;
-        }
+    auto eventMask = mEventMask;
+    if (mWatchMaskProvider) {
+        eventMask |= mWatchMaskProvider(file);
     }
 
-    return false;
+    auto requestedEventMask = mRequestedEventMasks.find(file);
+    if (requestedEventMask == mRequestedEventMasks.end()) {
+        return eventMask;
+    }
+
+    return eventMask & requestedEventMask->second;
 }
 
-bool Inotify::isOnTimeout(const std::chrono::steady_clock::time_point &eventTime)
+/**
+ * @return union of the masks of the path and of its aliases, which share
+ *         the watch of the path
+ */
+uint32_t Inotify::sharedWatchMaskFor(const fs::path& file)
 {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(eventTime - mLastEventTime) < mEventTimeout;
+    auto eventMask = watchMaskFor(file);
+    auto aliases = mPathAliases.equal_range(file);
+    for (auto alias = aliases.first; alias != aliases.second; ++alias) {
+        eventMask |= watchMaskFor(alias->second);
+    }
+
+    return eventMask;
 }
 
-ssize_t Inotify::readEventsIntoBuffer(std::vector<uint8_t>& eventBuffer)
+/**
+ * @brief Recomputes the mask of every watch and pushes
+ *        changed masks to the kernel in one pass. Masks
+ *        that only grow are extended with IN_MASK_ADD,
+ *        others are replaced by re-adding the watch.
+ *        Watches whose mask becomes empty are removed
+ *        from the kernel and parked until their mask
+ *        becomes non empty again.
+ */
+void Inotify::updateWatchMasks()
 {
-    ssize_t length = 0;
-    length = 0;
-    auto timeout = -1;
-    auto nFdsReady = epoll_wait(mEpollFd, mEpollEvents, MAX_EPOLL_EVENTS, timeout);
+    if (tCommandOwner != this) {
+        runCommand([this]() { updateWatchMasks(); });
+        return;
+    }
 
-    if (nFdsReady == -1) {
-        return length;
+    if (!mWatchMasksOutdated) {
+        return;
     }
 
-    for (auto n = 0; n < nFdsReady; ++n) {
-        if (mEpollEvents[n].data.fd == mStopPipeFd[mPipeReadIdx]) {
-            break;
-        }
+    mWatchMasksOutdated = false;
 
-        length = read(mEpollEvents[n].data.fd, eventBuffer.data(), eventBuffer.size());
-        if (length == -1) {
-            mError = errno;
-            if(mError == EINTR){
-                break;
-            }
-        }
+    std::vector<std::pair<int, fs::path>> watches;
+    for (auto& watch : mDirectorieMap.left) {
+        watches.emplace_back(watch.first, watch.second);
     }
 
+    for (auto& watch : watches) {
+        auto wd = watch.first;
+        auto& path = watch.second;
+        auto installedMask = mWatchMasks[wd];
+        auto eventMask = sharedWatchMaskFor(path);
+
+        if (eventMask == installedMask) {
+            continue;
+        }
+
+        if (eventMask == 0) {
+            inotify_rm_watch(mInotifyFd, wd);
+            retireWatch(wd, true);
+            mParkedWatches.insert(path);
+            continue;
+        }
+
+        int result = 0;
+        if ((eventMask & installedMask) == installedMask) {
+            result = inotify_add_watch(
+                mInotifyFd, path.string().c_str(), (eventMask & ~installedMask) | IN_MASK_ADD);
+        } else {
+            result = inotify_add_watch(mInotifyFd, path.string().c_str(), eventMask);
+        }
+
+        // The path might have been removed meanwhile, its IN_IGNORED event will clean up
+        if (result == wd) {
+            mWatchMasks[wd] = eventMask;
+        } else if (result != -1) {
+            // The path was replaced by another inode, which got a new watch
+            inotify_rm_watch(mInotifyFd, wd);
+            retireWatch(wd, true);
+            addWatch(path, eventMask);
+        }
+    }
+
+    std::vector<fs::path> parkedWatches(mParkedWatches.begin(), mParkedWatches.end());
+    for (auto& path : parkedWatches) {
+        auto eventMask = sharedWatchMaskFor(path);
+        if (eventMask != 0 && fs::exists(path)) {
+            addWatch(path, eventMask);
+        }
+    }
+}
+
+/**
+ * @brief Sets a filter on the names of events. It is
+ *        evaluated on the raw kernel records, so rejected
+ *        events never construct a path. Events of directories
+ *        are not filtered.
+ *
+ * @param nameFilter
+ *
+ */
+void Inotify::setNameFilter(NameFilter nameFilter)
+{
+    runCommand([&]() { mNameFilter = nameFilter; });
+}
+
+uint64_t Inotify::getNameFilteredEventCount()
+{
+    uint64_t count = 0;
+    runCommand([&]() { count = mNameFilteredEventCount; });
+    return count;
+}
+
+/**
+ * @brief Bounds the number of queued events. Events that
+ *        can not be queued are handled according to the
+ *        policy. Lost events are reported by an event with
+ *        IN_Q_OVERFLOW set, the same way the kernel reports
+ *        an overflow of its own queue.
+ *
+ * @param capacity maximum number of queued events
+ * @param policy applied when the queue is full
+ *
+ */
+void Inotify::setEventQueueCapacity(std::size_t capacity, QueueOverflowPolicy policy)
+{
+    runCommand([&]() { mEventQueue.setCapacity(capacity, policy); });
+}
+
+EventQueueStatistics Inotify::getEventQueueStatistics()
+{
+    EventQueueStatistics statistics {};
+    runCommand([&]() { statistics = mEventQueue.getStatistics(); });
+    return statistics;
+}
+
+uint64_t Inotify::getKernelOverflowCount()
+{
+    uint64_t count = 0;
+    runCommand([&]() { count = mKernelOverflowCount; });
+    return count;
+}
+
+/**
+ * @brief Queues events of the subtree in the lane of the given
+ *        priority. Higher lanes are dispatched first and keep
+ *        their latency when lower lanes are flooded. Each lane
+ *        is bounded by the event queue capacity on its own.
+ *
+ * @param subtree file or directory
+ * @param priority of the lane, the default lane has priority 0
+ * @param weight of the lane for LaneScheduling::weighted
+ *
+ */
+void Inotify::addPriorityLane(fs::path subtree, unsigned priority, unsigned weight)
+{
+    runCommand([&]() { mEventQueue.addLane(subtree, priority, weight); });
+}
+
+void Inotify::setLaneScheduling(LaneScheduling scheduling)
+{
+    runCommand([&]() { mEventQueue.setScheduling(scheduling); });
+}
+
+std::vector<LaneStatistics> Inotify::getLaneStatistics()
+{
+    std::vector<LaneStatistics> statistics;
+    runCommand([&]() { statistics = mEventQueue.getLaneStatistics(); });
+    return statistics;
+}
+
+void Inotify::setEventTimeout(
+    std::chrono::milliseconds eventTimeout, std::function<void(FileSystemEvent)> onEventTimeout)
+{
+    runCommand([&]() {
+        mLastEventTime -= eventTimeout;
+        mEventTimeout = eventTimeout;
+        mOnEventTimeout = onEventTimeout;
+    });
+}
+
+/**
+ * @brief Blocking wait on new events of watched files/directories
+ *        specified on the eventmask. FileSystemEvents
+ *        will be returned one by one. Thus this
+ *        function can be called in some while(true)
+ *        loop.
+ *
+ * If events were lost since the last call, because of a
+ * full kernel queue or a full event queue, an event with
+ * IN_Q_OVERFLOW and an empty path is returned first.
+ *
+ * @return A new FileSystemEvent
+ *
+ */
+inotifypp::optional<FileSystemEvent> Inotify::getNextEvent()
+{
+    std::vector<FileSystemEvent> newEvents;
+    enterEventLoop();
+
+    // Decode new kernel records before dispatching queued ones, so events
+    // of a high lane overtake the backlog of a flooded lane
+    if (mEventQueue.hasLanes() && !mEventQueue.empty()) {
+        pollEvents(newEvents);
+    }
+
+    while (mEventQueue.empty() && !mEventsLost && !mStopped) {
+        if (mCommandsPending) {
+            runPendingCommands(1);
+        }
+        updateWatchMasks();
+
+        // Records left over from a blocked decode are consumed before reading again
+        if (mEventBufferOffset >= mEventBufferLength) {
+            mEventBufferOffset = 0;
+            mEventBufferLength = std::max<int>(readEventsIntoBuffer(), 0);
+        }
+
+        newEvents.clear();
+        mEventBufferOffset += readEventsFromBuffer(
+            mEventBuffer.data() + mEventBufferOffset,
+            mEventBufferLength - mEventBufferOffset,
+            newEvents,
+            mEventQueue.available());
+        if (mEventBufferOffset < mEventBufferLength) {
+            mEventQueue.countBlockedRead();
+        }
+
+        filterEvents(newEvents, mEventQueue);
+    }
+
+    if (mStopped && mEventSampler) {
+        flushSampledEvents();
+    }
+
+    // The event is taken while commands of other threads still wait for the loop
+    inotifypp::optional<FileSystemEvent> event;
+    if (mStopped) {
+        // The counts of sampled events that were not delivered yet are returned after a stop
+        if (!mFlushedEvents.empty()) {
+            event = mFlushedEvents.front();
+            mFlushedEvents.pop_front();
+        }
+    } else if (mEventsLost) {
+        mEventsLost = false;
+        event = FileSystemEvent(-1, IN_Q_OVERFLOW, fs::path(), std::chrono::steady_clock::now());
+    } else {
+        event = mEventQueue.front();
+        mEventQueue.pop();
+    }
+
+    leaveEventLoop();
+    return event;
+}
+
+/**
+ * @brief Blocking read of the next kernel records as
+ *        structure of arrays. The records are not
+ *        filtered, timestamped or queued and no paths
+ *        are constructed. The batch refers to the
+ *        internal event buffer and is valid until the
+ *        next read. Do not mix with getNextEvent.
+ *
+ * @return number of records in the batch, 0 if stopped
+ *
+ */
+std::size_t Inotify::readEventBatch(EventBatch& batch)
+{
+    batch.clear();
+    enterEventLoop();
+
+    while (batch.empty() && !mStopped) {
+        if (mCommandsPending) {
+            runPendingCommands(1);
+        }
+        updateWatchMasks();
+
+        if (mEventBufferOffset >= mEventBufferLength) {
+            mEventBufferOffset = 0;
+            mEventBufferLength = std::max<int>(readEventsIntoBuffer(), 0);
+        }
+
+        auto consumed = decodeEventBatch(
+            mEventBuffer.data() + mEventBufferOffset,
+            mEventBufferLength - mEventBufferOffset,
+            batch);
+        INOTIFY_PROBE(decode, consumed, batch.size());
+        mEventBufferOffset += consumed;
+    }
+
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (batch.masks[i] & IN_IGNORED) {
+            handleIgnored(batch.wds[i]);
+        } else if (mHeavyHitters) {
+            countHeavyHitter(
+                batch.wds[i],
+                reinterpret_cast<const char*>(batch.buffer) + batch.nameOffsets[i],
+                batch.nameLengths[i]);
+        }
+        if (batch.masks[i] & IN_Q_OVERFLOW) {
+            ++mKernelOverflowCount;
+        }
+    }
+
+    leaveEventLoop();
+    return batch.size();
+}
+
+/**
+ * @brief Counts the events of every watch and name in a streaming top-K
+ *        (see HeavyHitters) while records are decoded. With a hotShare
+ *        above 0, every checkInterval events the watches that produced at
+ *        least hotShare of all events so far get the configured action
+ *        applied once and are reported to the observer, which is called
+ *        from the event loop. Replaces the counts of a previous call.
+ */
+void Inotify::trackHeavyHitters(HeavyHittersOptions options, HotPathObserver onHotPath)
+{
+    runCommand([&]() {
+        mHeavyHitters = std::make_unique<HeavyHitters>(
+            options.topK, options.sketchWidth, options.sketchDepth);
+        mHeavyHittersOptions = options;
+        mOnHotPath = onHotPath;
+        mHotWatches.clear();
+    });
+}
+
+/**
+ * @return busiest watched directories, highest count first
+ */
+std::vector<HotPath> Inotify::getHotDirectories()
+{
+    std::vector<HotPath> hotPaths;
+    runCommand([&]() {
+        if (mHeavyHitters) {
+            hotPaths = toHotPaths(mHeavyHitters->getDirectories());
+        }
+    });
+
+    return hotPaths;
+}
+
+/**
+ * @return busiest files, highest count first
+ */
+std::vector<HotPath> Inotify::getHotFiles()
+{
+    std::vector<HotPath> hotPaths;
+    runCommand([&]() {
+        if (mHeavyHitters) {
+            hotPaths = toHotPaths(mHeavyHitters->getFiles());
+        }
+    });
+
+    return hotPaths;
+}
+
+/**
+ * @brief Lets the reader spin on non-blocking reads of the inotify
+ *        descriptor instead of sleeping in epoll_wait, which saves the
+ *        wakeup and scheduling delay at the cost of one busy core. After
+ *        options.idleThreshold without records the reader blocks in
+ *        epoll_wait again and resumes spinning with the next record. The
+ *        thread that reads events is pinned to options.cpu, if set, until
+ *        busy polling is disabled.
+ */
+void Inotify::enableBusyPolling(BusyPollOptions options)
+{
+    runCommand([&]() {
+        mBusyPolling = true;
+        mBusyPollOptions = options;
+        mPinnedThread = std::thread::id();
+        mLastRecordTime = std::chrono::steady_clock::now();
+    });
+}
+
+void Inotify::disableBusyPolling()
+{
+    runCommand([&]() {
+        mBusyPolling = false;
+        restoreReaderAffinity();
+    });
+}
+
+BusyPollStatistics Inotify::getBusyPollStatistics()
+{
+    BusyPollStatistics statistics {};
+    runCommand([&]() {
+        statistics = mBusyPollStatistics;
+        if (statistics.spinReads) {
+            statistics.meanWakeLatency = mTotalWakeLatency / statistics.spinReads;
+        }
+    });
+
+    return statistics;
+}
+
+/**
+ * @brief Delivers only a sample of the events that are not marked as must
+ *        deliver (see SamplingOptions). The sampling is decided on the raw
+ *        records before paths are constructed, delivered events carry the
+ *        number of events they represent. Replaces a previous sampler.
+ *        readEventBatch is not sampled.
+ */
+void Inotify::setSampling(SamplingOptions options)
+{
+    runCommand([&]() { mEventSampler = std::make_unique<EventSampler>(options); });
+}
+
+/**
+ * @brief Sets the sizing of the buffer kernel records are read into. It
+ *        is applied by the next read, records in the buffer are kept.
+ */
+void Inotify::setReadBufferOptions(ReadBufferOptions options)
+{
+    runCommand([&]() { mEventBuffer.setOptions(options); });
+}
+
+ReadBufferStatistics Inotify::getReadBufferStatistics()
+{
+    ReadBufferStatistics statistics;
+    runCommand([&]() { statistics = mEventBuffer.getStatistics(); });
+    return statistics;
+}
+
+SamplingStatistics Inotify::getSamplingStatistics()
+{
+    SamplingStatistics statistics { 0, 0 };
+    runCommand([&]() {
+        if (mEventSampler) {
+            statistics = mEventSampler->getStatistics();
+        }
+    });
+
+    return statistics;
+}
+
+/**
+ * @brief Observes records of watch descriptors without a current watch.
+ *        The observer is called from the event loop.
+ */
+void Inotify::onStaleEvent(StaleEventObserver onStaleEvent)
+{
+    runCommand([&]() { mOnStaleEvent = onStaleEvent; });
+}
+
+/**
+ * @brief Observes the descriptors of watches that are forgotten, e.g. to
+ *        drop state that is cached per descriptor before it is reused.
+ *        The observer is called from the event loop.
+ */
+void Inotify::onWatchRemoved(std::function<void(int)> onWatchRemoved)
+{
+    runCommand([&]() { mOnWatchRemoved = onWatchRemoved; });
+}
+
+/**
+ * @return number of dropped records of watch descriptors without a current watch
+ */
+uint64_t Inotify::getStaleEventCount()
+{
+    uint64_t count = 0;
+    runCommand([&]() { count = mStaleEventCount; });
+    return count;
+}
+
+/**
+ * @return path of the watch descriptor or an empty path if unknown
+ */
+fs::path Inotify::getWatchPath(int wd)
+{
+    fs::path path;
+    runCommand([&]() {
+        auto watch = mDirectorieMap.left.find(wd);
+        if (watch != mDirectorieMap.left.end()) {
+            path = watch->second;
+        }
+    });
+
+    return path;
+}
+
+void Inotify::stop()
+{
+    mStopped = true;
+    sendStopSignal();
+}
+
+void Inotify::sendStopSignal()
+{
+    std::vector<std::uint8_t> buf(1,0);
+    write(mStopPipeFd[mPipeWriteIdx], buf.data(), buf.size());
+}
+
+bool Inotify::hasStopped()
+{
+    return mStopped;
+}
+
+/**
+ * @brief Applies the command to the state of this instance and
+ *        waits until it is done. Exceptions of the command are
+ *        rethrown.
+ */
+void Inotify::runCommand(std::function<void()> command)
+{
+    if (tCommandOwner == this) {
+        command();
+        return;
+    }
+
+    submitCommand(command).get();
+}
+
+/**
+ * @brief Queues the command for the running event loop and wakes
+ *        it up. Without an event loop the pending commands are
+ *        applied by the calling thread.
+ */
+std::future<void> Inotify::submitCommand(std::function<void()> command)
+{
+    std::packaged_task<void()> task(command);
+    auto result = task.get_future();
+
+    if (tCommandOwner == this) {
+        task();
+        return result;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mCommandMutex);
+        mCommands.push_back(std::move(task));
+        mCommandsPending = true;
+    }
+
+    // Either the event loop sees the pending command or we see the event loop
+    if (mEventLoopActive) {
+        uint64_t wakeup = 1;
+        write(mCommandFd, &wakeup, sizeof(wakeup));
+    } else {
+        runPendingCommands(mCommands.max_size());
+    }
+
+    return result;
+}
+
+/**
+ * @brief Applies up to maxCommands queued commands. The lock is
+ *        held until they are applied, so a thread that started the
+ *        event loop meanwhile waits for them.
+ */
+void Inotify::runPendingCommands(std::size_t maxCommands)
+{
+    std::lock_guard<std::recursive_mutex> lock(mCommandMutex);
+    auto previousOwner = tCommandOwner;
+    tCommandOwner = this;
+
+    for (std::size_t i = 0; i < maxCommands && !mCommands.empty(); ++i) {
+        auto task = std::move(mCommands.front());
+        mCommands.pop_front();
+        task();
+    }
+
+    mCommandsPending = !mCommands.empty();
+    tCommandOwner = previousOwner;
+}
+
+void Inotify::enterEventLoop()
+{
+    mEventLoopActive = true;
+    if (mCommandsPending) {
+        runPendingCommands(mCommands.max_size());
+    }
+    tCommandOwner = this;
+}
+
+void Inotify::leaveEventLoop()
+{
+    mEventLoopActive = false;
+    if (mCommandsPending) {
+        runPendingCommands(mCommands.max_size());
+    }
+    tCommandOwner = nullptr;
+}
+
+bool Inotify::isIgnored(std::string file)
+{
+    for (unsigned i = 0; i < mOnceIgnoredDirectories.size(); ++i) {
+        size_t pos = file.find(mOnceIgnoredDirectories[i]);
+        if (pos != std::string::npos) {
+            mOnceIgnoredDirectories.erase(mOnceIgnoredDirectories.begin() + i);
+            return true;
+        }
+    }
+
+    return isIgnoredPermanently(file);
+}
+
+bool Inotify::isIgnoredPermanently(const std::string& file)
+{
+    for (unsigned i = 0; i < mIgnoredDirectories.size(); ++i) {
+        size_t pos = file.find(mIgnoredDirectories[i]);
+        if (pos != std::string::npos) {
+            return true;
+        }
+    }
+
+    // Matches the path itself or its descendants, but not its siblings
+    for (auto& subtree : mIgnoredSubtrees) {
+        if (file.compare(0, subtree.size(), subtree) == 0
+            && (file.size() == subtree.size() || file[subtree.size()] == '/')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Inotify::isOnTimeout(const std::chrono::steady_clock::time_point &eventTime)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(eventTime - mLastEventTime) < mEventTimeout;
+}
+
+ssize_t Inotify::readEventsIntoBuffer()
+{
+    ssize_t length = 0;
+
+    // Records left over by a read that exceeded the buffer do not trigger
+    // the edge triggered epoll again
+    if (mRecordsPending) {
+        length = readRecords();
+        if (length > 0) {
+            return length;
+        }
+    }
+
+    if (!mBusyPolling && mAffinityThread != std::thread::id()) {
+        restoreReaderAffinity();
+    }
+
+    if (mBusyPolling) {
+        length = busyPoll();
+        if (length > 0 || mCommandsPending || mStopped) {
+            return length;
+        }
+    }
+
+    // A buffer that holds memory for a past burst is released after the
+    // idle timeout, otherwise the loop blocks until the next record
+    length = 0;
+    int timeout = -1;
+    if (mCommandsPending) {
+        timeout = 0;
+    } else if (mEventBuffer.isReleasable()) {
+        timeout = static_cast<int>(mEventBuffer.getIdleTimeout().count());
+    }
+
+    auto nFdsReady = epoll_wait(mEpollFd, mEpollEvents, MAX_EPOLL_EVENTS, timeout);
+    INOTIFY_PROBE(epoll_return, nFdsReady);
+
+    if (nFdsReady == 0 && timeout > 0) {
+        mEventBuffer.release();
+    }
+
+    if (nFdsReady == -1) {
+        return length;
+    }
+
+    for (auto n = 0; n < nFdsReady; ++n) {
+        if (mEpollEvents[n].data.fd == mStopPipeFd[mPipeReadIdx]) {
+            break;
+        }
+
+        if (mEpollEvents[n].data.fd == mCommandFd) {
+            uint64_t wakeups;
+            while (read(mCommandFd, &wakeups, sizeof(wakeups)) > 0) {
+            }
+            // The inotify fd may be reported in the same wait, edge triggered only once
+            continue;
+        }
+
+        length = readRecords();
+        if (length == -1) {
+            mError = errno;
+            if(mError == EINTR){
+                break;
+            }
+        }
+
+        if (length > 0 && mBusyPolling) {
+            mLastRecordTime = std::chrono::steady_clock::now();
+            ++mBusyPollStatistics.epollReads;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * @brief Spins on non-blocking reads until records arrive, the idle
+ *        threshold passed since the last record, a command is pending
+ *        or the loop is stopped.
+ *
+ * @return number of read bytes, 0 if the reader should block in epoll_wait
+ */
+ssize_t Inotify::busyPoll()
+{
+    if (mPinnedThread != std::this_thread::get_id()) {
+        pinReaderThread();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto lastPoll = start;
+    ssize_t length = 0;
+
+    while (!mStopped && !mCommandsPending) {
+        length = readRecords();
+        auto now = std::chrono::steady_clock::now();
+
+        if (length > 0) {
+            auto wakeLatency = now - lastPoll;
+            mTotalWakeLatency += wakeLatency;
+            mBusyPollStatistics.maxWakeLatency = std::max<std::chrono::nanoseconds>(
+                mBusyPollStatistics.maxWakeLatency, wakeLatency);
+            ++mBusyPollStatistics.spinReads;
+            mBusyPollStatistics.spinTime += now - start;
+            mLastRecordTime = now;
+            return length;
+        }
+
+        if (now - mLastRecordTime >= mBusyPollOptions.idleThreshold) {
+            ++mBusyPollStatistics.backoffs;
+            break;
+        }
+
+        lastPoll = now;
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+
+    mBusyPollStatistics.spinTime += std::chrono::steady_clock::now() - start;
+    return 0;
+}
+
+/**
+ * @brief Reads the pending kernel records into the event buffer, which is
+ *        sized by their number of bytes (FIONREAD) first. Without pending
+ *        records nothing is read, so spinning costs a single syscall.
+ *
+ * @return number of read bytes, 0 if no records are pending, -1 on error
+ */
+ssize_t Inotify::readRecords()
+{
+    int pending = 0;
+    if (ioctl(mInotifyFd, FIONREAD, &pending) == -1 || pending <= 0) {
+        return 0;
+    }
+
+    mEventBuffer.reserve(pending);
+    auto length = read(mInotifyFd, mEventBuffer.data(), mEventBuffer.size());
+    INOTIFY_PROBE(read, length);
+
+    if (length > 0) {
+        mEventBuffer.countRead(pending);
+    }
+    mRecordsPending = length > 0 && static_cast<std::size_t>(pending) > mEventBuffer.size();
     return length;
 }
 
-void Inotify::readEventsFromBuffer(
-    uint8_t* buffer, int length, std::vector<inotify::FileSystemEvent>& events)
+void Inotify::pinReaderThread()
 {
+    mPinnedThread = std::this_thread::get_id();
+    mBusyPollStatistics.pinned = false;
+    if (mBusyPollOptions.cpu < 0) {
+        restoreReaderAffinity();
+        return;
+    }
+
+    // A thread that is pinned already keeps the affinity it had before
+    if (mAffinityThread != mPinnedThread
+        && pthread_getaffinity_np(pthread_self(), sizeof(mReaderAffinity), &mReaderAffinity)
+            == 0) {
+        mAffinityThread = mPinnedThread;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(mBusyPollOptions.cpu, &cpus);
+    mBusyPollStatistics.pinned
+        = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+/**
+ * @brief Gives the pinned reader thread the affinity it had before busy
+ *        polling back. Only that thread can restore it, other threads
+ *        leave it to its next read.
+ */
+void Inotify::restoreReaderAffinity()
+{
+    if (mAffinityThread != std::this_thread::get_id()) {
+        return;
+    }
+
+    pthread_setaffinity_np(pthread_self(), sizeof(mReaderAffinity), &mReaderAffinity);
+    mAffinityThread = std::thread::id();
+    mBusyPollStatistics.pinned = false;
+}
+
+/**
+ * @brief Decodes kernel records into FileSystemEvents until
+ *        the buffer is consumed or maxEvents were decoded.
+ *
+ * @return number of consumed bytes
+ */
+int Inotify::readEventsFromBuffer(
+    uint8_t* buffer,
+    int length,
+    std::vector<inotify::FileSystemEvent>& events,
+    std::size_t maxEvents)
+{
+    auto blocksPerLane = mEventQueue.blocksPerLane();
+    if (blocksPerLane) {
+        mEventQueue.clearReservations();
+    }
+
     int i = 0;
-    while (i < length) {
+    while (i < length && events.size() < maxEvents) {
         inotify_event* event = ((struct inotify_event*)&buffer[i]);
 
+        if (event->mask & IN_Q_OVERFLOW) {
+            i += EVENT_SIZE + event->len;
+            ++mKernelOverflowCount;
+            mEventsLost = true;
+            continue;
+        }
+
         if(event->mask & IN_IGNORED){
             i += EVENT_SIZE + event->len;
-            mDirectorieMap.left.erase(event->wd);
+            handleIgnored(event->wd);
             continue;
         }
 
-        auto path = wdToPath(event->wd);
+        // The first record of an unmounted file system is reported for its
+        // mount point, the records of its other watches are expected
+        if (event->mask & IN_UNMOUNT) {
+            i += EVENT_SIZE + event->len;
+            if (mWatchEntries.count(event->wd) && mDirectorieMap.left.count(event->wd)) {
+                auto mountPoint = releaseFileSystem(event->wd);
+                events.emplace_back(
+                    event->wd,
+                    event->mask,
+                    event->cookie,
+                    mountPoint,
+                    std::chrono::steady_clock::now());
+            }
+            continue;
+        }
 
-        if (fs::is_directory(path)) {
-            path = path / std::string(event->name);
+        // Rejected records never touch the watch table or construct a path.
+        // Records of directories pass, so new subdirectories can be watched
+        if (event->len && !(event->mask & IN_ISDIR)
+            && !mNameFilter.accepts(event->name, strnlen(event->name, event->len))) {
+            i += EVENT_SIZE + event->len;
+            ++mNameFilteredEventCount;
+            continue;
         }
 
-        if (fs::is_directory(path)) {
-            event->mask |= IN_ISDIR;
+        // Records queued before the watch was removed or parked, a current
+        // watch has a path and an entry
+        if (dropStaleEvent(event)) {
+            i += EVENT_SIZE + event->len;
+            continue;
+        }
+        const auto& watchPath = mDirectorieMap.left.find(event->wd)->second;
+        const auto& watchEntry = mWatchEntries.find(event->wd)->second;
+
+        // The events of all paths of a shared watch are queued together
+        const std::vector<std::pair<std::size_t, fs::path>>* pathAliases = nullptr;
+        if (mSymlinkPolicy == SymlinkPolicy::fan_out && !mPathAliasesOfWatch.empty()) {
+            auto aliases = mPathAliasesOfWatch.find(event->wd);
+            if (aliases != mPathAliasesOfWatch.end()) {
+                pathAliases = &aliases->second;
+                if (!events.empty() && events.size() + pathAliases->size() >= maxEvents) {
+                    break;
+                }
+            }
+        }
+
+        // A record stays in the buffer only if its own lane is full
+        if (blocksPerLane && !reserveLanes(event, watchPath, watchEntry, pathAliases)) {
+            break;
+        }
+
+        if (mHeavyHitters) {
+            countHeavyHitter(event->wd, event->name, strnlen(event->name, event->len));
+        }
+
+        uint32_t count = 1;
+        if (mEventSampler
+            && !mEventSampler->accept(
+                event->wd, event->mask, event->name, strnlen(event->name, event->len), count)) {
+            i += EVENT_SIZE + event->len;
+            continue;
+        }
+
+        // The kernel sets IN_ISDIR for records of entries of a watched
+        // directory, only records of the watched path itself need the flag
+        auto path = watchPath;
+        if (watchEntry.directory) {
+            if (event->len) {
+                path /= std::string(event->name, strnlen(event->name, event->len));
+            } else {
+                event->mask |= IN_ISDIR;
+            }
         }
-        FileSystemEvent fsEvent(event->wd, event->mask, path, std::chrono::steady_clock::now());
+
+        FileSystemEvent fsEvent(
+            event->wd, event->mask, event->cookie, path, std::chrono::steady_clock::now());
+        fsEvent.count = count;
 
         if (!fsEvent.path.empty()) {
             events.push_back(fsEvent);
 
+            if (pathAliases) {
+                for (auto& alias : *pathAliases) {
+                    fsEvent.path = alias.second.string() + path.string().substr(alias.first);
+                    events.push_back(fsEvent);
+                }
+            }
         } else {
             // Event is not complete --> ignore
         }
 
         i += EVENT_SIZE + event->len;
     }
+
+    INOTIFY_PROBE(decode, i, events.size());
+    return i;
+}
+
+/**
+ * @brief Reserves the places of the events of the record, one per path of
+ *        the watch, in their lanes.
+ *
+ * @return false if a lane is full
+ */
+bool Inotify::reserveLanes(
+    const inotify_event* event,
+    const fs::path& watchPath,
+    const WatchEntry& watchEntry,
+    const std::vector<std::pair<std::size_t, fs::path>>* pathAliases)
+{
+    auto path = watchPath;
+    if (watchEntry.directory && event->len) {
+        path /= std::string(event->name, strnlen(event->name, event->len));
+    }
+
+    if (!mEventQueue.reserve(event->wd, path)) {
+        return false;
+    }
+
+    if (pathAliases) {
+        for (auto& alias : *pathAliases) {
+            if (!mEventQueue.reserve(
+                    event->wd, alias.second.string() + path.string().substr(alias.first))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Queues an event with the pending count of every sampled path and
+ *        event type whose watch still exists.
+ */
+void Inotify::flushSampledEvents()
+{
+    for (auto& sample : mEventSampler->flush()) {
+        auto watch = mDirectorieMap.left.find(sample.wd);
+        auto entry = mWatchEntries.find(sample.wd);
+        if (watch == mDirectorieMap.left.end() || entry == mWatchEntries.end()) {
+            continue;
+        }
+
+        auto path = watch->second;
+        if (entry->second.directory && !sample.name.empty()) {
+            path /= sample.name;
+        }
+
+        FileSystemEvent event(
+            sample.wd, sample.mask, 0, path, std::chrono::steady_clock::now());
+        event.count = sample.count;
+        mFlushedEvents.push_back(event);
+    }
+}
+
+void Inotify::countHeavyHitter(int wd, const char* name, std::size_t length)
+{
+    mHeavyHitters->add(wd, name, length);
+
+    if (mHeavyHittersOptions.hotShare > 0 && mHeavyHittersOptions.checkInterval
+        && mHeavyHitters->getEventCount() % mHeavyHittersOptions.checkInterval == 0) {
+        handleHotPaths();
+    }
+}
+
+/**
+ * @brief Applies the hot path action to every watch above the hot share
+ *        that was not handled before.
+ */
+void Inotify::handleHotPaths()
+{
+    auto eventCount = mHeavyHitters->getEventCount();
+    for (auto& heavyHitter : mHeavyHitters->getDirectories()) {
+        auto share = static_cast<double>(heavyHitter.count) / eventCount;
+        if (share < mHeavyHittersOptions.hotShare) {
+            break;
+        }
+
+        auto watch = mDirectorieMap.left.find(heavyHitter.wd);
+        if (watch == mDirectorieMap.left.end() || !mHotWatches.insert(heavyHitter.wd).second) {
+            continue;
+        }
+
+        auto path = watch->second;
+        if (mHeavyHittersOptions.action == HotPathAction::ignore) {
+            mIgnoredSubtrees.push_back(path.string());
+            mWatchMasksOutdated = true;
+        } else if (mHeavyHittersOptions.action == HotPathAction::reduce_mask) {
+            auto requestedEventMask = mRequestedEventMasks.find(path);
+            auto eventMask = requestedEventMask == mRequestedEventMasks.end()
+                ? ~0u
+                : requestedEventMask->second;
+            mRequestedEventMasks[path] = eventMask & ~mHeavyHittersOptions.reducedEvents;
+            mWatchMasksOutdated = true;
+        }
+
+        if (mOnHotPath) {
+            mOnHotPath(HotPath { path, heavyHitter.count, share });
+        }
+    }
+}
+
+std::vector<HotPath> Inotify::toHotPaths(const std::vector<HeavyHitter>& heavyHitters)
+{
+    std::vector<HotPath> hotPaths;
+    auto eventCount = std::max<std::uint64_t>(mHeavyHitters->getEventCount(), 1);
+    for (auto& heavyHitter : heavyHitters) {
+        auto watch = mDirectorieMap.left.find(heavyHitter.wd);
+        if (watch == mDirectorieMap.left.end()) {
+            continue;
+        }
+
+        auto path = heavyHitter.name.empty() ? watch->second : watch->second / heavyHitter.name;
+        auto share = static_cast<double>(heavyHitter.count) / eventCount;
+        hotPaths.push_back(HotPath { path, heavyHitter.count, share });
+    }
+
+    return hotPaths;
+}
+
+/**
+ * @brief Decodes pending kernel records without blocking.
+ */
+void Inotify::pollEvents(std::vector<FileSystemEvent>& events)
+{
+    if (mEventBufferOffset >= mEventBufferLength) {
+        mEventBufferOffset = 0;
+        mEventBufferLength = std::max<int>(readRecords(), 0);
+    }
+
+    events.clear();
+    mEventBufferOffset += readEventsFromBuffer(
+        mEventBuffer.data() + mEventBufferOffset,
+        mEventBufferLength - mEventBufferOffset,
+        events,
+        mEventQueue.available());
+
+    filterEvents(events, mEventQueue);
 }
 
 void Inotify::filterEvents(
-    std::vector<inotify::FileSystemEvent>& events, std::queue<FileSystemEvent>& eventQueue)
+    std::vector<inotify::FileSystemEvent>& events, PriorityEventQueue& eventQueue)
 {
     for (auto eventIt = events.begin(); eventIt < events.end();) {
         FileSystemEvent currentEvent = *eventIt;
         if (isOnTimeout(currentEvent.eventTime)) {
+            INOTIFY_PROBE(filter_timeout, currentEvent.wd, currentEvent.mask);
             eventIt = events.erase(eventIt);
             mOnEventTimeout(currentEvent);
         } else if (isIgnored(currentEvent.path.string())) {
+            INOTIFY_PROBE(filter_ignore, currentEvent.wd, currentEvent.mask);
             eventIt = events.erase(eventIt);
         } else {
             mLastEventTime = currentEvent.eventTime;
-            eventQueue.push(currentEvent);
+            if (!eventQueue.push(currentEvent)) {
+                mEventsLost = true;
+            }
             eventIt++;
         }
     }
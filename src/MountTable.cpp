@@ -0,0 +1,125 @@
+#include <inotify-cpp/MountTable.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <sys/sysmacros.h>
+
+namespace inotify {
+
+namespace {
+
+/**
+ * Mount points in mountinfo escape space, tab, newline and backslash as
+ * octal sequences, e.g. \040.
+ */
+std::string unescape(const std::string& field)
+{
+    std::string result;
+    for (std::size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size()
+            && std::isdigit(static_cast<unsigned char>(field[i + 1]))) {
+            result.push_back(static_cast<char>(std::stoi(field.substr(i + 1, 3), nullptr, 8)));
+            i += 3;
+        } else {
+            result.push_back(field[i]);
+        }
+    }
+
+    return result;
+}
+}
+
+bool MountOptions::empty() const
+{
+    return !oneFileSystem && includedTypes.empty() && excludedTypes.empty()
+        && excludedPaths.empty();
+}
+
+/**
+ * @return mounts of this process, empty if /proc is not available
+ */
+MountTable MountTable::read()
+{
+    std::ifstream mountInfo("/proc/self/mountinfo");
+    return parse(mountInfo);
+}
+
+/**
+ * @brief Parses lines of the form
+ *        "36 35 98:0 /root /mnt rw,noatime shared:1 - ext3 /dev/root rw".
+ *        The first mount of a device is kept, further mounts of it are
+ *        bind mounts of the same file system.
+ */
+MountTable MountTable::parse(std::istream& mountInfo)
+{
+    MountTable mountTable;
+    std::string line;
+    while (std::getline(mountInfo, line)) {
+        std::istringstream fields(line);
+        std::string id, parentId, device, root, mountPoint, field;
+        fields >> id >> parentId >> device >> root >> mountPoint;
+
+        // Optional fields are terminated by a single hyphen
+        while (fields >> field && field != "-") {
+        }
+
+        std::string type;
+        unsigned major = 0;
+        unsigned minor = 0;
+        if (!(fields >> type) || std::sscanf(device.c_str(), "%u:%u", &major, &minor) != 2) {
+            continue;
+        }
+
+        mountTable.mMounts.emplace(makedev(major, minor), Mount { unescape(mountPoint), type });
+    }
+
+    return mountTable;
+}
+
+/**
+ * @return mount of the device, nullptr if unknown
+ */
+const Mount* MountTable::find(dev_t device) const
+{
+    auto mount = mMounts.find(device);
+    return mount != mMounts.end() ? &mount->second : nullptr;
+}
+
+/**
+ * @brief Decides whether a crawl crosses into the device at the path. A
+ *        device that is missing in the table, e.g. a btrfs subvolume, has
+ *        an empty type.
+ */
+bool MountTable::admits(
+    dev_t device, const inotifypp::filesystem::path& path, const MountOptions& options) const
+{
+    if (options.oneFileSystem) {
+        return false;
+    }
+
+    auto mount = find(device);
+    auto type = mount ? mount->type : std::string();
+    auto contains = [](const std::vector<std::string>& types, const std::string& type) {
+        return std::find(types.begin(), types.end(), type) != types.end();
+    };
+
+    if (!options.includedTypes.empty() && !contains(options.includedTypes, type)) {
+        return false;
+    }
+
+    if (contains(options.excludedTypes, type)) {
+        return false;
+    }
+
+    return std::none_of(
+        options.excludedPaths.begin(),
+        options.excludedPaths.end(),
+        [&](const inotifypp::filesystem::path& excludedPath) {
+            return excludedPath == path || (mount && excludedPath == mount->mountPoint);
+        });
+}
+}
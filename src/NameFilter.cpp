@@ -0,0 +1,101 @@
+#include <inotify-cpp/NameFilter.h>
+
+#include <cstring>
+
+#include <fnmatch.h>
+
+namespace inotify {
+
+auto NameFilter::includeExtension(std::string extension) -> NameFilter&
+{
+    mIncludes.extensions.push_back(extension);
+    return *this;
+}
+
+auto NameFilter::excludeExtension(std::string extension) -> NameFilter&
+{
+    mExcludes.extensions.push_back(extension);
+    return *this;
+}
+
+auto NameFilter::includeGlob(std::string glob) -> NameFilter&
+{
+    mIncludes.globs.push_back(glob);
+    return *this;
+}
+
+auto NameFilter::excludeGlob(std::string glob) -> NameFilter&
+{
+    mExcludes.globs.push_back(glob);
+    return *this;
+}
+
+auto NameFilter::includeRegex(const std::string& regex) -> NameFilter&
+{
+    mIncludes.regexes.emplace_back(regex, std::regex::optimize);
+    return *this;
+}
+
+auto NameFilter::excludeRegex(const std::string& regex) -> NameFilter&
+{
+    mExcludes.regexes.emplace_back(regex, std::regex::optimize);
+    return *this;
+}
+
+/**
+ * @param name NUL terminated name as found in the kernel event record
+ * @param length of the name without NUL padding
+ */
+auto NameFilter::accepts(const char* name, std::size_t length) const -> bool
+{
+    if (length == 0) {
+        return true;
+    }
+
+    if (!mIncludes.empty() && !mIncludes.matches(name, length)) {
+        return false;
+    }
+
+    return !mExcludes.matches(name, length);
+}
+
+auto NameFilter::accepts(const std::string& name) const -> bool
+{
+    return accepts(name.c_str(), name.size());
+}
+
+auto NameFilter::empty() const -> bool
+{
+    return mIncludes.empty() && mExcludes.empty();
+}
+
+auto NameFilter::Rules::empty() const -> bool
+{
+    return extensions.empty() && globs.empty() && regexes.empty();
+}
+
+auto NameFilter::Rules::matches(const char* name, std::size_t length) const -> bool
+{
+    for (auto& extension : extensions) {
+        if (extension.size() <= length
+            && std::memcmp(name + length - extension.size(), extension.data(), extension.size())
+                == 0) {
+            return true;
+        }
+    }
+
+    for (auto& glob : globs) {
+        if (fnmatch(glob.c_str(), name, 0) == 0) {
+            return true;
+        }
+    }
+
+    for (auto& regex : regexes) {
+        if (std::regex_match(name, name + length, regex)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+}
@@ -1,14 +1,30 @@
 #include <inotify-cpp/Notification.h>
 
+#include <utility>
+
 namespace inotify {
 
 Notification::Notification(
     const Event& event,
     const inotifypp::filesystem::path& path,
-    std::chrono::steady_clock::time_point time)
+    std::chrono::steady_clock::time_point time,
+    std::uint32_t count)
     : event(event)
     , path(path)
     , time(time)
+    , count(count)
+{
+}
+
+Notification::Notification(
+    const Event& event,
+    inotifypp::filesystem::path&& path,
+    std::chrono::steady_clock::time_point time,
+    std::uint32_t count)
+    : event(event)
+    , path(std::move(path))
+    , time(time)
+    , count(count)
 {
 }
 }
@@ -1,10 +1,48 @@
 
 #include <inotify-cpp/NotifierBuilder.h>
 
+#include "Probes.h"
+
 namespace inotify {
 
+namespace {
+
+void notifyObserver(const EventObserver& eventObserver, const Notification& notification)
+{
+    INOTIFY_PROBE(
+        observer_entry,
+        static_cast<std::uint32_t>(notification.event),
+        notification.path.c_str());
+    eventObserver(notification);
+    INOTIFY_PROBE(
+        observer_exit,
+        static_cast<std::uint32_t>(notification.event),
+        notification.path.c_str());
+}
+}
+
 NotifierBuilder::NotifierBuilder()
     : mInotify(std::make_shared<Inotify>())
+    , mSubtreeRouter(std::make_shared<SubtreeRouter>())
+    , mHasEventTimeoutObserver(false)
+{
+    std::weak_ptr<SubtreeRouter> subtreeRouter = mSubtreeRouter;
+    mInotify->setWatchMaskProvider([subtreeRouter](const inotifypp::filesystem::path& path) {
+        auto router = subtreeRouter.lock();
+        return router ? router->eventMaskFor(path) : 0;
+    });
+}
+
+/**
+ * Creates a notifier that receives its events from a shared event bus
+ * instead of its own inotify instance. Watches are managed by the
+ * publishing process, observers are registered as usual. Methods that
+ * configure the inotify instance throw std::runtime_error.
+ */
+NotifierBuilder::NotifierBuilder(std::shared_ptr<SharedEventSubscriber> eventSubscriber)
+    : mSubtreeRouter(std::make_shared<SubtreeRouter>())
+    , mHasEventTimeoutObserver(false)
+    , mEventSubscriber(eventSubscriber)
 {
 }
 
@@ -13,40 +51,99 @@ NotifierBuilder BuildNotifier()
     return {};
 }
 
+NotifierBuilder BuildNotifier(std::shared_ptr<SharedEventSubscriber> eventSubscriber)
+{
+    return NotifierBuilder(eventSubscriber);
+}
+
 auto NotifierBuilder::watchPathRecursively(inotifypp::filesystem::path path) -> NotifierBuilder&
 {
-    mInotify->watchDirectoryRecursively(path);
+    getInotify().watchDirectoryRecursively(path);
     return *this;
 }
 
 auto NotifierBuilder::watchFile(inotifypp::filesystem::path file) -> NotifierBuilder&
 {
-    mInotify->watchFile(file);
+    getInotify().watchFile(file);
+    return *this;
+}
+
+/**
+ * Watches only the given events on the path recursively. The kernel
+ * mask of each watch is the intersection of these events and
+ * the events of all observers.
+ */
+auto NotifierBuilder::watchPathRecursively(inotifypp::filesystem::path path, Event events)
+    -> NotifierBuilder&
+{
+    getInotify().watchDirectoryRecursively(path, static_cast<std::uint32_t>(events));
+    return *this;
+}
+
+auto NotifierBuilder::watchFile(inotifypp::filesystem::path file, Event events)
+    -> NotifierBuilder&
+{
+    getInotify().watchFile(file, static_cast<std::uint32_t>(events));
+    return *this;
+}
+
+/**
+ * Treatment of symlinks by subsequent watchPathRecursively calls. Every
+ * physical directory is watched once, with SymlinkPolicy::fan_out its
+ * events are reported for every path that refers to it.
+ */
+auto NotifierBuilder::setSymlinkPolicy(SymlinkPolicy symlinkPolicy) -> NotifierBuilder&
+{
+    getInotify().setSymlinkPolicy(symlinkPolicy);
+    return *this;
+}
+
+/**
+ * Mounts below the paths of subsequent watchPathRecursively calls that are
+ * watched. When a watched file system is unmounted, all its watches are
+ * dropped and a single Event::unmount is reported.
+ */
+auto NotifierBuilder::setMountOptions(MountOptions mountOptions) -> NotifierBuilder&
+{
+    getInotify().setMountOptions(mountOptions);
     return *this;
 }
 
 auto NotifierBuilder::unwatchFile(inotifypp::filesystem::path file) -> NotifierBuilder&
 {
-    mInotify->unwatchFile(file);
+    getInotify().unwatchFile(file);
     return *this;
 }
 
 auto NotifierBuilder::ignoreFileOnce(inotifypp::filesystem::path file) -> NotifierBuilder&
 {
-    mInotify->ignoreFileOnce(file.string());
+    getInotify().ignoreFileOnce(file.string());
     return *this;
 }
 
 auto NotifierBuilder::ignoreFile(inotifypp::filesystem::path file) -> NotifierBuilder&
 {
-    mInotify->ignoreFile(file.string());
+    getInotify().ignoreFile(file.string());
+    return *this;
+}
+
+/**
+ * Filters events by the name of the affected file. Rejected events are
+ * dropped while decoding the kernel buffer; events of directories pass.
+ *
+ * @param nameFilter
+ * @return
+ */
+auto NotifierBuilder::setNameFilter(NameFilter nameFilter) -> NotifierBuilder&
+{
+    getInotify().setNameFilter(nameFilter);
     return *this;
 }
 
 auto NotifierBuilder::onEvent(Event event, EventObserver eventObserver) -> NotifierBuilder&
 {
-    mInotify->setEventMask(mInotify->getEventMask() | static_cast<std::uint32_t>(event));
     mEventObserver[event] = eventObserver;
+    updateEventMask();
     return *this;
 }
 
@@ -54,18 +151,386 @@ auto NotifierBuilder::onEvents(std::vector<Event> events, EventObserver eventObs
     -> NotifierBuilder&
 {
     for (auto event : events) {
-        mInotify->setEventMask(mInotify->getEventMask() | static_cast<std::uint32_t>(event));
         mEventObserver[event] = eventObserver;
     }
 
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Registers an observer for events on paths inside of the given subtree
+ * only. Events are routed to all matching subtree observers before the
+ * global observers are considered. Watches outside of every subtree do
+ * not request these events from the kernel.
+ */
+auto NotifierBuilder::onEvent(
+    inotifypp::filesystem::path subtree, Event event, EventObserver eventObserver)
+    -> NotifierBuilder&
+{
+    return onEvents(subtree, { event }, eventObserver);
+}
+
+auto NotifierBuilder::onEvents(
+    inotifypp::filesystem::path subtree, std::vector<Event> events, EventObserver eventObserver)
+    -> NotifierBuilder&
+{
+    for (auto event : events) {
+        mSubtreeRouter->subscribe(subtree, event, eventObserver);
+    }
+
+    updateEventMask();
+    if (mInotify) {
+        mInotify->invalidateWatchMasks();
+        mInotify->updateWatchMasks();
+    }
     return *this;
 }
 
 auto NotifierBuilder::onUnexpectedEvent(EventObserver eventObserver) -> NotifierBuilder&
 {
     mUnexpectedEventObserver = eventObserver;
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Hashes the file of every close_write event on a background thread and
+ * calls the changed observer only if its content differs from the last
+ * hash. No-op rewrites go to the unchanged observer, if given. Both
+ * observers are called from the hashing threads. The regular close_write
+ * observers are not affected.
+ *
+ * @param changedObserver
+ * @param unchangedObserver
+ * @param options hashing threads, size of the digest cache and of the read chunks
+ * @return
+ */
+auto NotifierBuilder::onContentChange(
+    EventObserver changedObserver, EventObserver unchangedObserver, ContentChangeOptions options)
+    -> NotifierBuilder&
+{
+    mContentChangeDetector
+        = std::make_shared<ContentChangeDetector>(changedObserver, unchangedObserver, options);
+    updateEventMask();
+    return *this;
+}
+
+auto NotifierBuilder::getContentHashStatistics() -> ContentHashStatistics
+{
+    return mContentChangeDetector ? mContentChangeDetector->getStatistics()
+                                  : ContentHashStatistics { 0, 0, 0, 0, 0, 0, 0 };
+}
+
+/**
+ * Summarizes events per directory instead of notifying each of them. Events
+ * are rolled up to the directories options.depth levels below the given
+ * roots and every options.window the observer is called once per directory
+ * with events, from a background thread. Other observers still receive the
+ * single events.
+ *
+ * @param options
+ * @param summaryObserver
+ * @return
+ */
+auto NotifierBuilder::aggregateEvents(
+    AggregationOptions options, EventSummaryObserver summaryObserver) -> NotifierBuilder&
+{
+    // The watches of a shared event bus are unknown, its events carry their paths
+    std::function<inotifypp::filesystem::path(int)> watchPath;
+    if (mInotify) {
+        std::weak_ptr<Inotify> inotify = mInotify;
+        watchPath = [inotify](int wd) {
+            auto watches = inotify.lock();
+            return watches ? watches->getWatchPath(wd) : inotifypp::filesystem::path();
+        };
+    }
+
+    mEventAggregator = std::make_shared<EventAggregator>(options, watchPath, summaryObserver);
+    if (mInotify) {
+        std::weak_ptr<EventAggregator> eventAggregator = mEventAggregator;
+        mInotify->onWatchRemoved([eventAggregator](int wd) {
+            auto aggregator = eventAggregator.lock();
+            if (aggregator) {
+                aggregator->forgetWatch(wd);
+            }
+        });
+    }
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Notifies once per written file instead of every create, open, modify and
+ * close of the writers. The observer is called from a background thread
+ * with Event::close_write when the file was not open anymore and had no
+ * events for the quiet period.
+ *
+ * @param quietPeriod
+ * @param eventObserver
+ * @return
+ */
+auto NotifierBuilder::onFileSettled(
+    std::chrono::milliseconds quietPeriod, EventObserver eventObserver) -> NotifierBuilder&
+{
+    mWriteCompletionDetector
+        = std::make_shared<WriteCompletionDetector>(quietPeriod, eventObserver);
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Derives the kernel event mask from the registered observers. Only
+ * events somebody listens to are requested from the kernel. The
+ * unexpected event observer and the event timeout observer may be
+ * called for any event, so they need all events. Events of subtree
+ * observers are added per watch by the watch mask provider.
+ */
+auto NotifierBuilder::updateEventMask() -> void
+{
+    if (!mInotify) {
+        return;
+    }
+
+    std::uint32_t eventMask = 0;
+    for (auto& eventAndEventObserver : mEventObserver) {
+        eventMask |= watchMaskOf(eventAndEventObserver.first);
+    }
+
+    if (!mEventObserver.empty()) {
+        eventMask = observedWatchMask(eventMask);
+    }
+
+    if (mContentChangeDetector) {
+        eventMask |= IN_CLOSE_WRITE;
+    }
+
+    if (mEventAggregator) {
+        eventMask |= watchMaskOf(mEventAggregator->getEvents());
+    }
+
+    if (mWriteCompletionDetector) {
+        eventMask |= IN_CREATE | IN_OPEN | IN_MODIFY | IN_CLOSE | IN_MOVE | IN_DELETE
+            | IN_DELETE_SELF | IN_MOVE_SELF;
+    }
+
+    // Subscribers of the bus and readers of the journal or history choose their events
+    auto hasObservers = !mEventObserver.empty() || !mSubtreeRouter->empty()
+        || mContentChangeDetector || mEventAggregator || mWriteCompletionDetector;
+    if (mUnexpectedEventObserver || mHasEventTimeoutObserver || mEventPublisher || mEventJournal
+        || mEventHistory || !hasObservers) {
+        eventMask = IN_ALL_EVENTS;
+    }
+
+    mInotify->setEventMask(eventMask);
+}
+/**
+ * Bounds the memory of queued events. Lost events are reported to the
+ * observers of Event::q_overflow (or the unexpected event observer) by a
+ * notification with an empty path.
+ *
+ * @param capacity maximum number of queued events
+ * @param policy applied when the queue is full
+ * @return
+ */
+auto NotifierBuilder::setEventQueueCapacity(std::size_t capacity, QueueOverflowPolicy policy)
+    -> NotifierBuilder&
+{
+    getInotify().setEventQueueCapacity(capacity, policy);
+    return *this;
+}
+
+auto NotifierBuilder::getEventQueueStatistics() -> EventQueueStatistics
+{
+    return getInotify().getEventQueueStatistics();
+}
+
+/**
+ * Dispatches events of the subtree from a lane of the given priority.
+ * Lanes of higher priority are drained first, e.g. config changes are
+ * delivered before the backlog of a flooded log directory.
+ *
+ * @param subtree
+ * @param priority of the lane, other paths are in lane 0
+ * @param weight share of the lane with LaneScheduling::weighted
+ * @return
+ */
+auto NotifierBuilder::setPriorityLane(
+    inotifypp::filesystem::path subtree, unsigned priority, unsigned weight) -> NotifierBuilder&
+{
+    getInotify().addPriorityLane(subtree, priority, weight);
+    return *this;
+}
+
+auto NotifierBuilder::setLaneScheduling(LaneScheduling scheduling) -> NotifierBuilder&
+{
+    getInotify().setLaneScheduling(scheduling);
+    return *this;
+}
+
+auto NotifierBuilder::getLaneStatistics() -> std::vector<LaneStatistics>
+{
+    return getInotify().getLaneStatistics();
+}
+
+/**
+ * Tracks the busiest directories and files in constant memory while the
+ * kernel records are decoded, including events rejected by the name
+ * filter. With options.hotShare above 0, directories that produce that
+ * share of all events get options.action applied and are reported to the
+ * observer, which is called from the event loop.
+ *
+ * @param options
+ * @param hotPathObserver
+ * @return
+ */
+auto NotifierBuilder::trackHotPaths(HeavyHittersOptions options, HotPathObserver hotPathObserver)
+    -> NotifierBuilder&
+{
+    getInotify().trackHeavyHitters(options, hotPathObserver);
+    return *this;
+}
+
+auto NotifierBuilder::getHotDirectories() -> std::vector<HotPath>
+{
+    return getInotify().getHotDirectories();
+}
+
+auto NotifierBuilder::getHotFiles() -> std::vector<HotPath>
+{
+    return getInotify().getHotFiles();
+}
+
+/**
+ * Lets the thread that runs the notifier spin on the inotify descriptor
+ * instead of sleeping in epoll_wait while events arrive. This trades one
+ * core for lower and steadier latency. The reader falls back to epoll_wait
+ * after options.idleThreshold without events.
+ *
+ * @param options
+ * @return
+ */
+auto NotifierBuilder::enableBusyPolling(BusyPollOptions options) -> NotifierBuilder&
+{
+    getInotify().enableBusyPolling(options);
+    return *this;
+}
+
+auto NotifierBuilder::getBusyPollStatistics() -> BusyPollStatistics
+{
+    return getInotify().getBusyPollStatistics();
+}
+
+/**
+ * Delivers only a deterministic sample of high frequency events, e.g.
+ * access and open for popularity statistics. Notification::count tells
+ * how many events a delivered notification represents. Events marked in
+ * options.mustDeliver are delivered exactly. Counts that are pending when
+ * the notifier stops are delivered before run returns.
+ *
+ * @param options
+ * @return
+ */
+auto NotifierBuilder::sampleEvents(SamplingOptions options) -> NotifierBuilder&
+{
+    getInotify().setSampling(options);
+    return *this;
+}
+
+auto NotifierBuilder::getSamplingStatistics() -> SamplingStatistics
+{
+    return getInotify().getSamplingStatistics();
+}
+
+/**
+ * Sizing of the buffer kernel records are read into. It follows the
+ * pending bytes within the given bounds and gives up its memory when idle,
+ * to a shared pool if one is set.
+ *
+ * @param options
+ * @return
+ */
+auto NotifierBuilder::setReadBufferOptions(ReadBufferOptions options) -> NotifierBuilder&
+{
+    getInotify().setReadBufferOptions(options);
+    return *this;
+}
+
+auto NotifierBuilder::getReadBufferStatistics() -> ReadBufferStatistics
+{
+    return getInotify().getReadBufferStatistics();
+}
+
+/**
+ * Observes kernel records that arrive for a removed watch, e.g. events that
+ * were queued before unwatchFile. They are dropped, the observer is meant
+ * for diagnostics.
+ *
+ * @param staleEventObserver
+ * @return
+ */
+auto NotifierBuilder::onStaleEvent(StaleEventObserver staleEventObserver) -> NotifierBuilder&
+{
+    getInotify().onStaleEvent(staleEventObserver);
     return *this;
 }
+
+auto NotifierBuilder::getStaleEventCount() -> uint64_t
+{
+    return getInotify().getStaleEventCount();
+}
+
+/**
+ * Publishes every event of this notifier to a shared event bus, before it
+ * is dispatched to the local observers. Other processes subscribe to the
+ * bus with BuildNotifier(subscriber) and share the watches of this one.
+ * Since subscribers observe events of their own choice, all events are
+ * requested from the kernel.
+ *
+ * @param eventPublisher
+ * @return
+ */
+auto NotifierBuilder::publishTo(std::shared_ptr<SharedEventPublisher> eventPublisher)
+    -> NotifierBuilder&
+{
+    mEventPublisher = eventPublisher;
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Appends every event of this notifier to a journal, before it is
+ * dispatched to the observers. All events are requested from the kernel,
+ * not only those of the observers.
+ *
+ * @param eventJournal
+ * @return
+ */
+auto NotifierBuilder::journalTo(std::shared_ptr<EventJournalWriter> eventJournal)
+    -> NotifierBuilder&
+{
+    mEventJournal = eventJournal;
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * Retains every event of this notifier in an in-memory history before it
+ * is dispatched to the observers. Consumers that restart or fall behind
+ * read the events following their last sequence number from the history.
+ * All events are requested from the kernel, not only those of the
+ * observers.
+ *
+ * @param eventHistory
+ * @return
+ */
+auto NotifierBuilder::keepHistory(std::shared_ptr<EventHistory> eventHistory) -> NotifierBuilder&
+{
+    mEventHistory = eventHistory;
+    updateEventMask();
+    return *this;
+}
+
 /**
  * Sets the time between two successive events. Events occurring in between
  * will be ignored and the event observer will be called.
@@ -84,54 +549,124 @@ auto NotifierBuilder::setEventTimeout(
         eventObserver(notification);
     };
 
-    mInotify->setEventTimeout(timeout, onEventTimeout);
+    getInotify().setEventTimeout(timeout, onEventTimeout);
+    mHasEventTimeoutObserver = true;
+    updateEventMask();
     return *this;
 }
 
 auto NotifierBuilder::runOnce() -> void
 {
-    auto fileSystemEvent = mInotify->getNextEvent();
+    dispatchNextEvent();
+}
+
+/**
+ * @return false if no event was dispatched, because the notifier stopped
+ */
+auto NotifierBuilder::dispatchNextEvent() -> bool
+{
+    auto fileSystemEvent
+        = mEventSubscriber ? mEventSubscriber->getNextEvent() : mInotify->getNextEvent();
     if (!fileSystemEvent) {
-        return;
+        return false;
+    }
+
+    if (mEventPublisher) {
+        mEventPublisher->publish(*fileSystemEvent);
+    }
+
+    if (mEventJournal) {
+        mEventJournal->append(*fileSystemEvent);
+    }
+
+    if (mEventHistory) {
+        mEventHistory->append(*fileSystemEvent);
     }
 
     Event currentEvent = static_cast<Event>(fileSystemEvent->mask);
 
-    Notification notification { currentEvent, fileSystemEvent->path, fileSystemEvent->eventTime };
+    Notification notification { currentEvent,
+                                std::move(fileSystemEvent->path),
+                                fileSystemEvent->eventTime,
+                                fileSystemEvent->count };
+
+    if (mContentChangeDetector && fileSystemEvent->mask == IN_CLOSE_WRITE) {
+        mContentChangeDetector->submit(notification);
+    }
+
+    if (mEventAggregator) {
+        mEventAggregator->add(
+            fileSystemEvent->wd, fileSystemEvent->mask, notification.path, notification.time);
+    }
+
+    if (mWriteCompletionDetector) {
+        mWriteCompletionDetector->add(notification);
+    }
+
+    auto routed = mSubtreeRouter->route(fileSystemEvent->wd, notification);
 
     for (auto& eventAndEventObserver : mEventObserver) {
         auto& event = eventAndEventObserver.first;
         auto& eventObserver = eventAndEventObserver.second;
 
         if (event == Event::all) {
-            eventObserver(notification);
-            return;
+            notifyObserver(eventObserver, notification);
+            return true;
         }
 
         if (event == currentEvent) {
-            eventObserver(notification);
-            return;
+            notifyObserver(eventObserver, notification);
+            return true;
         }
     }
 
-    if (mUnexpectedEventObserver) {
-        mUnexpectedEventObserver(notification);
+    if (mUnexpectedEventObserver && !routed) {
+        notifyObserver(mUnexpectedEventObserver, notification);
     }
+
+    return true;
 }
 
 auto NotifierBuilder::run() -> void
 {
     while (true) {
-        if (mInotify->hasStopped()) {
+        if (hasStopped()) {
           break;
         }
 
         runOnce();
     }
+
+    // Sampled events that were pending when the notifier stopped
+    while (dispatchNextEvent()) {
+    }
 }
 
 auto NotifierBuilder::stop() -> void
 {
-    mInotify->stop();
+    if (mEventSubscriber) {
+        mEventSubscriber->stop();
+    }
+    if (mInotify) {
+        mInotify->stop();
+    }
+}
+
+auto NotifierBuilder::hasStopped() -> bool
+{
+    return mEventSubscriber ? mEventSubscriber->hasStopped() : mInotify->hasStopped();
+}
+
+/**
+ * The inotify instance of the notifier. A notifier of a shared event bus
+ * has none, its watches are managed by the publishing process.
+ */
+auto NotifierBuilder::getInotify() -> Inotify&
+{
+    if (!mInotify) {
+        throw std::runtime_error("Notifier receives its events from a shared event bus");
+    }
+
+    return *mInotify;
 }
 }
@@ -0,0 +1,338 @@
+#include <inotify-cpp/PriorityEventQueue.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "Probes.h"
+
+namespace fs = inotifypp::filesystem;
+
+namespace inotify {
+
+namespace {
+
+/**
+ * Number of components of subtree if it contains path, -1 otherwise.
+ */
+int matchSubtree(const fs::path& subtree, const fs::path& path)
+{
+    auto component = path.begin();
+    int matched = 0;
+    for (auto& subtreeComponent : subtree) {
+        if (component == path.end() || *component != subtreeComponent) {
+            return -1;
+        }
+        ++component;
+        ++matched;
+    }
+
+    return matched;
+}
+
+fs::path withoutTrailingSeparator(fs::path path)
+{
+    auto name = path.filename().string();
+    return name.empty() || name == "." ? path.parent_path() : path;
+}
+}
+
+PriorityEventQueue::PriorityEventQueue()
+    : mScheduling(LaneScheduling::strict)
+    , mSelectedLane(0)
+    , mBlockedLane(0)
+    , mSize(0)
+{
+    mLanes.push_back(Lane { 0, 1, 1, EventQueue(), 0, 0, {}, {} });
+}
+
+/**
+ * @brief Assigns the subtree to the lane of the given priority, which is
+ *        created if needed. Lanes of higher priority are drained first.
+ *
+ * @param weight of the lane for LaneScheduling::weighted, at least one
+ */
+void PriorityEventQueue::addLane(const fs::path& subtree, unsigned priority, unsigned weight)
+{
+    weight = std::max(weight, 1u);
+    auto lane = std::find_if(mLanes.begin(), mLanes.end(), [priority](const Lane& lane) {
+        return lane.priority == priority;
+    });
+
+    if (lane == mLanes.end()) {
+        Lane newLane { priority, weight, weight, EventQueue(), 0, 0, {}, {} };
+        newLane.events.setCapacity(
+            mLanes.front().events.getCapacity(), mLanes.front().events.getPolicy());
+        mLanes.push_back(newLane);
+
+        // Lanes are ordered by descending priority, subtrees refer to them by index
+        std::vector<unsigned> priorities;
+        for (auto& subtreeLane : mSubtrees) {
+            priorities.push_back(mLanes[subtreeLane.second].priority);
+        }
+        std::stable_sort(mLanes.begin(), mLanes.end(), [](const Lane& lhs, const Lane& rhs) {
+            return lhs.priority > rhs.priority;
+        });
+        for (std::size_t i = 0; i < mSubtrees.size(); ++i) {
+            for (std::size_t index = 0; index < mLanes.size(); ++index) {
+                if (mLanes[index].priority == priorities[i]) {
+                    mSubtrees[i].second = index;
+                }
+            }
+        }
+        lane = std::find_if(mLanes.begin(), mLanes.end(), [priority](const Lane& lane) {
+            return lane.priority == priority;
+        });
+    } else {
+        lane->weight = weight;
+        lane->credit = weight;
+    }
+
+    mSubtrees.emplace_back(withoutTrailingSeparator(subtree), lane - mLanes.begin());
+    mDirectoryCache.clear();
+    mBlockedLane = 0;
+}
+
+void PriorityEventQueue::setScheduling(LaneScheduling scheduling)
+{
+    mScheduling = scheduling;
+}
+
+bool PriorityEventQueue::hasLanes() const
+{
+    return mLanes.size() > 1;
+}
+
+/**
+ * @brief Applies capacity and policy to every lane.
+ */
+void PriorityEventQueue::setCapacity(std::size_t capacity, QueueOverflowPolicy policy)
+{
+    for (auto& lane : mLanes) {
+        lane.events.setCapacity(capacity, policy);
+    }
+}
+
+bool PriorityEventQueue::push(const FileSystemEvent& event)
+{
+    auto& lane = mLanes[hasLanes() ? laneOf(event.wd, event.path) : 0];
+    if (lane.reserved) {
+        --lane.reserved;
+    }
+
+    auto sizeBefore = lane.events.size();
+    auto pushed = lane.events.push(event);
+    mSize += lane.events.size() - sizeBefore;
+    INOTIFY_PROBE(queue_push, lane.priority, lane.events.size(), pushed);
+    return pushed;
+}
+
+/**
+ * @brief Next event according to the scheduling. Selects the
+ *        lane that is popped by the following pop().
+ */
+FileSystemEvent& PriorityEventQueue::front()
+{
+    mSelectedLane = selectLane();
+    return mLanes[mSelectedLane].events.front();
+}
+
+void PriorityEventQueue::pop()
+{
+    auto& lane = mLanes[mSelectedLane];
+    auto latency = std::chrono::steady_clock::now() - lane.events.front().eventTime;
+    lane.totalLatency += latency;
+    lane.maxLatency = std::max(lane.maxLatency, latency);
+    ++lane.dispatchedEvents;
+
+    if (lane.credit) {
+        --lane.credit;
+    }
+
+    lane.events.pop();
+    --mSize;
+    INOTIFY_PROBE(
+        queue_pop,
+        lane.priority,
+        lane.events.size(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+}
+
+bool PriorityEventQueue::empty() const
+{
+    return mSize == 0;
+}
+
+std::size_t PriorityEventQueue::size() const
+{
+    return mSize;
+}
+
+/**
+ * @return number of events that can be pushed before the capacity is
+ *         reached. Unlimited if lanes block on their own, see reserve.
+ */
+std::size_t PriorityEventQueue::available() const
+{
+    if (blocksPerLane()) {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    return mLanes.front().events.available();
+}
+
+/**
+ * @return true if the decoder has to reserve the place of every event
+ */
+bool PriorityEventQueue::blocksPerLane() const
+{
+    return hasLanes() && mLanes.front().events.getPolicy() == QueueOverflowPolicy::block;
+}
+
+/**
+ * @brief Reserves the place of a decoded event in its lane until it is
+ *        pushed or the reservations are cleared.
+ *
+ * @return false if the lane is full, it is charged with the next
+ *         countBlockedRead
+ */
+bool PriorityEventQueue::reserve(int wd, const fs::path& path)
+{
+    auto index = laneOf(wd, path);
+    auto& lane = mLanes[index];
+    if (lane.reserved >= lane.events.available()) {
+        mBlockedLane = index;
+        return false;
+    }
+
+    ++lane.reserved;
+    return true;
+}
+
+/**
+ * @brief Releases the places of reserved events that were not pushed,
+ *        e.g. because they were filtered.
+ */
+void PriorityEventQueue::clearReservations()
+{
+    for (auto& lane : mLanes) {
+        lane.reserved = 0;
+    }
+}
+
+void PriorityEventQueue::countBlockedRead()
+{
+    mLanes[mBlockedLane].events.countBlockedRead();
+}
+
+/**
+ * @brief Sum of the statistics of all lanes.
+ */
+EventQueueStatistics PriorityEventQueue::getStatistics() const
+{
+    EventQueueStatistics statistics { 0, 0, 0, 0, 0, 0 };
+    for (auto& lane : mLanes) {
+        auto laneStatistics = lane.events.getStatistics();
+        statistics.pushedEvents += laneStatistics.pushedEvents;
+        statistics.droppedOldestEvents += laneStatistics.droppedOldestEvents;
+        statistics.droppedNewestEvents += laneStatistics.droppedNewestEvents;
+        statistics.coalescedEvents += laneStatistics.coalescedEvents;
+        statistics.blockedReads += laneStatistics.blockedReads;
+        statistics.maxSize = std::max(statistics.maxSize, laneStatistics.maxSize);
+    }
+
+    return statistics;
+}
+
+/**
+ * @return statistics of every lane in order of descending priority
+ */
+std::vector<LaneStatistics> PriorityEventQueue::getLaneStatistics() const
+{
+    std::vector<LaneStatistics> statistics;
+    for (auto& lane : mLanes) {
+        auto meanLatency = lane.dispatchedEvents
+            ? lane.totalLatency
+                / static_cast<std::chrono::steady_clock::rep>(lane.dispatchedEvents)
+            : std::chrono::steady_clock::duration::zero();
+        statistics.push_back(LaneStatistics {
+            lane.priority,
+            lane.weight,
+            lane.events.size(),
+            lane.dispatchedEvents,
+            std::chrono::duration_cast<std::chrono::microseconds>(meanLatency),
+            std::chrono::duration_cast<std::chrono::microseconds>(lane.maxLatency),
+            lane.events.getStatistics() });
+    }
+
+    return statistics;
+}
+
+std::size_t PriorityEventQueue::laneOf(int wd, const fs::path& path)
+{
+    auto directory = path.parent_path();
+    auto& cached = mDirectoryCache[wd];
+
+    if (cached.directory.empty() || cached.directory != directory) {
+        cached.directory = directory;
+        cached.lane = laneOf(directory);
+        cached.children.clear();
+        for (auto& subtree : mSubtrees) {
+            if (subtree.first.parent_path() == directory) {
+                cached.children.push_back(subtree);
+            }
+        }
+    }
+
+    for (auto& child : cached.children) {
+        if (matchSubtree(child.first, path) >= 0) {
+            return child.second;
+        }
+    }
+
+    return cached.lane;
+}
+
+std::size_t PriorityEventQueue::laneOf(const fs::path& path) const
+{
+    auto lane = mLanes.size() - 1;
+    auto deepest = -1;
+    for (auto& subtree : mSubtrees) {
+        auto matched = matchSubtree(subtree.first, path);
+        if (matched > deepest) {
+            deepest = matched;
+            lane = subtree.second;
+        }
+    }
+
+    return lane;
+}
+
+std::size_t PriorityEventQueue::selectLane()
+{
+    std::size_t highest = mLanes.size();
+    for (std::size_t i = 0; i < mLanes.size(); ++i) {
+        if (mLanes[i].events.empty()) {
+            continue;
+        }
+
+        if (mScheduling == LaneScheduling::strict) {
+            return i;
+        }
+
+        if (highest == mLanes.size()) {
+            highest = i;
+        }
+
+        if (mLanes[i].credit) {
+            return i;
+        }
+    }
+
+    // Every non empty lane used its credit, next round
+    for (auto& lane : mLanes) {
+        lane.credit = lane.weight;
+    }
+
+    return highest;
+}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * Static tracepoints (USDT) of the provider inotify_cpp. A probe compiles to
+ * a single nop, but its arguments are evaluated even if no tracer is
+ * attached, so probe arguments must be cheap. Tools like perf or bpftrace
+ * attach to the probes of a running process. Without sys/sdt.h the probes
+ * compile to nothing. See the README for the list of probes.
+ */
+#ifdef INOTIFY_CPP_HAVE_SDT
+#include <sys/sdt.h>
+#define INOTIFY_PROBE(...) STAP_PROBEV(inotify_cpp, __VA_ARGS__)
+#else
+#define INOTIFY_PROBE(...)                                                                         \
+    do {                                                                                           \
+    } while (false)
+#endif
@@ -0,0 +1,208 @@
+#include <inotify-cpp/ReadBuffer.h>
+
+#include <algorithm>
+
+#include <limits.h>
+#include <sys/inotify.h>
+
+namespace inotify {
+
+namespace {
+
+/**
+ * Every read must fit at least one record, otherwise it fails with EINVAL
+ */
+const std::size_t minimumReadSize = sizeof(inotify_event) + NAME_MAX + 1;
+
+std::size_t roundUpToPowerOfTwo(std::size_t size)
+{
+    std::size_t power = 1;
+    while (power < size) {
+        power <<= 1;
+    }
+    return power;
+}
+}
+
+ReadBufferPool::ReadBufferPool(std::size_t maxRetainedBytes)
+    : mMaxRetainedBytes(maxRetainedBytes)
+    , mRetainedBytes(0)
+{
+}
+
+/**
+ * @return a released buffer of the size or a new one
+ */
+std::vector<std::uint8_t> ReadBufferPool::acquire(std::size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto buffer = mBuffers.find(size);
+        if (buffer != mBuffers.end()) {
+            auto acquired = std::move(buffer->second);
+            mBuffers.erase(buffer);
+            mRetainedBytes -= size;
+            return acquired;
+        }
+    }
+
+    return std::vector<std::uint8_t>(size);
+}
+
+void ReadBufferPool::release(std::vector<std::uint8_t> buffer)
+{
+    if (buffer.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRetainedBytes + buffer.size() > mMaxRetainedBytes) {
+        return;
+    }
+
+    mRetainedBytes += buffer.size();
+    auto size = buffer.size();
+    mBuffers.emplace(size, std::move(buffer));
+}
+
+std::size_t ReadBufferPool::getRetainedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRetainedBytes;
+}
+
+ReadBuffer::ReadBuffer(ReadBufferOptions options)
+    : mPeriodBurst(0)
+    , mPeriodStart(std::chrono::steady_clock::now())
+    , mStatistics {}
+{
+    setOptions(std::move(options));
+    resize(sizeFor(0));
+}
+
+ReadBuffer::~ReadBuffer()
+{
+    if (mOptions.pool) {
+        mOptions.pool->release(std::move(mBuffer));
+    }
+}
+
+/**
+ * @brief Applies the options by the next reserve, the content of the buffer
+ *        is kept until then.
+ */
+void ReadBuffer::setOptions(ReadBufferOptions options)
+{
+    mOptions = std::move(options);
+    mOptions.minimumSize = roundUpToPowerOfTwo(std::max(mOptions.minimumSize, minimumReadSize));
+    mOptions.maximumSize = std::max(mOptions.maximumSize, mOptions.minimumSize);
+}
+
+std::uint8_t* ReadBuffer::data()
+{
+    return mBuffer.data();
+}
+
+std::size_t ReadBuffer::size() const
+{
+    return mBuffer.size();
+}
+
+/**
+ * @brief Sizes the buffer for the pending bytes before a read. Shrinks it
+ *        to the largest burst of the last period first, if the period is
+ *        over.
+ *
+ * @param pending bytes reported by FIONREAD
+ */
+void ReadBuffer::reserve(std::size_t pending)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - mPeriodStart >= mOptions.idleTimeout) {
+        auto periodSize = sizeFor(mPeriodBurst);
+        if (periodSize < mBuffer.size()) {
+            resize(periodSize);
+            ++mStatistics.shrinks;
+        }
+        mPeriodStart = now;
+        mPeriodBurst = 0;
+    }
+
+    mPeriodBurst = std::max(mPeriodBurst, pending);
+    mStatistics.largestBurst = std::max(mStatistics.largestBurst, pending);
+
+    auto size = sizeFor(pending);
+    if (size > mBuffer.size() || mBuffer.size() > mOptions.maximumSize) {
+        resize(size);
+        ++mStatistics.grows;
+    }
+}
+
+/**
+ * @brief Counts a read that returned records.
+ *
+ * @param pending bytes that were pending before the read
+ */
+void ReadBuffer::countRead(std::size_t pending)
+{
+    ++mStatistics.reads;
+    if (pending > mBuffer.size()) {
+        ++mStatistics.truncatedReads;
+    }
+}
+
+/**
+ * @return true if the buffer holds more memory than while idle
+ */
+bool ReadBuffer::isReleasable() const
+{
+    return mOptions.pool ? !mBuffer.empty() : mBuffer.size() > mOptions.minimumSize;
+}
+
+/**
+ * @brief Gives up the memory of an idle buffer. A pooled buffer goes back
+ *        to the pool, it is acquired again by the next reserve.
+ */
+void ReadBuffer::release()
+{
+    if (mOptions.pool) {
+        mOptions.pool->release(std::move(mBuffer));
+        mBuffer = std::vector<std::uint8_t>();
+    } else {
+        resize(mOptions.minimumSize);
+    }
+
+    ++mStatistics.shrinks;
+    mPeriodStart = std::chrono::steady_clock::now();
+    mPeriodBurst = 0;
+}
+
+std::chrono::milliseconds ReadBuffer::getIdleTimeout() const
+{
+    return mOptions.idleTimeout;
+}
+
+ReadBufferStatistics ReadBuffer::getStatistics() const
+{
+    auto statistics = mStatistics;
+    statistics.size = mBuffer.size();
+    return statistics;
+}
+
+std::size_t ReadBuffer::sizeFor(std::size_t pending) const
+{
+    auto size = roundUpToPowerOfTwo(std::max(pending, mOptions.minimumSize));
+    return std::min(size, mOptions.maximumSize);
+}
+
+void ReadBuffer::resize(std::size_t size)
+{
+    if (mOptions.pool) {
+        auto buffer = mOptions.pool->acquire(size);
+        mOptions.pool->release(std::move(mBuffer));
+        mBuffer = std::move(buffer);
+    } else {
+        std::vector<std::uint8_t>(size).swap(mBuffer);
+    }
+}
+}
@@ -0,0 +1,331 @@
+#include <inotify-cpp/SharedEventBus.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory atomics have to be lock free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared memory atomics have to be lock free");
+
+namespace inotify {
+
+namespace detail {
+
+const std::uint64_t sharedEventBusMagic = 0x69636270622d7632; // "icppb-v2"
+
+struct SharedEventBusHeader {
+    std::uint64_t magic;
+    std::uint64_t capacity;
+    std::uint64_t slotSize;
+    std::atomic<std::uint64_t> writeSequence;
+    std::atomic<std::uint32_t> wakeups;
+    std::atomic<std::uint32_t> waiters;
+};
+
+struct SharedEventSlot {
+    std::atomic<std::uint64_t> sequence;
+    std::int32_t wd;
+    std::uint32_t mask;
+    std::uint32_t cookie;
+    std::int64_t time;
+    std::uint32_t pathLength;
+    std::uint32_t count;
+};
+}
+
+namespace {
+
+const std::size_t slotAlignment = 64;
+
+std::size_t headerSize()
+{
+    return (sizeof(detail::SharedEventBusHeader) + slotAlignment - 1) / slotAlignment
+        * slotAlignment;
+}
+
+detail::SharedEventSlot* slotAt(detail::SharedEventBusHeader* header, std::uint64_t sequence)
+{
+    auto base = reinterpret_cast<std::uint8_t*>(header) + headerSize();
+    return reinterpret_cast<detail::SharedEventSlot*>(
+        base + (sequence % header->capacity) * header->slotSize);
+}
+
+char* pathOf(detail::SharedEventSlot* slot)
+{
+    return reinterpret_cast<char*>(slot) + sizeof(detail::SharedEventSlot);
+}
+
+std::runtime_error systemError(const std::string& message)
+{
+    std::stringstream errorStream;
+    errorStream << message << " " << strerror(errno) << ".";
+    return std::runtime_error(errorStream.str());
+}
+
+void futexWait(std::atomic<std::uint32_t>* word, std::uint32_t expected)
+{
+    timespec timeout { 0, 100 * 1000 * 1000 };
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+void futexWakeAll(std::atomic<std::uint32_t>* word)
+{
+    syscall(
+        SYS_futex,
+        reinterpret_cast<std::uint32_t*>(word),
+        FUTEX_WAKE,
+        std::numeric_limits<int>::max(),
+        nullptr,
+        nullptr,
+        0);
+}
+}
+
+/**
+ * @param capacity number of events the ring can hold
+ * @param maxPathLength longer paths are truncated
+ */
+SharedEventPublisher::SharedEventPublisher(std::size_t capacity, std::size_t maxPathLength)
+    : mFd(-1)
+    , mSize(0)
+    , mHeader(nullptr)
+{
+    auto slotSize = (sizeof(detail::SharedEventSlot) + maxPathLength + slotAlignment - 1)
+        / slotAlignment * slotAlignment;
+    capacity = std::max<std::size_t>(capacity, 1);
+    mSize = headerSize() + capacity * slotSize;
+
+    mFd = memfd_create("inotify-cpp-event-bus", MFD_CLOEXEC);
+    if (mFd == -1) {
+        throw systemError("Can't create shared memory of event bus !");
+    }
+
+    if (ftruncate(mFd, static_cast<off_t>(mSize)) == -1) {
+        close(mFd);
+        throw systemError("Can't resize shared memory of event bus !");
+    }
+
+    auto memory = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (memory == MAP_FAILED) {
+        close(mFd);
+        throw systemError("Can't map shared memory of event bus !");
+    }
+
+    mHeader = new (memory) detail::SharedEventBusHeader();
+    mHeader->capacity = capacity;
+    mHeader->slotSize = slotSize;
+    mHeader->writeSequence.store(0);
+    mHeader->wakeups.store(0);
+    mHeader->waiters.store(0);
+    for (std::uint64_t i = 0; i < capacity; ++i) {
+        new (slotAt(mHeader, i)) detail::SharedEventSlot();
+        slotAt(mHeader, i)->sequence.store(0);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->magic = detail::sharedEventBusMagic;
+}
+
+SharedEventPublisher::~SharedEventPublisher()
+{
+    munmap(mHeader, mSize);
+    close(mFd);
+}
+
+/**
+ * @brief Writes the event into the next slot. A slot sequence of
+ *        0 marks a slot as being written, n + 1 marks it as holding
+ *        the n-th event.
+ */
+void SharedEventPublisher::publish(const FileSystemEvent& event)
+{
+    auto sequence = mHeader->writeSequence.load(std::memory_order_relaxed);
+    auto slot = slotAt(mHeader, sequence);
+    auto& path = event.path.native();
+    auto pathLength = std::min<std::size_t>(
+        path.size(), mHeader->slotSize - sizeof(detail::SharedEventSlot));
+
+    slot->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->wd = event.wd;
+    slot->mask = event.mask;
+    slot->cookie = event.cookie;
+    slot->time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     event.eventTime.time_since_epoch())
+                     .count();
+    slot->pathLength = static_cast<std::uint32_t>(pathLength);
+    slot->count = event.count;
+    std::memcpy(pathOf(slot), path.data(), pathLength);
+
+    slot->sequence.store(sequence + 1, std::memory_order_release);
+    mHeader->writeSequence.store(sequence + 1, std::memory_order_release);
+    mHeader->wakeups.fetch_add(1, std::memory_order_release);
+
+    if (mHeader->waiters.load(std::memory_order_acquire)) {
+        futexWakeAll(&mHeader->wakeups);
+    }
+}
+
+int SharedEventPublisher::getFd() const
+{
+    return mFd;
+}
+
+/**
+ * @return path under which other processes of the same user can open the bus
+ */
+std::string SharedEventPublisher::getPath() const
+{
+    return "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(mFd);
+}
+
+std::uint64_t SharedEventPublisher::getPublishedEventCount() const
+{
+    return mHeader->writeSequence.load(std::memory_order_relaxed);
+}
+
+SharedEventSubscriber::SharedEventSubscriber(int fd)
+    : mSize(0)
+    , mHeader(nullptr)
+    , mCursor(0)
+    , mLostEventCount(0)
+    , mStopped(false)
+{
+    map(fd);
+}
+
+SharedEventSubscriber::SharedEventSubscriber(const std::string& path)
+    : mSize(0)
+    , mHeader(nullptr)
+    , mCursor(0)
+    , mLostEventCount(0)
+    , mStopped(false)
+{
+    auto fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        throw systemError("Can't open event bus " + path + " !");
+    }
+
+    try {
+        map(fd);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+SharedEventSubscriber::~SharedEventSubscriber()
+{
+    munmap(mHeader, mSize);
+}
+
+void SharedEventSubscriber::map(int fd)
+{
+    struct stat status;
+    if (fstat(fd, &status) == -1) {
+        throw systemError("Can't stat event bus !");
+    }
+
+    mSize = static_cast<std::size_t>(status.st_size);
+    auto memory = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throw systemError("Can't map event bus !");
+    }
+
+    mHeader = static_cast<detail::SharedEventBusHeader*>(memory);
+    if (mHeader->magic != detail::sharedEventBusMagic) {
+        munmap(memory, mSize);
+        throw std::runtime_error("Can't map event bus ! Shared memory is not an event bus.");
+    }
+
+    mCursor = mHeader->writeSequence.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Blocking wait on the next published event. If the
+ *        publisher overwrote events that were not read yet an
+ *        event with IN_Q_OVERFLOW and an empty path is returned.
+ *
+ * @return A new FileSystemEvent or nothing when stopped
+ */
+inotifypp::optional<FileSystemEvent> SharedEventSubscriber::getNextEvent()
+{
+    while (!mStopped) {
+        auto wakeups = mHeader->wakeups.load(std::memory_order_acquire);
+        auto writeSequence = mHeader->writeSequence.load(std::memory_order_acquire);
+
+        if (mCursor == writeSequence) {
+            mHeader->waiters.fetch_add(1, std::memory_order_acq_rel);
+            if (mHeader->writeSequence.load(std::memory_order_acquire) == writeSequence) {
+                futexWait(&mHeader->wakeups, wakeups);
+            }
+            mHeader->waiters.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+
+        auto lostEvents = writeSequence - mCursor > mHeader->capacity;
+        if (!lostEvents) {
+            auto slot = slotAt(mHeader, mCursor);
+            auto sequence = slot->sequence.load(std::memory_order_acquire);
+            if (sequence == mCursor + 1) {
+                auto pathLength = std::min<std::size_t>(
+                    slot->pathLength, mHeader->slotSize - sizeof(detail::SharedEventSlot));
+                std::string path(pathOf(slot), pathLength);
+                FileSystemEvent event(
+                    slot->wd,
+                    slot->mask,
+                    slot->cookie,
+                    path,
+                    std::chrono::steady_clock::time_point(std::chrono::nanoseconds(slot->time)));
+                event.count = slot->count;
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot->sequence.load(std::memory_order_relaxed) == sequence) {
+                    ++mCursor;
+                    return event;
+                }
+            }
+        }
+
+        // The slot was overwritten, continue with the oldest event that is still available
+        auto oldest = mHeader->writeSequence.load(std::memory_order_acquire);
+        oldest = oldest > mHeader->capacity ? oldest - mHeader->capacity + 1 : 0;
+        auto cursor = std::max(oldest, mCursor + 1);
+        mLostEventCount += cursor - mCursor;
+        mCursor = cursor;
+        return FileSystemEvent(
+            -1, IN_Q_OVERFLOW, inotifypp::filesystem::path(), std::chrono::steady_clock::now());
+    }
+
+    return inotifypp::nullopt();
+}
+
+void SharedEventSubscriber::stop()
+{
+    mStopped = true;
+    futexWakeAll(&mHeader->wakeups);
+}
+
+bool SharedEventSubscriber::hasStopped()
+{
+    return mStopped;
+}
+
+std::uint64_t SharedEventSubscriber::getLostEventCount() const
+{
+    return mLostEventCount;
+}
+}
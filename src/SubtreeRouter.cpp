@@ -0,0 +1,188 @@
+#include <inotify-cpp/SubtreeRouter.h>
+
+#include <sys/inotify.h>
+
+#include "Probes.h"
+
+namespace fs = inotifypp::filesystem;
+
+namespace inotify {
+
+namespace {
+
+bool isSkippedComponent(const std::string& component)
+{
+    return component.empty() || component == ".";
+}
+}
+
+SubtreeRouter::Node::Node(Node* parent)
+    : parent(parent)
+{
+}
+
+SubtreeRouter::SubtreeRouter()
+    : mRoot(nullptr)
+{
+}
+
+void SubtreeRouter::subscribe(const fs::path& subtree, Event event, EventObserver observer)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Node* node = &mRoot;
+    for (auto& component : subtree) {
+        auto name = component.string();
+        if (isSkippedComponent(name)) {
+            continue;
+        }
+
+        auto& child = node->children[name];
+        if (!child) {
+            child.reset(new Node(node));
+        }
+        node = child.get();
+    }
+
+    node->observers.emplace_back(event, std::make_shared<EventObserver>(std::move(observer)));
+    mDirectoryCache.clear();
+}
+
+/**
+ * @brief Calls all observers whose subtree contains the path of
+ *        the notification and whose event matches.
+ *
+ * @return true if at least one observer was called
+ */
+bool SubtreeRouter::route(int wd, const Notification& notification)
+{
+    std::vector<std::shared_ptr<EventObserver>> receivers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto node = findDeepest(wd, notification.path); node; node = node->parent) {
+            for (auto& eventAndObserver : node->observers) {
+                auto& event = eventAndObserver.first;
+                if (event == Event::all || event == notification.event) {
+                    receivers.push_back(eventAndObserver.second);
+                }
+            }
+        }
+    }
+
+    for (auto& observer : receivers) {
+        INOTIFY_PROBE(
+            observer_entry,
+            static_cast<std::uint32_t>(notification.event),
+            notification.path.c_str());
+        (*observer)(notification);
+        INOTIFY_PROBE(
+            observer_exit,
+            static_cast<std::uint32_t>(notification.event),
+            notification.path.c_str());
+    }
+
+    return !receivers.empty();
+}
+
+/**
+ * @brief Events that are of interest for a watch on the given path.
+ *        These are the events of subscriptions on the path or one of
+ *        its parents and of subscriptions on direct children, which
+ *        are reported by the watch of their parent directory.
+ */
+std::uint32_t SubtreeRouter::eventMaskFor(const fs::path& watchPath) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::uint32_t eventMask = 0;
+    bool observed = false;
+    const Node* node = &mRoot;
+    bool exact = true;
+
+    for (auto& component : watchPath) {
+        for (auto& eventAndObserver : node->observers) {
+            eventMask |= watchMaskOf(eventAndObserver.first);
+            observed = true;
+        }
+
+        auto name = component.string();
+        if (isSkippedComponent(name)) {
+            continue;
+        }
+
+        auto child = node->children.find(name);
+        if (child == node->children.end()) {
+            exact = false;
+            break;
+        }
+        node = child->second.get();
+    }
+
+    if (exact) {
+        for (auto& eventAndObserver : node->observers) {
+            eventMask |= watchMaskOf(eventAndObserver.first);
+            observed = true;
+        }
+
+        for (auto& child : node->children) {
+            for (auto& eventAndObserver : child.second->observers) {
+                eventMask |= watchMaskOf(eventAndObserver.first);
+                observed = true;
+            }
+        }
+    }
+
+    return observed ? observedWatchMask(eventMask) : 0;
+}
+
+bool SubtreeRouter::empty() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRoot.children.empty() && mRoot.observers.empty();
+}
+
+/**
+ * Requires mMutex.
+ */
+std::pair<const SubtreeRouter::Node*, bool> SubtreeRouter::findDeepest(const fs::path& path) const
+{
+    const Node* node = &mRoot;
+    for (auto& component : path) {
+        auto name = component.string();
+        if (isSkippedComponent(name)) {
+            continue;
+        }
+
+        auto child = node->children.find(name);
+        if (child == node->children.end()) {
+            return { node, false };
+        }
+        node = child->second.get();
+    }
+
+    return { node, true };
+}
+
+/**
+ * Requires mMutex.
+ */
+const SubtreeRouter::Node* SubtreeRouter::findDeepest(int wd, const fs::path& path)
+{
+    auto directory = path.parent_path();
+    auto& cached = mDirectoryCache[wd];
+
+    if (!cached.node || cached.path != directory) {
+        auto deepest = findDeepest(directory);
+        cached = CachedDirectory { directory, deepest.first, deepest.second };
+    }
+
+    if (!cached.exact) {
+        return cached.node;
+    }
+
+    auto child = cached.node->children.find(path.filename().string());
+    if (child == cached.node->children.end()) {
+        return cached.node;
+    }
+
+    return child->second.get();
+}
+}
@@ -0,0 +1,290 @@
+#include <inotify-cpp/WatchHub.h>
+
+#include <algorithm>
+
+namespace fs = inotifypp::filesystem;
+
+namespace inotify {
+
+namespace {
+
+fs::path withoutTrailingSeparator(fs::path path)
+{
+    auto name = path.filename().string();
+    return name.empty() || name == "." ? path.parent_path() : path;
+}
+
+bool contains(const fs::path& root, const fs::path& path)
+{
+    auto component = path.begin();
+    for (auto& rootComponent : root) {
+        if (component == path.end() || *component != rootComponent) {
+            return false;
+        }
+        ++component;
+    }
+
+    return true;
+}
+}
+
+WatchHub::WatchHub()
+    : mInotify(std::make_shared<Inotify>())
+    , mNextSubscriptionId(1)
+{
+    // Without subscribers nothing is requested from the kernel
+    mInotify->setEventMask(0);
+    mInotify->setWatchMaskProvider([this](const fs::path& path) { return eventMaskFor(path); });
+    mEventLoop = std::thread([this]() { runEventLoop(); });
+}
+
+WatchHub::~WatchHub()
+{
+    mInotify->stop();
+    mEventLoop.join();
+}
+
+/**
+ * @brief Hub shared by all users of the process. It is created on first
+ *        use and lives as long as somebody holds it.
+ */
+std::shared_ptr<WatchHub> WatchHub::processHub()
+{
+    static std::mutex hubMutex;
+    static std::weak_ptr<WatchHub> processHub;
+
+    std::lock_guard<std::mutex> lock(hubMutex);
+    auto hub = processHub.lock();
+    if (!hub) {
+        hub = std::make_shared<WatchHub>();
+        processHub = hub;
+    }
+
+    return hub;
+}
+
+/**
+ * @brief Watches the roots of the subscription recursively. Watches that
+ *        are shared with other subscribers are extended by its events.
+ *
+ * @return id for unsubscribe
+ */
+std::uint64_t WatchHub::subscribe(WatchSubscription subscription)
+{
+    auto subscriber = std::make_shared<Subscriber>();
+    for (auto& root : subscription.roots) {
+        root = withoutTrailingSeparator(root);
+        auto watches = Inotify::collectWatchPaths(root);
+        subscriber->watches.insert(subscriber->watches.end(), watches.begin(), watches.end());
+    }
+    subscriber->eventMask = watchMaskOf(subscription.events)
+        | (static_cast<std::uint32_t>(subscription.events) & (IN_UNMOUNT | IN_Q_OVERFLOW));
+    subscriber->subscription = std::move(subscription);
+
+    // The reference counts and the watches change in one command, so a
+    // concurrent unsubscribe can not remove a watch that was just taken
+    std::uint64_t subscriptionId;
+    mInotify->runCommand([&]() {
+        std::vector<fs::path> newWatches;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            subscriptionId = mNextSubscriptionId++;
+            mSubscribers[subscriptionId] = subscriber;
+            mWatchCache.clear();
+
+            for (auto& watch : subscriber->watches) {
+                if (mWatchReferences[watch]++ == 0) {
+                    newWatches.push_back(watch);
+                }
+            }
+        }
+
+        mInotify->invalidateWatchMasks();
+        mInotify->updateWatchMasks();
+        mInotify->watchFiles(newWatches, IN_ALL_EVENTS);
+    });
+    return subscriptionId;
+}
+
+/**
+ * @brief Removes the subscriber and releases watches that are not needed
+ *        by other subscribers anymore.
+ */
+void WatchHub::unsubscribe(std::uint64_t subscriptionId)
+{
+    mInotify->runCommand([&]() {
+        std::vector<fs::path> releasedWatches;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto subscriber = mSubscribers.find(subscriptionId);
+            if (subscriber == mSubscribers.end()) {
+                return;
+            }
+
+            for (auto& watch : subscriber->second->watches) {
+                auto references = mWatchReferences.find(watch);
+                if (--references->second == 0) {
+                    mWatchReferences.erase(references);
+                    releasedWatches.push_back(watch);
+                }
+            }
+
+            mSubscribers.erase(subscriber);
+            mWatchCache.clear();
+        }
+
+        for (auto& watch : releasedWatches) {
+            try {
+                mInotify->unwatchFile(watch);
+            } catch (const std::exception&) {
+                // Removed from the filesystem meanwhile
+            }
+        }
+
+        mInotify->invalidateWatchMasks();
+        mInotify->updateWatchMasks();
+    });
+}
+
+std::size_t WatchHub::getSubscriberCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSubscribers.size();
+}
+
+std::size_t WatchHub::getWatchCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mWatchReferences.size();
+}
+
+std::uint32_t WatchHub::getWatchMask(const fs::path& path)
+{
+    return mInotify->getWatchMask(withoutTrailingSeparator(path));
+}
+
+/**
+ * Union of the events of all subscribers covering the path.
+ */
+std::uint32_t WatchHub::eventMaskFor(const fs::path& path)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::uint32_t eventMask = 0;
+    for (auto& subscriber : mSubscribers) {
+        for (auto& root : subscriber.second->subscription.roots) {
+            if (contains(root, path)) {
+                eventMask |= observedWatchMask(subscriber.second->eventMask & IN_ALL_EVENTS);
+                break;
+            }
+        }
+    }
+
+    return eventMask;
+}
+
+void WatchHub::dispatch(const FileSystemEvent& fileSystemEvent)
+{
+    std::vector<std::shared_ptr<Subscriber>> receivers;
+    fs::path watchPath;
+    bool resolved = false;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (fileSystemEvent.mask & IN_Q_OVERFLOW) {
+                for (auto& subscriber : mSubscribers) {
+                    receivers.push_back(subscriber.second);
+                }
+                break;
+            }
+
+            if (resolved || mWatchCache.count(fileSystemEvent.wd)) {
+                auto& watch = cachedWatch(fileSystemEvent.wd, watchPath);
+                collectReceivers(fileSystemEvent, watch, receivers);
+                break;
+            }
+        }
+
+        // Resolved without holding the lock, the watch mask provider needs it
+        watchPath = withoutTrailingSeparator(mInotify->getWatchPath(fileSystemEvent.wd));
+        resolved = true;
+    }
+
+    Notification notification { static_cast<Event>(fileSystemEvent.mask),
+                                fileSystemEvent.path,
+                                fileSystemEvent.eventTime };
+    auto name = fileSystemEvent.path.filename().string();
+    auto directory = (fileSystemEvent.mask & IN_ISDIR) != 0;
+
+    for (auto& subscriber : receivers) {
+        if (directory || subscriber->subscription.nameFilter.accepts(name)) {
+            subscriber->subscription.observer(notification);
+        }
+    }
+}
+
+/**
+ * Requires mMutex.
+ */
+void WatchHub::collectReceivers(
+    const FileSystemEvent& fileSystemEvent,
+    const CachedWatch& watch,
+    std::vector<std::shared_ptr<Subscriber>>& receivers)
+{
+    for (auto& subscriber : watch.covering) {
+        if (fileSystemEvent.mask & subscriber->eventMask) {
+            receivers.push_back(subscriber);
+        }
+    }
+
+    for (auto& subscriber : watch.partial) {
+        if (!(fileSystemEvent.mask & subscriber->eventMask)) {
+            continue;
+        }
+
+        for (auto& root : subscriber->subscription.roots) {
+            if (contains(root, fileSystemEvent.path)) {
+                receivers.push_back(subscriber);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Requires mMutex.
+ */
+const WatchHub::CachedWatch& WatchHub::cachedWatch(int wd, const fs::path& watchPath)
+{
+    auto cached = mWatchCache.find(wd);
+    if (cached != mWatchCache.end()) {
+        return cached->second;
+    }
+
+    CachedWatch watch;
+    for (auto& subscriber : mSubscribers) {
+        auto& roots = subscriber.second->subscription.roots;
+        if (std::any_of(roots.begin(), roots.end(), [&](const fs::path& root) {
+                return contains(root, watchPath);
+            })) {
+            watch.covering.push_back(subscriber.second);
+        } else if (std::any_of(roots.begin(), roots.end(), [&](const fs::path& root) {
+                       return contains(watchPath, root);
+                   })) {
+            watch.partial.push_back(subscriber.second);
+        }
+    }
+
+    return mWatchCache.emplace(wd, std::move(watch)).first->second;
+}
+
+void WatchHub::runEventLoop()
+{
+    while (!mInotify->hasStopped()) {
+        auto fileSystemEvent = mInotify->getNextEvent();
+        if (fileSystemEvent) {
+            dispatch(*fileSystemEvent);
+        }
+    }
+}
+}
@@ -0,0 +1,130 @@
+#include <inotify-cpp/WriteCompletionDetector.h>
+
+#include <sys/inotify.h>
+
+namespace inotify {
+
+WriteCompletionDetector::WriteCompletionDetector(
+    std::chrono::milliseconds quietPeriod, EventObserver observer)
+    : mQuietPeriod(quietPeriod)
+    , mObserver(observer)
+    , mSettledFileCount(0)
+    , mStopped(false)
+{
+    mThread = std::thread([this]() { emitSettledFiles(); });
+}
+
+WriteCompletionDetector::~WriteCompletionDetector()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+        mCondition.notify_one();
+    }
+
+    mThread.join();
+}
+
+/**
+ * @brief Updates the state of the file of the notification. Events
+ *        of directories are ignored.
+ */
+void WriteCompletionDetector::add(const Notification& notification)
+{
+    auto mask = static_cast<std::uint32_t>(notification.event);
+    if (mask & IN_ISDIR) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto path = notification.path.string();
+
+    if (mask & (IN_DELETE | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVE_SELF)) {
+        mFiles.erase(path);
+        return;
+    }
+
+    auto file = mFiles.find(path);
+    if (file == mFiles.end()) {
+        if (!(mask & (IN_CREATE | IN_MODIFY | IN_MOVED_TO | IN_CLOSE_WRITE | IN_OPEN))) {
+            return;
+        }
+        file = mFiles.emplace(path, FileState { 0, false, notification.time }).first;
+    }
+
+    auto& state = file->second;
+    state.lastActivity = notification.time;
+
+    if (mask & IN_OPEN) {
+        ++state.openCount;
+    }
+    if ((mask & IN_CLOSE) && state.openCount > 0) {
+        --state.openCount;
+    }
+    if (mask & (IN_CREATE | IN_MODIFY | IN_MOVED_TO | IN_CLOSE_WRITE)) {
+        state.written = true;
+    }
+
+    if (!state.written) {
+        // Read only access of an untouched file
+        if (!state.openCount) {
+            mFiles.erase(file);
+        }
+        return;
+    }
+
+    if (!state.openCount) {
+        mDeadlines.emplace(state.lastActivity + mQuietPeriod, path);
+        mCondition.notify_one();
+    }
+}
+
+std::size_t WriteCompletionDetector::getTrackedFileCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFiles.size();
+}
+
+std::uint64_t WriteCompletionDetector::getSettledFileCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSettledFileCount;
+}
+
+/**
+ * Deadlines are not removed when a file becomes active again, they are
+ * checked against the current state of the file when they expire.
+ */
+void WriteCompletionDetector::emitSettledFiles()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopped) {
+        if (mDeadlines.empty()) {
+            mCondition.wait(lock);
+            continue;
+        }
+
+        auto deadline = mDeadlines.top();
+        if (std::chrono::steady_clock::now() < deadline.first) {
+            mCondition.wait_until(lock, deadline.first);
+            continue;
+        }
+        mDeadlines.pop();
+
+        auto file = mFiles.find(deadline.second);
+        if (file == mFiles.end() || file->second.openCount
+            || file->second.lastActivity + mQuietPeriod != deadline.first) {
+            continue;
+        }
+
+        Notification notification(
+            Event::close_write, inotifypp::filesystem::path(file->first), file->second.lastActivity);
+        mFiles.erase(file);
+        ++mSettledFileCount;
+
+        lock.unlock();
+        mObserver(notification);
+        lock.lock();
+    }
+}
+}
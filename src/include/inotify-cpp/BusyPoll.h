@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace inotify {
+
+/**
+ * cpu            CPU the reader thread is pinned to, -1 to not pin it.
+ * idleThreshold  Time without kernel records after which the reader stops
+ *                spinning and blocks in epoll_wait until the next record.
+ */
+struct BusyPollOptions {
+    int cpu = -1;
+    std::chrono::microseconds idleThreshold { 1000 };
+};
+
+/**
+ * spinReads        Reads that found records while spinning.
+ * epollReads       Reads that found records after blocking in epoll_wait.
+ * backoffs         Times the reader stopped spinning after the idle threshold.
+ * spinTime         Time spent spinning, i.e. the CPU time traded for latency.
+ * mean/maxWakeLatency  Time between the last empty read and the read that
+ *                  found records while spinning. Upper bound of the delay
+ *                  until the reader noticed a record.
+ * pinned           The reader thread is pinned to the configured CPU, until
+ *                  busy polling is disabled.
+ */
+struct BusyPollStatistics {
+    std::uint64_t spinReads;
+    std::uint64_t epollReads;
+    std::uint64_t backoffs;
+    std::chrono::nanoseconds spinTime;
+    std::chrono::nanoseconds meanWakeLatency;
+    std::chrono::nanoseconds maxWakeLatency;
+    bool pinned;
+};
+}
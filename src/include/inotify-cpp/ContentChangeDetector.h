@@ -0,0 +1,99 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/Notification.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+struct ContentChangeOptions {
+    std::size_t threads = 1;
+    std::size_t cacheSize = 64 * 1024;
+    std::size_t chunkSize = 1024 * 1024;
+};
+
+struct ContentHashStatistics {
+    std::uint64_t hashedFiles;
+    std::uint64_t hashedBytes;
+    std::uint64_t changedFiles;
+    std::uint64_t unchangedFiles;
+    std::uint64_t failedFiles;
+    double hashingSeconds;
+    double bytesPerSecond;
+};
+
+/**
+ * @brief Hashes files of close_write notifications on background threads
+ *        and tells whether their content changed since the last hash.
+ *
+ * Files are read chunk by chunk into a buffer of each thread and hashed
+ * with XXH64, chaining the chunks by seed, so large files never have to
+ * be held in memory at once. A file that is truncated while it is hashed
+ * is hashed up to its new end.
+ * Digests are kept in a bounded LRU cache. A file that is not cached is
+ * considered changed, as is a file that can not be read, whose digest
+ * is dropped. Every path is always hashed by the same thread, so
+ * notifications of one file are handled in order.
+ *
+ * The observers are called from the hashing threads.
+ */
+class ContentChangeDetector {
+  public:
+    explicit ContentChangeDetector(
+        EventObserver changedObserver,
+        EventObserver unchangedObserver = EventObserver(),
+        ContentChangeOptions options = ContentChangeOptions());
+    ~ContentChangeDetector();
+    ContentChangeDetector(const ContentChangeDetector&) = delete;
+    ContentChangeDetector& operator=(const ContentChangeDetector&) = delete;
+
+    void submit(const Notification& notification);
+    ContentHashStatistics getStatistics();
+
+    static bool hashFile(
+        const inotifypp::filesystem::path& file, std::size_t chunkSize, std::uint64_t& digest);
+    static bool hashFile(
+        const inotifypp::filesystem::path& file,
+        std::vector<std::uint8_t>& buffer,
+        std::uint64_t& digest,
+        std::uint64_t& hashedBytes);
+    static std::uint64_t hash(const void* data, std::size_t length, std::uint64_t seed);
+
+  private:
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Notification> notifications;
+        bool stopped = false;
+        std::thread thread;
+    };
+
+    void work(Worker& worker);
+    bool contentChanged(const std::string& path, std::uint64_t digest);
+    void forgetDigest(const std::string& path);
+
+  private:
+    EventObserver mChangedObserver;
+    EventObserver mUnchangedObserver;
+    ContentChangeOptions mOptions;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    std::mutex mCacheMutex;
+    std::list<std::pair<std::string, std::uint64_t>> mDigests;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::uint64_t>>::iterator>
+        mDigestIndex;
+    ContentHashStatistics mStatistics;
+};
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <iostream>
+#include <type_traits>
 
 #include <sys/inotify.h>
 
@@ -42,6 +43,30 @@ constexpr Event operator|(Event lhs, Event rhs)
         | static_cast<std::underlying_type<Event>::type>(rhs));
 }
 
+/**
+ * Kernel event mask that is needed to observe the given event. Events that
+ * are reported regardless of the mask (q_overflow, unmount, ignored) need
+ * nothing, flags that can be combined with any event (e.g. is_dir) need all.
+ */
+constexpr std::uint32_t watchMaskOf(Event event)
+{
+    return (static_cast<std::uint32_t>(event) & IN_ALL_EVENTS)
+        ? (static_cast<std::uint32_t>(event) & IN_ALL_EVENTS)
+        : (static_cast<std::uint32_t>(event) & (IN_Q_OVERFLOW | IN_UNMOUNT | IN_IGNORED))
+            ? 0
+            : IN_ALL_EVENTS;
+}
+
+/**
+ * Kernel event mask of a watch that has observers. Events that are reported
+ * regardless of the mask still need an installed watch, so an empty mask is
+ * replaced by IN_DELETE_SELF, which occurs at most once per watch.
+ */
+constexpr std::uint32_t observedWatchMask(std::uint32_t eventMask)
+{
+    return eventMask ? eventMask : IN_DELETE_SELF;
+}
+
 std::ostream& operator<<(std::ostream& stream, const Event& event);
 bool containsEvent(const Event& allEvents, const Event& event);
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <inotify-cpp/Event.h>
+#include <inotify-cpp/EventBatch.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief All events below one directory within one aggregation window.
+ */
+struct EventSummary {
+    inotifypp::filesystem::path directory;
+    Event events;
+    std::uint64_t count;
+    std::chrono::steady_clock::time_point firstEventTime;
+    std::chrono::steady_clock::time_point lastEventTime;
+    std::vector<std::string> sampleNames;
+};
+
+using EventSummaryObserver = std::function<void(EventSummary)>;
+
+struct AggregationOptions {
+    std::vector<inotifypp::filesystem::path> roots;
+    std::size_t depth = 1;
+    std::chrono::milliseconds window { 1000 };
+    std::size_t sampleSize = 0;
+    Event events = Event::all;
+};
+
+/**
+ * @brief Rolls events up to the directories at a configured depth and emits
+ *        one summary per directory and time window.
+ *
+ * The depth counts path components below the longest matching root, or
+ * from the start of the path if no roots are given. Events of watches
+ * outside of all roots are summarized per watch. The directory is resolved
+ * from the watch path once per watch descriptor and window, every further
+ * event of that watch costs one hash lookup. Without a watchPath function,
+ * e.g. for events of a shared event bus, the watch path is the parent of
+ * the first event path of an entry; events with IN_ISDIR may be about the
+ * watched directory itself and are resolved one by one until then.
+ *
+ * Summaries are emitted by a background thread at the end of each window
+ * and when the aggregator is destroyed. Only directories with events in
+ * the current window are kept.
+ */
+class EventAggregator {
+  public:
+    EventAggregator(
+        AggregationOptions options,
+        std::function<inotifypp::filesystem::path(int)> watchPath,
+        EventSummaryObserver observer);
+    ~EventAggregator();
+    EventAggregator(const EventAggregator&) = delete;
+    EventAggregator& operator=(const EventAggregator&) = delete;
+
+    void add(
+        int wd,
+        std::uint32_t mask,
+        const inotifypp::filesystem::path& path,
+        std::chrono::steady_clock::time_point eventTime);
+    void add(const EventBatch& batch, std::chrono::steady_clock::time_point eventTime);
+    void forgetWatch(int wd);
+    void flush();
+    std::uint64_t getAggregatedEventCount();
+    Event getEvents() const;
+
+  private:
+    std::size_t summaryOf(int wd, std::uint32_t mask, const inotifypp::filesystem::path& path);
+    inotifypp::filesystem::path aggregationDirectory(const inotifypp::filesystem::path& watchPath);
+    EventSummary& count(
+        int wd,
+        std::uint32_t mask,
+        const inotifypp::filesystem::path& path,
+        std::chrono::steady_clock::time_point eventTime);
+    void flushPeriodically();
+
+  private:
+    AggregationOptions mOptions;
+    std::function<inotifypp::filesystem::path(int)> mWatchPath;
+    EventSummaryObserver mObserver;
+
+    std::unordered_map<int, std::size_t> mSummaryOfWd;
+    std::map<inotifypp::filesystem::path, std::size_t> mSummaryOfDirectory;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<EventSummary> mSummaries;
+    std::vector<std::size_t> mTouchedSummaries;
+    std::uint64_t mAggregatedEventCount;
+    bool mStopped;
+    std::thread mFlushThread;
+};
+}
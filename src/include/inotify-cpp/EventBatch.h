@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Structure of arrays view on a buffer of raw kernel records.
+ *
+ * Index i of all arrays describes the i-th record. Names are not copied,
+ * nameOffsets/nameLengths point into the decoded buffer, which has to
+ * outlive the batch. Consumers that only look at wd and mask can run
+ * tight loops over the arrays without touching names or paths.
+ */
+class EventBatch {
+  public:
+    EventBatch();
+
+    void clear();
+    void reserve(std::size_t records);
+    std::size_t size() const;
+    bool empty() const;
+
+    std::string name(std::size_t index) const;
+    std::size_t countMatching(std::uint32_t eventMask) const;
+    void countByWd(std::uint32_t eventMask, std::unordered_map<int, std::uint64_t>& counts) const;
+
+  public:
+    std::vector<int> wds;
+    std::vector<std::uint32_t> masks;
+    std::vector<std::uint32_t> cookies;
+    std::vector<std::uint32_t> nameOffsets;
+    std::vector<std::uint32_t> nameLengths;
+    const std::uint8_t* buffer;
+};
+
+/**
+ * @brief Decodes all complete records of a kernel event buffer into the batch.
+ *
+ * Name lengths are determined by scanning the NUL padding of each name with
+ * SSE2 where available.
+ *
+ * @return number of consumed bytes
+ */
+std::size_t decodeEventBatch(const std::uint8_t* buffer, std::size_t length, EventBatch& batch);
+}
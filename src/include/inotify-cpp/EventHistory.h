@@ -0,0 +1,91 @@
+#pragma once
+
+#include <inotify-cpp/Event.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+struct HistoryEntry {
+    std::uint64_t sequence;
+    Event event;
+    std::uint32_t cookie;
+    inotifypp::filesystem::path path;
+    std::chrono::steady_clock::time_point time;
+};
+
+/**
+ * ok        The entries following the cursor were returned, possibly none.
+ * aged_out  Entries following the cursor were already evicted. Resume from
+ *           getFirstSequence() - 1 after a full rescan.
+ * ahead     The cursor is beyond the last appended entry, e.g. it was taken
+ *           from the history of a producer before its restart. Resume from
+ *           0 after a full rescan.
+ */
+enum class HistoryStatus { ok, aged_out, ahead };
+
+/**
+ * @brief Retains the most recent events in memory for consumers that
+ *        resume from a sequence number.
+ *
+ * Each appended event gets a monotonically increasing sequence number,
+ * starting at 1. Events are kept as fixed size records in a ring and refer
+ * to their path by an interned id; a path is stored once as long as any
+ * retained event refers to it. The oldest events are evicted when records
+ * and paths exceed the byte capacity. Consumers keep the sequence of the
+ * last entry they processed as cursor and read the entries following it
+ * in batches. All methods are thread safe.
+ */
+class EventHistory {
+  public:
+    explicit EventHistory(std::size_t capacityBytes = 16 * 1024 * 1024);
+
+    std::uint64_t append(const FileSystemEvent& event);
+    HistoryStatus read(
+        std::uint64_t cursor, std::size_t maxEntries, std::vector<HistoryEntry>& entries) const;
+    bool waitFor(std::uint64_t cursor, std::chrono::milliseconds timeout) const;
+
+    std::uint64_t getFirstSequence() const;
+    std::uint64_t getLastSequence() const;
+    std::size_t size() const;
+    std::size_t getSizeInBytes() const;
+
+  private:
+    struct Record {
+        std::uint32_t mask;
+        std::uint32_t cookie;
+        std::uint32_t pathId;
+        std::chrono::steady_clock::rep time;
+    };
+
+    struct InternedPath {
+        std::string path;
+        std::size_t references;
+    };
+
+    std::uint32_t internPath(const std::string& path);
+    void releasePath(std::uint32_t pathId);
+    void evict();
+
+  private:
+    std::size_t mCapacityBytes;
+    std::size_t mSizeInBytes;
+    std::uint64_t mFirstSequence;
+    std::deque<Record> mRecords;
+    std::vector<InternedPath> mPaths;
+    std::vector<std::uint32_t> mFreePathIds;
+    std::unordered_map<std::string, std::uint32_t> mPathIds;
+    mutable std::mutex mMutex;
+    mutable std::condition_variable mAppended;
+};
+}
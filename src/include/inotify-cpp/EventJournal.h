@@ -0,0 +1,122 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * none    Records are written in batches, the page cache decides when they hit the disk.
+ * batch   Every written batch is followed by fdatasync.
+ * record  Every record is written and synced immediately.
+ */
+enum class JournalDurability { none, batch, record };
+
+struct JournalOptions {
+    inotifypp::filesystem::path directory;
+    std::size_t segmentSize = 64 * 1024 * 1024;
+    std::size_t batchSize = 64 * 1024;
+    JournalDurability durability = JournalDurability::batch;
+    // Buffered records are written at the latest after this interval, zero disables it
+    std::chrono::milliseconds flushInterval { 1000 };
+};
+
+struct JournalEntry {
+    std::uint64_t sequence;
+    std::chrono::system_clock::time_point time;
+    std::uint32_t mask;
+    std::uint32_t cookie;
+    std::uint32_t pathId;
+    std::string path;
+};
+
+/**
+ * @brief Appends events as compact binary records to segment files.
+ *
+ * Each event gets a monotonically increasing sequence number. Paths are
+ * interned: a path is stored once per segment and events refer to it by
+ * id. Segments are rotated when they exceed the configured size and are
+ * named by the sequence number of their first event, so a journal can be
+ * continued after a restart. A background thread flushes records that are
+ * buffered for longer than the flush interval; errors it encounters are
+ * thrown by the next call of append or flush.
+ */
+class EventJournalWriter {
+  public:
+    explicit EventJournalWriter(JournalOptions options);
+    ~EventJournalWriter();
+    EventJournalWriter(const EventJournalWriter&) = delete;
+    EventJournalWriter& operator=(const EventJournalWriter&) = delete;
+
+    std::uint64_t append(const FileSystemEvent& event);
+    void flush();
+    std::uint64_t getNextSequence() const;
+
+  private:
+    void openSegment();
+    void closeSegment();
+    std::uint32_t internPath(const std::string& path);
+    void writeBuffer();
+    void flushBuffer();
+    void rethrowFlushError();
+    void flushPeriodically();
+
+  private:
+    JournalOptions mOptions;
+    int mFd;
+    std::size_t mSegmentBytes;
+    std::uint64_t mNextSequence;
+    std::vector<std::uint8_t> mBuffer;
+    std::unordered_map<std::string, std::uint32_t> mPathIds;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::exception_ptr mFlushError;
+    bool mStopped;
+    std::thread mFlushThread;
+};
+
+/**
+ * @brief Replays a journal by mapping its segments into memory.
+ *
+ * A reader sees the segments as they were when they were opened; records
+ * that are written concurrently and a truncated tail after a crash are
+ * ignored.
+ */
+class EventJournalReader {
+  public:
+    explicit EventJournalReader(inotifypp::filesystem::path directory);
+    ~EventJournalReader();
+    EventJournalReader(const EventJournalReader&) = delete;
+    EventJournalReader& operator=(const EventJournalReader&) = delete;
+
+    bool seek(std::uint64_t sequence);
+    bool next(JournalEntry& entry);
+    std::uint64_t getFirstSequence() const;
+    std::uint64_t getLastSegmentSequence() const;
+
+  private:
+    bool openSegment(std::size_t index);
+    void closeSegment();
+
+  private:
+    std::vector<std::pair<std::uint64_t, inotifypp::filesystem::path>> mSegments;
+    std::size_t mSegmentIndex;
+    const std::uint8_t* mData;
+    std::size_t mSize;
+    std::size_t mOffset;
+    std::size_t mEntryOffset;
+    std::unordered_map<std::uint32_t, std::string> mPaths;
+};
+}
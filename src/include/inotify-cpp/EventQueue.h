@@ -0,0 +1,78 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace inotify {
+
+/**
+ * Defines what happens when an event is pushed to a full EventQueue.
+ *
+ * block        The reader stops decoding kernel records until the queue
+ *              drains; pending events stay in the kernel queue.
+ * drop_oldest  The oldest queued event is discarded.
+ * drop_newest  The pushed event is discarded.
+ * coalesce     The newest queued event of the same path absorbs the
+ *              pushed event and adds its count if it has the same mask,
+ *              so the order of different events of a path is kept.
+ *              Otherwise the oldest event is discarded.
+ */
+enum class QueueOverflowPolicy { block, drop_oldest, drop_newest, coalesce };
+
+struct EventQueueStatistics {
+    std::uint64_t pushedEvents;
+    std::uint64_t droppedOldestEvents;
+    std::uint64_t droppedNewestEvents;
+    std::uint64_t coalescedEvents;
+    std::uint64_t blockedReads;
+    std::size_t maxSize;
+};
+
+/**
+ * @brief Bounded FIFO of FileSystemEvents with a configurable
+ *        overflow policy and counters for every taken action.
+ */
+class EventQueue {
+  public:
+    EventQueue();
+
+    void setCapacity(std::size_t capacity, QueueOverflowPolicy policy);
+    std::size_t getCapacity() const;
+    QueueOverflowPolicy getPolicy() const;
+
+    /**
+     * @return false if an event was lost (dropped) by this push
+     */
+    bool push(const FileSystemEvent& event);
+    FileSystemEvent& front();
+    void pop();
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+     * @return number of events that can be pushed before the capacity is reached
+     */
+    std::size_t available() const;
+    void countBlockedRead();
+    EventQueueStatistics getStatistics() const;
+
+  private:
+    void popFront();
+    void pushBack(const FileSystemEvent& event);
+
+  private:
+    std::deque<FileSystemEvent> mEvents;
+    std::size_t mCapacity;
+    QueueOverflowPolicy mPolicy;
+    EventQueueStatistics mStatistics;
+    // Absolute position of the newest queued event of each path, maintained
+    // for the coalesce policy only
+    std::unordered_map<std::string, std::uint64_t> mNewestEventOf;
+    std::uint64_t mFrontPosition;
+};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/inotify.h>
+
+namespace inotify {
+
+/**
+ * rate         Every rate-th event of a path and event type is delivered.
+ * interval     If not zero, at most one event per path and event type is
+ *              delivered per interval instead.
+ * mustDeliver  Events that contain any of these bits are never sampled.
+ * maxPaths     Number of tracked paths, the pending counts of all paths are
+ *              dropped when it is exceeded.
+ */
+struct SamplingOptions {
+    std::uint32_t rate = 1;
+    std::chrono::milliseconds interval { 0 };
+    std::uint32_t mustDeliver = IN_ALL_EVENTS & ~(IN_ACCESS | IN_OPEN | IN_CLOSE_NOWRITE);
+    std::size_t maxPaths = 64 * 1024;
+};
+
+/**
+ * sampledEvents    Events that were counted but not delivered.
+ * deliveredEvents  Sampled events that were delivered with their count.
+ */
+struct SamplingStatistics {
+    std::uint64_t sampledEvents;
+    std::uint64_t deliveredEvents;
+};
+
+/**
+ * @brief Events of a path and event type that were counted but not delivered.
+ */
+struct PendingSample {
+    int wd;
+    std::uint32_t mask;
+    std::string name;
+    std::uint32_t count;
+};
+
+/**
+ * @brief Deterministic per-path sampling of raw kernel records.
+ *
+ * The sampler decides on the watch descriptor, mask and name of a record,
+ * so skipped records never construct a path. A delivered event represents
+ * itself and all skipped events of the same path and type since the last
+ * delivered one. The name of a path is copied once when it is first
+ * tracked, so pending counts can be flushed, e.g. when the notifier stops.
+ */
+class EventSampler {
+  public:
+    explicit EventSampler(SamplingOptions options = SamplingOptions());
+
+    bool accept(
+        int wd,
+        std::uint32_t mask,
+        const char* name,
+        std::size_t length,
+        std::uint32_t& count);
+    std::vector<PendingSample> flush();
+    SamplingStatistics getStatistics() const;
+
+  private:
+    struct PathState {
+        std::uint32_t pending;
+        std::chrono::steady_clock::time_point lastDelivery;
+        int wd;
+        std::uint32_t mask;
+        std::string name;
+    };
+
+  private:
+    SamplingOptions mOptions;
+    std::unordered_map<std::uint64_t, PathState> mPaths;
+    SamplingStatistics mStatistics;
+};
+}
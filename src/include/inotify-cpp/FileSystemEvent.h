@@ -13,11 +13,20 @@ class FileSystemEvent {
         const inotifypp::filesystem::path& path,
         const std::chrono::steady_clock::time_point& eventTime);
 
+    FileSystemEvent(
+        int wd,
+        uint32_t mask,
+        uint32_t cookie,
+        const inotifypp::filesystem::path& path,
+        const std::chrono::steady_clock::time_point& eventTime);
+
     ~FileSystemEvent();
 
   public:
     int wd;
     uint32_t mask;
+    uint32_t cookie;
+    uint32_t count;
     inotifypp::filesystem::path path;
     std::chrono::steady_clock::time_point eventTime;
 };
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/inotify.h>
+
+namespace inotify {
+
+/**
+ * Defines what happens to a directory that produces at least
+ * HeavyHittersOptions::hotShare of all events.
+ *
+ * report       The hot path observer is called only.
+ * ignore       The directory and its subtree are ignored permanently.
+ * reduce_mask  HeavyHittersOptions::reducedEvents are removed from the
+ *              mask of the watch of the directory.
+ */
+enum class HotPathAction { report, ignore, reduce_mask };
+
+struct HeavyHittersOptions {
+    std::size_t topK = 16;
+    std::size_t sketchWidth = 2048;
+    std::size_t sketchDepth = 4;
+    double hotShare = 0;
+    std::uint64_t checkInterval = 10000;
+    HotPathAction action = HotPathAction::report;
+    std::uint32_t reducedEvents = IN_ACCESS | IN_MODIFY | IN_OPEN | IN_CLOSE_NOWRITE;
+};
+
+/**
+ * @brief Estimated number of events of a watch (name is empty) or of a name
+ *        inside of a watched directory.
+ */
+struct HeavyHitter {
+    int wd;
+    std::string name;
+    std::uint64_t count;
+};
+
+struct HotPath {
+    inotifypp::filesystem::path path;
+    std::uint64_t count;
+    double share;
+};
+
+using HotPathObserver = std::function<void(HotPath)>;
+
+/**
+ * @brief Streaming top-K of the busiest watches and names in constant memory.
+ *
+ * Events are counted in a count-min sketch with conservative update, which
+ * overestimates a count only by collisions and never underestimates it. The
+ * K keys with the highest estimates are kept as candidates per kind, one set
+ * for watches and one for names. An event costs sketchDepth counter updates
+ * and a scan of 2 * topK candidates; the name of a key is copied only when it
+ * becomes a candidate. Memory is fixed by sketchWidth * sketchDepth counters
+ * and the candidates, independent of the number of watches and files.
+ */
+class HeavyHitters {
+  public:
+    explicit HeavyHitters(
+        std::size_t topK = 16, std::size_t sketchWidth = 2048, std::size_t sketchDepth = 4);
+
+    void add(int wd, const char* name, std::size_t length);
+    void forgetWatch(int wd);
+    void clear();
+
+    std::vector<HeavyHitter> getDirectories() const;
+    std::vector<HeavyHitter> getFiles() const;
+    std::uint64_t getEventCount() const;
+
+  private:
+    struct Candidate {
+        std::uint64_t key;
+        int wd;
+        std::string name;
+        std::uint64_t count;
+    };
+
+    std::uint64_t increment(std::uint64_t key);
+    void offer(
+        std::vector<Candidate>& candidates,
+        std::uint64_t key,
+        int wd,
+        const char* name,
+        std::size_t length,
+        std::uint64_t count);
+    static std::vector<HeavyHitter> sorted(const std::vector<Candidate>& candidates);
+
+  private:
+    std::size_t mTopK;
+    std::size_t mSketchWidth;
+    std::size_t mSketchDepth;
+    std::vector<std::uint64_t> mSketch;
+    std::vector<Candidate> mDirectories;
+    std::vector<Candidate> mFiles;
+    std::uint64_t mEventCount;
+};
+}
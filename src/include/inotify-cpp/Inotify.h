@@ -9,23 +9,40 @@
 #include <atomic>
 #include <boost/bimap.hpp>
 #include <chrono>
+#include <deque>
 #include <errno.h>
 #include <exception>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <sched.h>
+#include <set>
 #include <sstream>
 #include <string>
 #include <sys/epoll.h>
 #include <sys/inotify.h>
+#include <sys/types.h>
 #include <thread>
 #include <time.h>
 #include <vector>
 
+#include <inotify-cpp/BusyPoll.h>
+#include <inotify-cpp/EventBatch.h>
+#include <inotify-cpp/EventQueue.h>
+#include <inotify-cpp/EventSampler.h>
 #include <inotify-cpp/FileSystemEvent.h>
 #include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/HeavyHitters.h>
+#include <inotify-cpp/MountTable.h>
+#include <inotify-cpp/NameFilter.h>
+#include <inotify-cpp/PriorityEventQueue.h>
+#include <inotify-cpp/ReadBuffer.h>
+#include <inotify-cpp/StaleEvent.h>
+#include <inotify-cpp/SymlinkPolicy.h>
 
-#define MAX_EVENTS       4096
 /**
  * MAX_EPOLL_EVENTS is set to 1 since there exists
  * only one eventbuffer. The value can be increased
@@ -34,6 +51,11 @@
  */
 #define MAX_EPOLL_EVENTS 1
 #define EVENT_SIZE       (sizeof (inotify_event))
+/**
+ * Number of watches added by one command of watchDirectoryRecursively
+ * while the event loop runs. Events are read between two commands.
+ */
+#define WATCHES_PER_COMMAND 1024
 
 /**
  * @brief C++ wrapper for linux inotify interface
@@ -69,6 +91,24 @@
  * IN_MOVE           IN_MOVED_FROM|IN_MOVED_TO
  * IN_CLOSE          IN_CLOSE_WRITE | IN_CLOSE_NOWRITE
  *
+ * Every watch carries its own kernel mask. It is the intersection of the
+ * global event mask (setEventMask) extended by the path specific events of
+ * the watch mask provider (setWatchMaskProvider), the mask requested for the watch
+ * (watchFile(file, mask)) and the ignore filters: a watch whose path is
+ * ignored permanently is not installed at all (parked) until it becomes
+ * relevant again. Thus the kernel does not generate events nobody listens to.
+ *
+ * Watches, ignore filters, masks and the name filter can be changed from
+ * any thread while another thread waits in getNextEvent. Such changes are
+ * queued as commands and applied by the event loop between two reads, the
+ * calling thread waits until its command was applied. When no event loop
+ * runs, commands are applied by the calling thread. The event loop only
+ * checks an atomic flag for pending commands and takes no lock otherwise.
+ *
+ * Decoding kernel records throws no exceptions. Records of a watch
+ * descriptor without a current watch, e.g. records that were queued before
+ * the watch was removed, are counted and reported to onStaleEvent instead.
+ *
  * See inotify manpage for more event details
  *
  */
@@ -79,26 +119,99 @@ class Inotify {
   Inotify();
   ~Inotify();
   void watchDirectoryRecursively(inotifypp::filesystem::path path);
+  void watchDirectoryRecursively(inotifypp::filesystem::path path, uint32_t eventMask);
   void watchFile(inotifypp::filesystem::path file);
+  void watchFile(inotifypp::filesystem::path file, uint32_t eventMask);
+  void watchFiles(std::vector<inotifypp::filesystem::path> files, uint32_t eventMask);
+  static std::vector<inotifypp::filesystem::path> collectWatchPaths(const inotifypp::filesystem::path& path,
+      SymlinkPolicy symlinkPolicy = SymlinkPolicy::fan_out, const MountOptions& mountOptions = MountOptions());
+  void setSymlinkPolicy(SymlinkPolicy symlinkPolicy);
+  void setMountOptions(MountOptions mountOptions);
   void unwatchFile(inotifypp::filesystem::path file);
   void ignoreFileOnce(inotifypp::filesystem::path file);
   void ignoreFile(inotifypp::filesystem::path file);
   void setEventMask(uint32_t eventMask);
   uint32_t getEventMask();
+  void setWatchMaskProvider(std::function<uint32_t(const inotifypp::filesystem::path&)> watchMaskProvider);
+  uint32_t getWatchMask(inotifypp::filesystem::path file);
+  void updateWatchMasks();
+  void invalidateWatchMasks();
+  void setNameFilter(NameFilter nameFilter);
+  uint64_t getNameFilteredEventCount();
+  void setEventQueueCapacity(std::size_t capacity, QueueOverflowPolicy policy);
+  EventQueueStatistics getEventQueueStatistics();
+  uint64_t getKernelOverflowCount();
+  void addPriorityLane(inotifypp::filesystem::path subtree, unsigned priority, unsigned weight);
+  void setLaneScheduling(LaneScheduling scheduling);
+  std::vector<LaneStatistics> getLaneStatistics();
+  void trackHeavyHitters(HeavyHittersOptions options, HotPathObserver onHotPath);
+  std::vector<HotPath> getHotDirectories();
+  std::vector<HotPath> getHotFiles();
+  void enableBusyPolling(BusyPollOptions options);
+  void disableBusyPolling();
+  BusyPollStatistics getBusyPollStatistics();
+  void setSampling(SamplingOptions options);
+  SamplingStatistics getSamplingStatistics();
+  void setReadBufferOptions(ReadBufferOptions options);
+  ReadBufferStatistics getReadBufferStatistics();
+  void onStaleEvent(StaleEventObserver onStaleEvent);
+  uint64_t getStaleEventCount();
+  void onWatchRemoved(std::function<void(int)> onWatchRemoved);
   void setEventTimeout(std::chrono::milliseconds eventTimeout, std::function<void(FileSystemEvent)> onEventTimeout);
   inotifypp::optional<FileSystemEvent> getNextEvent();
+  std::size_t readEventBatch(EventBatch& batch);
+  inotifypp::filesystem::path getWatchPath(int wd);
   void stop();
   bool hasStopped();
 
 private:
-  inotifypp::filesystem::path wdToPath(int wd);
+  // Applies the watch changes of a subscription as one command
+  friend class WatchHub;
+
+  struct WatchEntry {
+    uint32_t generation;
+    bool directory;
+    dev_t device;
+  };
+
+  void addWatch(const inotifypp::filesystem::path& file, uint32_t eventMask);
+  void addPathAlias(int wd, const inotifypp::filesystem::path& alias, uint32_t eventMask);
+  void collectPathAliases(int wd, const inotifypp::filesystem::path& watchPath);
+  void updatePathAliases(const inotifypp::filesystem::path& subtree);
+  uint32_t watchMaskFor(const inotifypp::filesystem::path& file);
+  uint32_t sharedWatchMaskFor(const inotifypp::filesystem::path& file);
   bool isIgnored(std::string file);
+  bool isIgnoredPermanently(const std::string& file);
   bool isOnTimeout(const std::chrono::steady_clock::time_point &eventTime);
   void removeWatch(int wd);
-  ssize_t readEventsIntoBuffer(std::vector<uint8_t>& eventBuffer);
-  void readEventsFromBuffer(uint8_t* buffer, int length, std::vector<FileSystemEvent> &events);
-  void filterEvents(std::vector<FileSystemEvent>& events, std::queue<FileSystemEvent>& eventQueue);
+  void forgetWatch(int wd, bool keepPathAliases = false);
+  void retireWatch(int wd, bool keepPathAliases = false);
+  void handleIgnored(int wd);
+  inotifypp::filesystem::path releaseFileSystem(int wd);
+  bool dropStaleEvent(const inotify_event* event);
+  bool reserveLanes(
+      const inotify_event* event,
+      const inotifypp::filesystem::path& watchPath,
+      const WatchEntry& watchEntry,
+      const std::vector<std::pair<std::size_t, inotifypp::filesystem::path>>* pathAliases);
+  void flushSampledEvents();
+  void countHeavyHitter(int wd, const char* name, std::size_t length);
+  void handleHotPaths();
+  std::vector<HotPath> toHotPaths(const std::vector<HeavyHitter>& heavyHitters);
+  ssize_t readEventsIntoBuffer();
+  ssize_t readRecords();
+  ssize_t busyPoll();
+  void pinReaderThread();
+  void restoreReaderAffinity();
+  int readEventsFromBuffer(uint8_t* buffer, int length, std::vector<FileSystemEvent> &events, std::size_t maxEvents);
+  void filterEvents(std::vector<FileSystemEvent>& events, PriorityEventQueue& eventQueue);
+  void pollEvents(std::vector<FileSystemEvent>& events);
   void sendStopSignal();
+  void runCommand(std::function<void()> command);
+  std::future<void> submitCommand(std::function<void()> command);
+  void runPendingCommands(std::size_t maxCommands);
+  void enterEventLoop();
+  void leaveEventLoop();
 
 private:
   int mError;
@@ -108,8 +221,26 @@ private:
   uint32_t mThreadSleep;
   std::vector<std::string> mIgnoredDirectories;
   std::vector<std::string> mOnceIgnoredDirectories;
-  std::queue<FileSystemEvent> mEventQueue;
+  std::vector<std::string> mIgnoredSubtrees;
+  PriorityEventQueue mEventQueue;
+  bool mEventsLost;
+  uint64_t mKernelOverflowCount;
   boost::bimap<int, inotifypp::filesystem::path> mDirectorieMap;
+  std::map<int, WatchEntry> mWatchEntries;
+  std::multimap<int, uint32_t> mRetiredWatches;
+  uint32_t mWatchGeneration;
+  uint64_t mStaleEventCount;
+  StaleEventObserver mOnStaleEvent;
+  std::function<void(int)> mOnWatchRemoved;
+  std::map<int, uint32_t> mWatchMasks;
+  std::map<inotifypp::filesystem::path, uint32_t> mRequestedEventMasks;
+  std::set<inotifypp::filesystem::path> mParkedWatches;
+  SymlinkPolicy mSymlinkPolicy;
+  MountOptions mMountOptions;
+  std::multimap<inotifypp::filesystem::path, inotifypp::filesystem::path> mPathAliases;
+  std::map<int, std::vector<std::pair<std::size_t, inotifypp::filesystem::path>>>
+      mPathAliasesOfWatch;
+  bool mWatchMasksOutdated;
   int mInotifyFd;
   std::atomic<bool> mStopped;
   int mEpollFd;
@@ -118,7 +249,34 @@ private:
   epoll_event mEpollEvents[MAX_EPOLL_EVENTS];
 
   std::function<void(FileSystemEvent)> mOnEventTimeout;
-  std::vector<uint8_t> mEventBuffer;
+  NameFilter mNameFilter;
+  uint64_t mNameFilteredEventCount;
+  std::function<uint32_t(const inotifypp::filesystem::path&)> mWatchMaskProvider;
+  std::unique_ptr<HeavyHitters> mHeavyHitters;
+  HeavyHittersOptions mHeavyHittersOptions;
+  HotPathObserver mOnHotPath;
+  std::set<int> mHotWatches;
+  std::unique_ptr<EventSampler> mEventSampler;
+  std::deque<FileSystemEvent> mFlushedEvents;
+  bool mBusyPolling;
+  BusyPollOptions mBusyPollOptions;
+  BusyPollStatistics mBusyPollStatistics;
+  std::chrono::nanoseconds mTotalWakeLatency;
+  std::chrono::steady_clock::time_point mLastRecordTime;
+  std::thread::id mPinnedThread;
+  std::thread::id mAffinityThread;
+  cpu_set_t mReaderAffinity;
+  ReadBuffer mEventBuffer;
+  bool mRecordsPending;
+  int mEventBufferOffset;
+  int mEventBufferLength;
+
+  std::recursive_mutex mCommandMutex;
+  std::deque<std::packaged_task<void()>> mCommands;
+  std::atomic<bool> mCommandsPending;
+  std::atomic<bool> mEventLoopActive;
+  int mCommandFd;
+  epoll_event mCommandEpollEvent;
 
   int mStopPipeFd[2];
   const int mPipeReadIdx;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace inotify {
+
+/**
+ * @brief Mounts below the root that a recursive watch descends into. A
+ *        mount is crossed where the device of a directory differs from
+ *        its parent. The root itself is always watched.
+ *
+ * oneFileSystem  Stay on the file system of the root.
+ * includedTypes  If not empty, only mounts of these types are crossed.
+ * excludedTypes  Mounts of these types are not crossed, e.g. nfs or proc.
+ * excludedPaths  Mount points that are not crossed.
+ */
+struct MountOptions {
+    bool oneFileSystem = false;
+    std::vector<std::string> includedTypes;
+    std::vector<std::string> excludedTypes;
+    std::vector<inotifypp::filesystem::path> excludedPaths;
+
+    bool empty() const;
+};
+
+struct Mount {
+    inotifypp::filesystem::path mountPoint;
+    std::string type;
+};
+
+/**
+ * @brief Mounts by device, read from /proc/self/mountinfo. Only consulted
+ *        when a crawl crosses a mount.
+ */
+class MountTable {
+  public:
+    static MountTable read();
+    static MountTable parse(std::istream& mountInfo);
+
+    const Mount* find(dev_t device) const;
+    bool admits(
+        dev_t device,
+        const inotifypp::filesystem::path& path,
+        const MountOptions& options) const;
+
+  private:
+    std::map<dev_t, Mount> mMounts;
+};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Include/exclude filter on the bare name of an event
+ *        (the name field of the kernel record, without directory).
+ *
+ * The filter is evaluated directly on the bytes of the kernel event
+ * buffer, before a path is constructed for the event. A name passes
+ * if it matches at least one include rule (or no include rules exist)
+ * and matches no exclude rule. Rules are evaluated from cheap to
+ * expensive: extensions, globs (fnmatch) and regular expressions.
+ * Events without a name (events on the watched file/directory itself)
+ * and events of directories (IN_ISDIR) are never filtered, so an include
+ * rule such as "*.log" does not hide newly created subdirectories.
+ */
+class NameFilter {
+  public:
+    auto includeExtension(std::string extension) -> NameFilter&;
+    auto excludeExtension(std::string extension) -> NameFilter&;
+    auto includeGlob(std::string glob) -> NameFilter&;
+    auto excludeGlob(std::string glob) -> NameFilter&;
+    auto includeRegex(const std::string& regex) -> NameFilter&;
+    auto excludeRegex(const std::string& regex) -> NameFilter&;
+
+    auto accepts(const char* name, std::size_t length) const -> bool;
+    auto accepts(const std::string& name) const -> bool;
+    auto empty() const -> bool;
+
+  private:
+    struct Rules {
+        std::vector<std::string> extensions;
+        std::vector<std::string> globs;
+        std::vector<std::regex> regexes;
+
+        auto empty() const -> bool;
+        auto matches(const char* name, std::size_t length) const -> bool;
+    };
+
+    Rules mIncludes;
+    Rules mExcludes;
+};
+}
@@ -4,6 +4,8 @@
 #include <inotify-cpp/FileSystemAdapter.h>
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
 
 namespace inotify {
 
@@ -12,11 +14,22 @@ class Notification {
     Notification(
         const Event& event,
         const inotifypp::filesystem::path& path,
-        std::chrono::steady_clock::time_point time);
+        std::chrono::steady_clock::time_point time,
+        std::uint32_t count = 1);
+
+    Notification(
+        const Event& event,
+        inotifypp::filesystem::path&& path,
+        std::chrono::steady_clock::time_point time,
+        std::uint32_t count = 1);
 
   public:
     const Event event;
     const inotifypp::filesystem::path path;
     const std::chrono::steady_clock::time_point time;
+    /** Number of events the notification represents, more than 1 if sampled */
+    const std::uint32_t count;
 };
+
+using EventObserver = std::function<void(Notification)>;
 }
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <inotify-cpp/ContentChangeDetector.h>
+#include <inotify-cpp/EventAggregator.h>
+#include <inotify-cpp/EventHistory.h>
+#include <inotify-cpp/EventJournal.h>
 #include <inotify-cpp/Inotify.h>
 #include <inotify-cpp/Notification.h>
+#include <inotify-cpp/SharedEventBus.h>
+#include <inotify-cpp/SubtreeRouter.h>
+#include <inotify-cpp/WriteCompletionDetector.h>
 #include <inotify-cpp/FileSystemAdapter.h>
 
 #include <memory>
@@ -9,31 +16,87 @@
 
 namespace inotify {
 
-using EventObserver = std::function<void(Notification)>;
-
 class NotifierBuilder {
   public:
     NotifierBuilder();
+    explicit NotifierBuilder(std::shared_ptr<SharedEventSubscriber> eventSubscriber);
 
     auto run() -> void;
     auto runOnce() -> void;
     auto stop() -> void;
     auto watchPathRecursively(inotifypp::filesystem::path path) -> NotifierBuilder&;
+    auto watchPathRecursively(inotifypp::filesystem::path path, Event events) -> NotifierBuilder&;
     auto watchFile(inotifypp::filesystem::path file) -> NotifierBuilder&;
+    auto watchFile(inotifypp::filesystem::path file, Event events) -> NotifierBuilder&;
+    auto setSymlinkPolicy(SymlinkPolicy symlinkPolicy) -> NotifierBuilder&;
+    auto setMountOptions(MountOptions mountOptions) -> NotifierBuilder&;
     auto unwatchFile(inotifypp::filesystem::path file) -> NotifierBuilder&;
     auto ignoreFileOnce(inotifypp::filesystem::path file) -> NotifierBuilder&;
     auto ignoreFile(inotifypp::filesystem::path file) -> NotifierBuilder&;
+    auto setNameFilter(NameFilter nameFilter) -> NotifierBuilder&;
     auto onEvent(Event event, EventObserver) -> NotifierBuilder&;
     auto onEvents(std::vector<Event> event, EventObserver) -> NotifierBuilder&;
+    auto onEvent(inotifypp::filesystem::path subtree, Event event, EventObserver)
+        -> NotifierBuilder&;
+    auto onEvents(inotifypp::filesystem::path subtree, std::vector<Event> events, EventObserver)
+        -> NotifierBuilder&;
     auto onUnexpectedEvent(EventObserver) -> NotifierBuilder&;
+    auto onContentChange(
+        EventObserver changedObserver,
+        EventObserver unchangedObserver = EventObserver(),
+        ContentChangeOptions options = ContentChangeOptions()) -> NotifierBuilder&;
+    auto getContentHashStatistics() -> ContentHashStatistics;
+    auto aggregateEvents(AggregationOptions options, EventSummaryObserver summaryObserver)
+        -> NotifierBuilder&;
+    auto onFileSettled(std::chrono::milliseconds quietPeriod, EventObserver eventObserver)
+        -> NotifierBuilder&;
+    auto setEventQueueCapacity(std::size_t capacity, QueueOverflowPolicy policy)
+        -> NotifierBuilder&;
+    auto getEventQueueStatistics() -> EventQueueStatistics;
+    auto setPriorityLane(inotifypp::filesystem::path subtree, unsigned priority, unsigned weight = 1)
+        -> NotifierBuilder&;
+    auto setLaneScheduling(LaneScheduling scheduling) -> NotifierBuilder&;
+    auto getLaneStatistics() -> std::vector<LaneStatistics>;
+    auto trackHotPaths(
+        HeavyHittersOptions options = HeavyHittersOptions(),
+        HotPathObserver hotPathObserver = HotPathObserver()) -> NotifierBuilder&;
+    auto getHotDirectories() -> std::vector<HotPath>;
+    auto getHotFiles() -> std::vector<HotPath>;
+    auto enableBusyPolling(BusyPollOptions options = BusyPollOptions()) -> NotifierBuilder&;
+    auto getBusyPollStatistics() -> BusyPollStatistics;
+    auto sampleEvents(SamplingOptions options) -> NotifierBuilder&;
+    auto getSamplingStatistics() -> SamplingStatistics;
+    auto setReadBufferOptions(ReadBufferOptions options) -> NotifierBuilder&;
+    auto getReadBufferStatistics() -> ReadBufferStatistics;
+    auto onStaleEvent(StaleEventObserver staleEventObserver) -> NotifierBuilder&;
+    auto getStaleEventCount() -> uint64_t;
+    auto publishTo(std::shared_ptr<SharedEventPublisher> eventPublisher) -> NotifierBuilder&;
+    auto journalTo(std::shared_ptr<EventJournalWriter> eventJournal) -> NotifierBuilder&;
+    auto keepHistory(std::shared_ptr<EventHistory> eventHistory) -> NotifierBuilder&;
     auto setEventTimeout(std::chrono::milliseconds timeout, EventObserver eventObserver)
         -> NotifierBuilder&;
 
+  private:
+    auto updateEventMask() -> void;
+    auto dispatchNextEvent() -> bool;
+    auto hasStopped() -> bool;
+    auto getInotify() -> Inotify&;
+
   private:
     std::shared_ptr<Inotify> mInotify;
     std::map<Event, EventObserver> mEventObserver;
+    std::shared_ptr<SubtreeRouter> mSubtreeRouter;
     EventObserver mUnexpectedEventObserver;
+    bool mHasEventTimeoutObserver;
+    std::shared_ptr<SharedEventSubscriber> mEventSubscriber;
+    std::shared_ptr<SharedEventPublisher> mEventPublisher;
+    std::shared_ptr<EventJournalWriter> mEventJournal;
+    std::shared_ptr<EventHistory> mEventHistory;
+    std::shared_ptr<ContentChangeDetector> mContentChangeDetector;
+    std::shared_ptr<EventAggregator> mEventAggregator;
+    std::shared_ptr<WriteCompletionDetector> mWriteCompletionDetector;
 };
 
 NotifierBuilder BuildNotifier();
+NotifierBuilder BuildNotifier(std::shared_ptr<SharedEventSubscriber> eventSubscriber);
 }
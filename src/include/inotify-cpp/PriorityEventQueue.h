@@ -0,0 +1,104 @@
+#pragma once
+
+#include <inotify-cpp/EventQueue.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * Defines the order in which PriorityEventQueue drains its lanes.
+ *
+ * strict    Events of a lane are dispatched only if all lanes of
+ *           higher priority are empty.
+ * weighted  Weighted round robin in order of priority: per round each
+ *           non empty lane dispatches up to its weight events, so
+ *           lower lanes can not starve.
+ */
+enum class LaneScheduling { strict, weighted };
+
+struct LaneStatistics {
+    unsigned priority;
+    unsigned weight;
+    std::size_t depth;
+    std::uint64_t dispatchedEvents;
+    std::chrono::microseconds meanLatency;
+    std::chrono::microseconds maxLatency;
+    EventQueueStatistics queue;
+};
+
+/**
+ * @brief Event queue with one EventQueue per priority lane.
+ *
+ * Subtrees are assigned to lanes by priority, everything else goes to
+ * the default lane of priority 0. The lane of an event is the lane of
+ * the deepest subtree containing its path. It is cached per watch
+ * descriptor and directory, so only events of directories that contain
+ * lane subtrees themselves compare their full path. Latency is the time
+ * between decoding an event and dispatching it.
+ *
+ * With the block policy a full lane only stops the decode at a record of
+ * that lane: the decoder reserves the place of each record in its lane,
+ * so records of other lanes queued before it are still decoded.
+ */
+class PriorityEventQueue {
+  public:
+    PriorityEventQueue();
+
+    void addLane(const inotifypp::filesystem::path& subtree, unsigned priority, unsigned weight);
+    void setScheduling(LaneScheduling scheduling);
+    bool hasLanes() const;
+
+    void setCapacity(std::size_t capacity, QueueOverflowPolicy policy);
+    bool push(const FileSystemEvent& event);
+    FileSystemEvent& front();
+    void pop();
+    bool empty() const;
+    std::size_t size() const;
+    std::size_t available() const;
+    bool blocksPerLane() const;
+    bool reserve(int wd, const inotifypp::filesystem::path& path);
+    void clearReservations();
+    void countBlockedRead();
+    EventQueueStatistics getStatistics() const;
+    std::vector<LaneStatistics> getLaneStatistics() const;
+
+  private:
+    struct Lane {
+        unsigned priority;
+        unsigned weight;
+        unsigned credit;
+        EventQueue events;
+        std::size_t reserved;
+        std::uint64_t dispatchedEvents;
+        std::chrono::steady_clock::duration totalLatency;
+        std::chrono::steady_clock::duration maxLatency;
+    };
+
+    struct CachedDirectory {
+        inotifypp::filesystem::path directory;
+        std::size_t lane;
+        std::vector<std::pair<inotifypp::filesystem::path, std::size_t>> children;
+    };
+
+    std::size_t laneOf(int wd, const inotifypp::filesystem::path& path);
+    std::size_t laneOf(const inotifypp::filesystem::path& path) const;
+    std::size_t selectLane();
+
+  private:
+    std::vector<Lane> mLanes;
+    std::vector<std::pair<inotifypp::filesystem::path, std::size_t>> mSubtrees;
+    std::unordered_map<int, CachedDirectory> mDirectoryCache;
+    LaneScheduling mScheduling;
+    std::size_t mSelectedLane;
+    std::size_t mBlockedLane;
+    std::size_t mSize;
+};
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Buffers that are shared by the read buffers of several instances,
+ *        so idle instances hold no buffer. Thread safe.
+ *
+ * Buffers are kept by size, released buffers beyond maxRetainedBytes are
+ * freed.
+ */
+class ReadBufferPool {
+  public:
+    explicit ReadBufferPool(std::size_t maxRetainedBytes = 16 * 1024 * 1024);
+
+    std::vector<std::uint8_t> acquire(std::size_t size);
+    void release(std::vector<std::uint8_t> buffer);
+    std::size_t getRetainedBytes() const;
+
+  private:
+    std::size_t mMaxRetainedBytes;
+    std::size_t mRetainedBytes;
+    std::multimap<std::size_t, std::vector<std::uint8_t>> mBuffers;
+    mutable std::mutex mMutex;
+};
+
+/**
+ * minimumSize  Size the buffer shrinks to, at least one record with the
+ *              longest name.
+ * maximumSize  Size the buffer grows to for large bursts.
+ * idleTimeout  Period after which the buffer shrinks to the largest burst
+ *              of the period. Without records for this period the buffer
+ *              shrinks to the minimum size or, if pooled, goes back to
+ *              the pool.
+ * pool         Optional pool shared with other instances.
+ */
+struct ReadBufferOptions {
+    std::size_t minimumSize = 4 * 1024;
+    std::size_t maximumSize = 1024 * 1024;
+    std::chrono::milliseconds idleTimeout { 1000 };
+    std::shared_ptr<ReadBufferPool> pool;
+};
+
+/**
+ * size            Current size in bytes, 0 while released to the pool.
+ * largestBurst    Largest number of bytes that were pending before a read.
+ * reads           Reads of kernel records.
+ * truncatedReads  Reads that left records pending, because they exceeded
+ *                 the maximum size.
+ * grows/shrinks   Resizes of the buffer.
+ */
+struct ReadBufferStatistics {
+    std::size_t size;
+    std::size_t largestBurst;
+    std::uint64_t reads;
+    std::uint64_t truncatedReads;
+    std::uint64_t grows;
+    std::uint64_t shrinks;
+};
+
+/**
+ * @brief Buffer for kernel records that is sized by the number of pending
+ *        bytes (FIONREAD) before every read.
+ *
+ * The buffer grows in powers of two up to the maximum size, so a burst is
+ * read by a single syscall. Once per idle timeout it shrinks to the largest
+ * burst that was observed since, so a single burst does not pin memory.
+ */
+class ReadBuffer {
+  public:
+    explicit ReadBuffer(ReadBufferOptions options = ReadBufferOptions());
+    ~ReadBuffer();
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    void setOptions(ReadBufferOptions options);
+    std::uint8_t* data();
+    std::size_t size() const;
+    void reserve(std::size_t pending);
+    void countRead(std::size_t pending);
+    bool isReleasable() const;
+    void release();
+    std::chrono::milliseconds getIdleTimeout() const;
+    ReadBufferStatistics getStatistics() const;
+
+  private:
+    std::size_t sizeFor(std::size_t pending) const;
+    void resize(std::size_t size);
+
+  private:
+    ReadBufferOptions mOptions;
+    std::vector<std::uint8_t> mBuffer;
+    std::size_t mPeriodBurst;
+    std::chrono::steady_clock::time_point mPeriodStart;
+    ReadBufferStatistics mStatistics;
+};
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace inotify {
+
+namespace detail {
+struct SharedEventBusHeader;
+struct SharedEventSlot;
+}
+
+/**
+ * @brief Writes events into a shared memory ring buffer (memfd) that can be
+ *        read by several SharedEventSubscribers in other processes.
+ *
+ * The ring consists of fixed size slots protected by a per slot sequence
+ * number (seqlock). The publisher never waits for subscribers; subscribers
+ * that fall behind by more than the capacity lose events and get an
+ * IN_Q_OVERFLOW event. Waiting subscribers are woken by a futex on the
+ * shared mapping, the wake syscall is skipped when nobody waits.
+ *
+ * Subscribers map the bus by the file descriptor (inherited or passed via
+ * SCM_RIGHTS) or by the path returned by getPath().
+ */
+class SharedEventPublisher {
+  public:
+    explicit SharedEventPublisher(std::size_t capacity = 1024, std::size_t maxPathLength = 4096);
+    ~SharedEventPublisher();
+    SharedEventPublisher(const SharedEventPublisher&) = delete;
+    SharedEventPublisher& operator=(const SharedEventPublisher&) = delete;
+
+    void publish(const FileSystemEvent& event);
+    int getFd() const;
+    std::string getPath() const;
+    std::uint64_t getPublishedEventCount() const;
+
+  private:
+    int mFd;
+    std::size_t mSize;
+    detail::SharedEventBusHeader* mHeader;
+};
+
+/**
+ * @brief Reads events published by a SharedEventPublisher. Use it with
+ *        BuildNotifier(subscriber) to get the usual observer API.
+ */
+class SharedEventSubscriber {
+  public:
+    explicit SharedEventSubscriber(int fd);
+    explicit SharedEventSubscriber(const std::string& path);
+    ~SharedEventSubscriber();
+    SharedEventSubscriber(const SharedEventSubscriber&) = delete;
+    SharedEventSubscriber& operator=(const SharedEventSubscriber&) = delete;
+
+    inotifypp::optional<FileSystemEvent> getNextEvent();
+    void stop();
+    bool hasStopped();
+    std::uint64_t getLostEventCount() const;
+
+  private:
+    void map(int fd);
+
+  private:
+    std::size_t mSize;
+    detail::SharedEventBusHeader* mHeader;
+    std::uint64_t mCursor;
+    std::uint64_t mLostEventCount;
+    std::atomic<bool> mStopped;
+};
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace inotify {
+
+/**
+ * removed  The watch was removed or parked, but its IN_IGNORED record was
+ *          not read yet.
+ * unknown  The watch descriptor belongs to no watch of this instance.
+ */
+enum class StaleReason { removed, unknown };
+
+/**
+ * @brief Kernel record of a watch descriptor without a current watch. Such
+ *        records are dropped before a path is constructed.
+ *
+ * generation  Generation of the removed watch, 0 if it is unknown. Every
+ *             added watch gets a new generation, so records of a removed
+ *             watch are told apart from a later watch with the same
+ *             descriptor.
+ */
+struct StaleEvent {
+    int wd;
+    std::uint32_t mask;
+    std::uint32_t cookie;
+    std::string name;
+    std::uint32_t generation;
+    StaleReason reason;
+};
+
+using StaleEventObserver = std::function<void(StaleEvent)>;
+}
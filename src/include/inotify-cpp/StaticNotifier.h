@@ -0,0 +1,191 @@
+#pragma once
+
+#include <inotify-cpp/Event.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/Inotify.h>
+#include <inotify-cpp/NotifierBuilder.h>
+#include <inotify-cpp/Notification.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace inotify {
+
+/**
+ * @brief Binds a handler to an event that is known at compile time.
+ *        Created by on<Event>(handler) and consumed by BuildStaticNotifier.
+ */
+template <Event event, typename Handler> class EventHandler {
+  public:
+    static constexpr Event handledEvent = event;
+
+    explicit EventHandler(Handler handler)
+        : handler(std::move(handler))
+    {
+    }
+
+    Handler handler;
+};
+
+template <Event event, typename Handler>
+auto on(Handler&& handler) -> EventHandler<event, typename std::decay<Handler>::type>
+{
+    return EventHandler<event, typename std::decay<Handler>::type>(std::forward<Handler>(handler));
+}
+
+namespace detail {
+
+constexpr std::uint32_t watchMaskOf()
+{
+    return 0;
+}
+
+template <typename... Events> constexpr std::uint32_t watchMaskOf(Event first, Events... rest)
+{
+    return inotify::watchMaskOf(first) | watchMaskOf(rest...);
+}
+}
+
+/**
+ * @brief Notifier whose events and handlers are fixed at compile time.
+ *
+ * The kernel event mask is a constant expression and the dispatch is
+ * unrolled into a chain of comparisons against template parameters, so
+ * handlers are called directly (and can be inlined) instead of going
+ * through std::function. Handlers receive a const Notification&.
+ * Dispatch semantics equal NotifierBuilder: the first handler whose event
+ * equals the occurred event (or is Event::all) is called.
+ *
+ * @code
+ * auto notifier = BuildStaticNotifier(
+ *     on<Event::create>([](const Notification& n) { ... }),
+ *     on<Event::close_write>([](const Notification& n) { ... }));
+ * notifier.watchPathRecursively(path).run();
+ * @endcode
+ */
+template <typename... EventHandlers> class StaticNotifier {
+  public:
+    static constexpr std::uint32_t eventMask
+        = observedWatchMask(detail::watchMaskOf(EventHandlers::handledEvent...));
+
+    explicit StaticNotifier(EventHandlers... handlers)
+        : mInotify(std::make_shared<Inotify>())
+        , mEventHandlers(std::move(handlers)...)
+    {
+        mInotify->setEventMask(eventMask);
+    }
+
+    auto run() -> void
+    {
+        while (!mInotify->hasStopped()) {
+            runOnce();
+        }
+    }
+
+    auto runOnce() -> void
+    {
+        auto fileSystemEvent = mInotify->getNextEvent();
+        if (!fileSystemEvent) {
+            return;
+        }
+
+        const Notification notification { static_cast<Event>(fileSystemEvent->mask),
+                                          std::move(fileSystemEvent->path),
+                                          fileSystemEvent->eventTime,
+                                          fileSystemEvent->count };
+
+        if (!dispatch(notification, std::integral_constant<std::size_t, 0>()) && mUnexpectedEventObserver) {
+            mUnexpectedEventObserver(notification);
+        }
+    }
+
+    auto stop() -> void
+    {
+        mInotify->stop();
+    }
+
+    auto watchPathRecursively(inotifypp::filesystem::path path) -> StaticNotifier&
+    {
+        mInotify->watchDirectoryRecursively(path);
+        return *this;
+    }
+
+    auto watchFile(inotifypp::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->watchFile(file);
+        return *this;
+    }
+
+    auto unwatchFile(inotifypp::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->unwatchFile(file);
+        return *this;
+    }
+
+    auto ignoreFileOnce(inotifypp::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->ignoreFileOnce(file);
+        return *this;
+    }
+
+    auto ignoreFile(inotifypp::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->ignoreFile(file);
+        return *this;
+    }
+
+    /**
+     * Events without a compile time handler are passed to this observer. Since
+     * every event may be unexpected the kernel mask is widened to all events.
+     */
+    auto onUnexpectedEvent(EventObserver eventObserver) -> StaticNotifier&
+    {
+        mInotify->setEventMask(IN_ALL_EVENTS);
+        mUnexpectedEventObserver = eventObserver;
+        return *this;
+    }
+
+  private:
+    template <std::size_t index>
+    auto dispatch(const Notification& notification, std::integral_constant<std::size_t, index>)
+        -> bool
+    {
+        auto& eventHandler = std::get<index>(mEventHandlers);
+        using Handler = typename std::decay<decltype(eventHandler)>::type;
+
+        if (Handler::handledEvent == Event::all || Handler::handledEvent == notification.event) {
+            eventHandler.handler(notification);
+            return true;
+        }
+
+        return dispatch(notification, std::integral_constant<std::size_t, index + 1>());
+    }
+
+    auto dispatch(
+        const Notification&, std::integral_constant<std::size_t, sizeof...(EventHandlers)>)
+        -> bool
+    {
+        return false;
+    }
+
+  private:
+    std::shared_ptr<Inotify> mInotify;
+    std::tuple<EventHandlers...> mEventHandlers;
+    EventObserver mUnexpectedEventObserver;
+};
+
+template <Event event, typename Handler> constexpr Event EventHandler<event, Handler>::handledEvent;
+
+template <typename... EventHandlers>
+constexpr std::uint32_t StaticNotifier<EventHandlers...>::eventMask;
+
+template <typename... EventHandlers>
+auto BuildStaticNotifier(EventHandlers... handlers) -> StaticNotifier<EventHandlers...>
+{
+    return StaticNotifier<EventHandlers...>(std::move(handlers)...);
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <inotify-cpp/Event.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/Notification.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Routes notifications to observers that are registered
+ *        on a subtree of the filesystem.
+ *
+ * Subscriptions are stored in a trie of path components. A
+ * notification is delivered to the subscriptions of all trie nodes
+ * on the way from the root to its path, so routing costs are
+ * proportional to the path depth and independent of the number of
+ * subscriptions. The trie node of the parent directory is cached
+ * per watch descriptor, thus in the common case only the filename
+ * component has to be looked up. Subscriptions may be added while
+ * other threads route notifications or compute watch masks; observers
+ * are called without holding the lock.
+ */
+class SubtreeRouter {
+  public:
+    SubtreeRouter();
+
+    void subscribe(const inotifypp::filesystem::path& subtree, Event event, EventObserver observer);
+    bool route(int wd, const Notification& notification);
+    std::uint32_t eventMaskFor(const inotifypp::filesystem::path& watchPath) const;
+    bool empty() const;
+
+  private:
+    struct Node {
+        explicit Node(Node* parent);
+
+        Node* parent;
+        std::map<std::string, std::unique_ptr<Node>> children;
+        std::vector<std::pair<Event, std::shared_ptr<EventObserver>>> observers;
+    };
+
+    struct CachedDirectory {
+        inotifypp::filesystem::path path;
+        const Node* node;
+        bool exact;
+    };
+
+    std::pair<const Node*, bool> findDeepest(const inotifypp::filesystem::path& path) const;
+    const Node* findDeepest(int wd, const inotifypp::filesystem::path& path);
+
+  private:
+    mutable std::mutex mMutex;
+    Node mRoot;
+    std::unordered_map<int, CachedDirectory> mDirectoryCache;
+};
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace inotify {
+
+/**
+ * @brief How watchDirectoryRecursively treats symlinks. Every physical
+ *        directory is crawled once, identified by device and inode, so
+ *        symlink cycles terminate.
+ *
+ * fan_out     Symlinks are followed. A file or directory that is reachable
+ *             by several paths shares one watch and its events are reported
+ *             for every path.
+ * first_path  Symlinks are followed, but events of a shared watch are only
+ *             reported for the path that was watched first.
+ * skip        Symlinks are neither followed nor watched.
+ */
+enum class SymlinkPolicy { fan_out, first_path, skip };
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <inotify-cpp/Event.h>
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/Inotify.h>
+#include <inotify-cpp/NameFilter.h>
+#include <inotify-cpp/Notification.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+struct WatchSubscription {
+    std::vector<inotifypp::filesystem::path> roots;
+    Event events = Event::all;
+    NameFilter nameFilter;
+    EventObserver observer;
+};
+
+/**
+ * @brief Shares one inotify instance between independent subscribers.
+ *
+ * Every subscriber registers recursive roots, events and a name filter.
+ * Watches are reference counted, so overlapping trees are watched once,
+ * with the union of the events of all subscribers covering the watch.
+ * Events are fanned out to the subscribers whose roots contain the path
+ * and whose events and name filter match. Unsubscribing releases the
+ * watches nobody else needs and narrows the masks of the shared ones.
+ *
+ * The hub runs its own event loop, observers are called from its thread.
+ * Subscribing and unsubscribing is allowed from any thread, including
+ * observers.
+ */
+class WatchHub {
+  public:
+    WatchHub();
+    ~WatchHub();
+    WatchHub(const WatchHub&) = delete;
+    WatchHub& operator=(const WatchHub&) = delete;
+
+    static std::shared_ptr<WatchHub> processHub();
+
+    std::uint64_t subscribe(WatchSubscription subscription);
+    void unsubscribe(std::uint64_t subscriptionId);
+    std::size_t getSubscriberCount();
+    std::size_t getWatchCount();
+    std::uint32_t getWatchMask(const inotifypp::filesystem::path& path);
+
+  private:
+    struct Subscriber {
+        WatchSubscription subscription;
+        std::uint32_t eventMask;
+        std::vector<inotifypp::filesystem::path> watches;
+    };
+
+    struct CachedWatch {
+        // Subscribers covering the watch and those that cover only some of its entries
+        std::vector<std::shared_ptr<Subscriber>> covering;
+        std::vector<std::shared_ptr<Subscriber>> partial;
+    };
+
+    std::uint32_t eventMaskFor(const inotifypp::filesystem::path& path);
+    void dispatch(const FileSystemEvent& fileSystemEvent);
+    void collectReceivers(
+        const FileSystemEvent& fileSystemEvent,
+        const CachedWatch& watch,
+        std::vector<std::shared_ptr<Subscriber>>& receivers);
+    const CachedWatch& cachedWatch(int wd, const inotifypp::filesystem::path& watchPath);
+    void runEventLoop();
+
+  private:
+    std::shared_ptr<Inotify> mInotify;
+    std::mutex mMutex;
+    std::uint64_t mNextSubscriptionId;
+    std::map<std::uint64_t, std::shared_ptr<Subscriber>> mSubscribers;
+    std::map<inotifypp::filesystem::path, std::size_t> mWatchReferences;
+    std::unordered_map<int, CachedWatch> mWatchCache;
+    std::thread mEventLoop;
+};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <inotify-cpp/FileSystemAdapter.h>
+#include <inotify-cpp/Notification.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Collapses the events of writing a file into a single notification
+ *        once the file has settled.
+ *
+ * A file is tracked after it was created, modified or moved in. It is
+ * settled when it is not open anymore and no event arrived for the quiet
+ * period. inotify does not tell the mode of an open, so every open counts
+ * as a potential writer until its close. The settled notification carries
+ * Event::close_write and the time of the last activity. It is emitted by a
+ * background thread. Files that are removed or moved away before they settle
+ * are forgotten.
+ */
+class WriteCompletionDetector {
+  public:
+    WriteCompletionDetector(std::chrono::milliseconds quietPeriod, EventObserver observer);
+    ~WriteCompletionDetector();
+    WriteCompletionDetector(const WriteCompletionDetector&) = delete;
+    WriteCompletionDetector& operator=(const WriteCompletionDetector&) = delete;
+
+    void add(const Notification& notification);
+    std::size_t getTrackedFileCount();
+    std::uint64_t getSettledFileCount();
+
+  private:
+    struct FileState {
+        int openCount;
+        bool written;
+        std::chrono::steady_clock::time_point lastActivity;
+    };
+
+    using Deadline = std::pair<std::chrono::steady_clock::time_point, std::string>;
+
+    void emitSettledFiles();
+
+  private:
+    std::chrono::milliseconds mQuietPeriod;
+    EventObserver mObserver;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::unordered_map<std::string, FileState> mFiles;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> mDeadlines;
+    std::uint64_t mSettledFileCount;
+    bool mStopped;
+    std::thread mThread;
+};
+}
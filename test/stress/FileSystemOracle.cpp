@@ -0,0 +1,155 @@
+#include "FileSystemOracle.h"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <utility>
+
+using namespace inotify;
+
+std::ostream& operator<<(std::ostream& stream, const OracleReport& report)
+{
+    return stream << "expected " << report.expected << ", delivered " << report.delivered
+                  << ", missing " << report.missing << ", coalesced " << report.coalesced
+                  << ", extra " << report.extra << ", reordered " << report.reordered
+                  << ", overflows " << report.overflows;
+}
+
+FileSystemOracle::FileSystemOracle(std::string root, std::size_t writers)
+    : mRoot(std::move(root))
+    , mExpected(writers)
+    , mDelivered(writers)
+    , mUnattributed(0)
+    , mOverflows(0)
+{
+}
+
+std::string FileSystemOracle::writerRoot(std::size_t writer) const
+{
+    return mRoot + "/w" + std::to_string(writer);
+}
+
+void FileSystemOracle::expect(std::size_t writer, const std::string& path, Event event)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mExpected[writer].push_back(Record { path, event });
+}
+
+void FileSystemOracle::deliver(const Notification& notification)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (notification.event == Event::q_overflow) {
+        ++mOverflows;
+        return;
+    }
+
+    auto path = notification.path.string();
+    auto writer = writerOf(path);
+    if (writer == mDelivered.size()) {
+        ++mUnattributed;
+        return;
+    }
+
+    mDelivered[writer].push_back(Record { path, notification.event });
+    mChanged.notify_all();
+}
+
+/**
+ * @brief Waits until the writer got as many notifications as it expects.
+ */
+bool FileSystemOracle::waitForDelivery(std::size_t writer, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mChanged.wait_for(lock, timeout, [&]() {
+        return mDelivered[writer].size() >= mExpected[writer].size();
+    });
+}
+
+void FileSystemOracle::markWatched(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWatched.insert(directory);
+    mChanged.notify_all();
+}
+
+bool FileSystemOracle::waitForWatch(const std::string& directory, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mChanged.wait_for(lock, timeout, [&]() { return mWatched.count(directory) > 0; });
+}
+
+/**
+ * @brief Matches every delivered notification of a writer with the
+ *        earliest unmatched expected event of the same path and type.
+ */
+OracleReport FileSystemOracle::compare() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    OracleReport report { 0, 0, 0, 0, mUnattributed, 0, mOverflows };
+
+    for (std::size_t writer = 0; writer < mExpected.size(); ++writer) {
+        auto& expected = mExpected[writer];
+        auto& delivered = mDelivered[writer];
+        report.expected += expected.size();
+        report.delivered += delivered.size();
+
+        std::map<std::pair<std::string, Event>, std::deque<std::size_t>> positions;
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            positions[{ expected[i].path, expected[i].event }].push_back(i);
+        }
+
+        std::vector<bool> matched(expected.size(), false);
+        std::size_t latest = 0;
+        for (auto& record : delivered) {
+            auto position = positions.find({ record.path, record.event });
+            if (position == positions.end() || position->second.empty()) {
+                ++report.extra;
+                continue;
+            }
+
+            auto index = position->second.front();
+            position->second.pop_front();
+            matched[index] = true;
+            if (index < latest) {
+                ++report.reordered;
+            }
+            latest = std::max(latest, index);
+        }
+
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            if (matched[i]) {
+                continue;
+            }
+
+            if (i > 0 && expected[i - 1].path == expected[i].path
+                && expected[i - 1].event == expected[i].event) {
+                ++report.coalesced;
+            } else {
+                ++report.missing;
+            }
+        }
+    }
+
+    return report;
+}
+
+/**
+ * @return writer whose tree contains the path, number of writers if none
+ */
+std::size_t FileSystemOracle::writerOf(const std::string& path) const
+{
+    auto prefix = mRoot + "/w";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        return mDelivered.size();
+    }
+
+    auto end = path.find('/', prefix.size());
+    auto id = path.substr(prefix.size(), end == std::string::npos ? end : end - prefix.size());
+    if (id.empty() || !std::all_of(id.begin(), id.end(), ::isdigit)) {
+        return mDelivered.size();
+    }
+
+    return std::min<std::size_t>(std::stoul(id), mDelivered.size());
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <inotify-cpp/Notification.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Result of comparing the delivered notifications with the oracle.
+ *
+ * missing    Expected events that were not delivered.
+ * coalesced  Expected events that were not delivered, but repeat the
+ *            previous expected event of the same writer. The kernel merges
+ *            such events if the first one was not read yet (inotify(7)).
+ * extra      Delivered events that were not expected.
+ * reordered  Delivered events that arrived before an event that the same
+ *            writer caused earlier.
+ */
+struct OracleReport {
+    std::uint64_t expected;
+    std::uint64_t delivered;
+    std::uint64_t missing;
+    std::uint64_t coalesced;
+    std::uint64_t extra;
+    std::uint64_t reordered;
+    std::uint64_t overflows;
+};
+
+std::ostream& operator<<(std::ostream& stream, const OracleReport& report);
+
+/**
+ * @brief Records the events each writer expects from its file system
+ *        mutations and the notifications that were delivered.
+ *
+ * Every writer mutates only the tree below root/w<id>, so delivered
+ * notifications are attributed to writers by path and the order of the
+ * events of one writer is defined.
+ */
+class FileSystemOracle {
+  public:
+    FileSystemOracle(std::string root, std::size_t writers);
+
+    std::string writerRoot(std::size_t writer) const;
+
+    void expect(std::size_t writer, const std::string& path, inotify::Event event);
+    void deliver(const inotify::Notification& notification);
+    bool waitForDelivery(std::size_t writer, std::chrono::milliseconds timeout);
+
+    void markWatched(const std::string& directory);
+    bool waitForWatch(const std::string& directory, std::chrono::milliseconds timeout);
+
+    OracleReport compare() const;
+
+  private:
+    struct Record {
+        std::string path;
+        inotify::Event event;
+    };
+
+    std::size_t writerOf(const std::string& path) const;
+
+  private:
+    std::string mRoot;
+    std::vector<std::vector<Record>> mExpected;
+    std::vector<std::vector<Record>> mDelivered;
+    std::uint64_t mUnattributed;
+    std::uint64_t mOverflows;
+    std::set<std::string> mWatched;
+    mutable std::mutex mMutex;
+    std::condition_variable mChanged;
+};
@@ -0,0 +1,356 @@
+#include "FileSystemOracle.h"
+
+#include <inotify-cpp/NotifierBuilder.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace inotify;
+
+namespace fs = inotifypp::filesystem;
+
+namespace {
+
+const std::chrono::milliseconds syncTimeout { 2000 };
+
+std::size_t fromEnvironment(const char* name, std::size_t defaultValue)
+{
+    auto value = std::getenv(name);
+    return value ? std::stoul(value) : defaultValue;
+}
+
+/**
+ * Prefers tmpfs, so the suite measures the notifier instead of the disk.
+ */
+fs::path stressRoot()
+{
+    auto shm = fs::path("/dev/shm");
+    auto base = fs::is_directory(shm) && access(shm.c_str(), W_OK) == 0
+        ? shm
+        : fs::temp_directory_path();
+    return base / ("inotify-cpp-stress-" + std::to_string(getpid()));
+}
+
+/**
+ * Randomized mutations of the tree of one writer. Every mutation records
+ * the events it causes in the oracle before the syscall. Directories are
+ * renamed or removed only after all earlier events of the writer were
+ * delivered, and nothing below them is touched afterwards, because the
+ * watches keep the path they were added with.
+ */
+class Writer {
+  public:
+    Writer(std::size_t id, FileSystemOracle& oracle)
+        : mId(id)
+        , mOracle(oracle)
+        , mRandom(static_cast<unsigned>(id + 1))
+        , mCounter(0)
+        , mFailures(0)
+    {
+        mDirectories.push_back(oracle.writerRoot(id));
+    }
+
+    void run(std::size_t operations)
+    {
+        std::discrete_distribution<int> pickOperation { 30, 25, 15, 15, 8, 4, 3 };
+        for (std::size_t n = 0; n < operations; ++n) {
+            switch (pickOperation(mRandom)) {
+            case 0: createFile(); break;
+            case 1: writeFile(); break;
+            case 2: renameFile(); break;
+            case 3: removeFile(); break;
+            case 4: createDirectory(); break;
+            case 5: renameDirectory(); break;
+            default: removeDirectory(); break;
+            }
+        }
+    }
+
+    std::size_t failures() const
+    {
+        return mFailures;
+    }
+
+  private:
+    std::string newName(const std::string& directory, const char* prefix)
+    {
+        return directory + "/" + prefix + std::to_string(mCounter++);
+    }
+
+    template <typename T> T& pick(std::vector<T>& items)
+    {
+        return items[std::uniform_int_distribution<std::size_t>(0, items.size() - 1)(mRandom)];
+    }
+
+    void check(bool success)
+    {
+        if (!success) {
+            ++mFailures;
+        }
+    }
+
+    void createFile()
+    {
+        auto path = newName(pick(mDirectories), "f");
+        mOracle.expect(mId, path, Event::create);
+        check(mknod(path.c_str(), S_IFREG | 0644, 0) == 0);
+        mFiles.push_back(path);
+    }
+
+    void writeFile()
+    {
+        if (mFiles.empty()) {
+            return createFile();
+        }
+
+        // Writing the same file twice in a row may be coalesced by the kernel
+        auto& path = pick(mFiles);
+        if (path == mLastWritten) {
+            return createFile();
+        }
+
+        mOracle.expect(mId, path, Event::close_write);
+        auto fd = open(path.c_str(), O_WRONLY);
+        check(fd != -1 && write(fd, "stress", 6) == 6);
+        close(fd);
+        mLastWritten = path;
+    }
+
+    void renameFile()
+    {
+        if (mFiles.empty()) {
+            return createFile();
+        }
+
+        auto& path = pick(mFiles);
+        auto renamed = newName(fs::path(path).parent_path().string(), "m");
+        mOracle.expect(mId, path, Event::moved_from);
+        mOracle.expect(mId, renamed, Event::moved_to);
+        check(rename(path.c_str(), renamed.c_str()) == 0);
+        path = renamed;
+    }
+
+    void removeFile()
+    {
+        if (mFiles.empty()) {
+            return createFile();
+        }
+
+        auto& path = pick(mFiles);
+        mOracle.expect(mId, path, Event::remove);
+        check(unlink(path.c_str()) == 0);
+        path = mFiles.back();
+        mFiles.pop_back();
+    }
+
+    void createDirectory()
+    {
+        auto& parent = pick(mDirectories);
+        auto path = newName(parent, "d");
+        mParents.insert(parent);
+        mOracle.expect(mId, path, Event::create | Event::is_dir);
+        check(mkdir(path.c_str(), 0755) == 0);
+
+        // Mutations inside of the directory are only observable once it is watched
+        check(mOracle.waitForWatch(path, syncTimeout));
+        mDirectories.push_back(path);
+    }
+
+    void renameDirectory()
+    {
+        auto directory = pickLeafDirectory();
+        if (directory == mDirectories.end()) {
+            return createDirectory();
+        }
+
+        auto path = *directory;
+        auto renamed = newName(fs::path(path).parent_path().string(), "r");
+        check(mOracle.waitForDelivery(mId, syncTimeout));
+        mOracle.expect(mId, path, Event::moved_from | Event::is_dir);
+        mOracle.expect(mId, renamed, Event::moved_to | Event::is_dir);
+        check(rename(path.c_str(), renamed.c_str()) == 0);
+        retire(directory);
+    }
+
+    void removeDirectory()
+    {
+        auto directory = pickLeafDirectory();
+        if (directory == mDirectories.end() || hasFiles(*directory)) {
+            return createDirectory();
+        }
+
+        auto path = *directory;
+        check(mOracle.waitForDelivery(mId, syncTimeout));
+        mOracle.expect(mId, path, Event::remove | Event::is_dir);
+        check(rmdir(path.c_str()) == 0);
+        retire(directory);
+    }
+
+    std::vector<std::string>::iterator pickLeafDirectory()
+    {
+        auto directory = mDirectories.begin() + 1 + (mRandom() % mDirectories.size());
+        for (std::size_t i = 0; i + 1 < mDirectories.size(); ++i, ++directory) {
+            if (directory >= mDirectories.end()) {
+                directory = mDirectories.begin() + 1;
+            }
+            if (!mParents.count(*directory)) {
+                return directory;
+            }
+        }
+
+        return mDirectories.end();
+    }
+
+    bool hasFiles(const std::string& directory)
+    {
+        return std::any_of(mFiles.begin(), mFiles.end(), [&](const std::string& file) {
+            return fs::path(file).parent_path() == directory;
+        });
+    }
+
+    void retire(std::vector<std::string>::iterator directory)
+    {
+        auto path = *directory;
+        mDirectories.erase(directory);
+        mFiles.erase(
+            std::remove_if(
+                mFiles.begin(),
+                mFiles.end(),
+                [&](const std::string& file) { return fs::path(file).parent_path() == path; }),
+            mFiles.end());
+        mLastWritten.clear();
+    }
+
+  private:
+    std::size_t mId;
+    FileSystemOracle& mOracle;
+    std::mt19937 mRandom;
+    std::size_t mCounter;
+    std::size_t mFailures;
+    std::vector<std::string> mDirectories;
+    std::vector<std::string> mFiles;
+    std::set<std::string> mParents;
+    std::string mLastWritten;
+};
+}
+
+struct StressTests {
+    StressTests()
+        : root_(stressRoot())
+        , writers_(fromEnvironment("INOTIFY_STRESS_WRITERS", 4))
+        , operations_(fromEnvironment("INOTIFY_STRESS_OPERATIONS", 2000))
+    {
+        fs::remove_all(root_);
+        fs::create_directories(root_);
+    }
+
+    ~StressTests()
+    {
+        fs::remove_all(root_);
+    }
+
+    /**
+     * Runs all writers concurrently against a recursively watched tree,
+     * waits until the notifications settle and reports the comparison.
+     */
+    OracleReport stress(NotifierBuilder& notifier, FileSystemOracle& oracle)
+    {
+        for (std::size_t id = 0; id < writers_; ++id) {
+            fs::create_directories(oracle.writerRoot(id));
+        }
+
+        std::vector<Event> events { Event::create,
+                                    Event::close_write,
+                                    Event::moved_from,
+                                    Event::moved_to,
+                                    Event::remove,
+                                    Event::moved_from | Event::is_dir,
+                                    Event::moved_to | Event::is_dir,
+                                    Event::remove | Event::is_dir,
+                                    Event::q_overflow };
+        notifier.onEvents(events, [&](Notification notification) { oracle.deliver(notification); })
+            .onEvent(Event::create | Event::is_dir, [&](Notification notification) {
+                oracle.deliver(notification);
+                notifier.watchPathRecursively(notification.path);
+                oracle.markWatched(notification.path.string());
+            })
+            .watchPathRecursively(root_);
+
+        std::thread eventLoop([&notifier]() { notifier.run(); });
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Writer> writers;
+        for (std::size_t id = 0; id < writers_; ++id) {
+            writers.emplace_back(id, oracle);
+        }
+        std::vector<std::thread> threads;
+        for (auto& writer : writers) {
+            threads.emplace_back([&writer, this]() { writer.run(operations_); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+        for (std::size_t id = 0; id < writers_; ++id) {
+            oracle.waitForDelivery(id, syncTimeout);
+        }
+
+        notifier.stop();
+        eventLoop.join();
+
+        for (auto& writer : writers) {
+            BOOST_CHECK_EQUAL(0u, writer.failures());
+        }
+
+        auto report = oracle.compare();
+        std::cout << boost::unit_test::framework::current_test_case().p_name << ": " << report
+                  << ", " << static_cast<std::uint64_t>(writers_ * operations_ / seconds.count())
+                  << " ops/s" << std::endl;
+        return report;
+    }
+
+    fs::path root_;
+    std::size_t writers_;
+    std::size_t operations_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldDeliverEveryEventInOrderUnderLoad, StressTests)
+{
+    FileSystemOracle oracle(root_.string(), writers_);
+    auto notifier = BuildNotifier();
+
+    auto report = stress(notifier, oracle);
+
+    BOOST_CHECK_EQUAL(0u, report.overflows);
+    BOOST_CHECK_EQUAL(0u, report.missing);
+    BOOST_CHECK_EQUAL(0u, report.extra);
+    BOOST_CHECK_EQUAL(0u, report.reordered);
+    BOOST_CHECK_EQUAL(report.expected, report.delivered + report.coalesced);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDeliverEveryEventWithBoundedQueueUnderLoad, StressTests)
+{
+    FileSystemOracle oracle(root_.string(), writers_);
+    auto notifier = BuildNotifier().setEventQueueCapacity(64, QueueOverflowPolicy::block);
+
+    auto report = stress(notifier, oracle);
+
+    BOOST_CHECK_EQUAL(0u, report.overflows);
+    BOOST_CHECK_EQUAL(0u, report.missing);
+    BOOST_CHECK_EQUAL(0u, report.extra);
+    BOOST_CHECK_EQUAL(0u, report.reordered);
+}
@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/ContentChangeDetector.h>
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <string>
+#include <vector>
+
+using namespace inotify;
+
+struct ContentChangeDetectorTests {
+    ContentChangeDetectorTests()
+        : testDirectory_("contentTestDirectory")
+        , firstFile_(testDirectory_ / "first.txt")
+        , secondFile_(testDirectory_ / "second.txt")
+        , timeout_(1)
+    {
+        inotifypp::filesystem::create_directories(testDirectory_);
+    }
+
+    ~ContentChangeDetectorTests()
+    {
+        inotifypp::filesystem::remove_all(testDirectory_);
+    }
+
+    void write(const inotifypp::filesystem::path& file, const std::string& content)
+    {
+        std::ofstream stream(file.string());
+        stream << content;
+    }
+
+    Notification closeWrite(const inotifypp::filesystem::path& file)
+    {
+        return Notification(Event::close_write, file, std::chrono::steady_clock::now());
+    }
+
+    bool nextResult(std::future<bool> future)
+    {
+        BOOST_REQUIRE(future.wait_for(timeout_) == std::future_status::ready);
+        return future.get();
+    }
+
+    inotifypp::filesystem::path testDirectory_;
+    inotifypp::filesystem::path firstFile_;
+    inotifypp::filesystem::path secondFile_;
+    std::chrono::seconds timeout_;
+    std::promise<bool> promisedResult_;
+};
+
+BOOST_AUTO_TEST_CASE(shouldHashWithXxHash64)
+{
+    BOOST_CHECK_EQUAL(0xEF46DB3751D8E999ULL, ContentChangeDetector::hash("", 0, 0));
+    BOOST_CHECK_EQUAL(0xD24EC4F1A98C6E5BULL, ContentChangeDetector::hash("a", 1, 0));
+    BOOST_CHECK_EQUAL(0x44BC2CF5AD770999ULL, ContentChangeDetector::hash("abc", 3, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldHashLargeFilesInChunks, ContentChangeDetectorTests)
+{
+    write(firstFile_, std::string(10000, 'x'));
+    write(secondFile_, std::string(9999, 'x') + "y");
+
+    std::uint64_t firstDigest = 0;
+    std::uint64_t secondDigest = 0;
+    std::uint64_t repeatedDigest = 0;
+    BOOST_REQUIRE(ContentChangeDetector::hashFile(firstFile_, 4096, firstDigest));
+    BOOST_REQUIRE(ContentChangeDetector::hashFile(secondFile_, 4096, secondDigest));
+    BOOST_REQUIRE(ContentChangeDetector::hashFile(firstFile_, 4096, repeatedDigest));
+    BOOST_CHECK_NE(firstDigest, secondDigest);
+    BOOST_CHECK_EQUAL(firstDigest, repeatedDigest);
+    BOOST_CHECK(!ContentChangeDetector::hashFile(testDirectory_ / "missing", 4096, firstDigest));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldCountBytesReadFromOpenFile, ContentChangeDetectorTests)
+{
+    write(firstFile_, std::string(10000, 'x'));
+
+    std::vector<std::uint8_t> buffer(4096);
+    std::uint64_t digest = 0;
+    std::uint64_t hashedBytes = 0;
+    BOOST_REQUIRE(ContentChangeDetector::hashFile(firstFile_, buffer, digest, hashedBytes));
+    BOOST_CHECK_EQUAL(10000u, hashedBytes);
+
+    std::uint64_t chunkedDigest = 0;
+    BOOST_REQUIRE(ContentChangeDetector::hashFile(firstFile_, 4096, chunkedDigest));
+    BOOST_CHECK_EQUAL(chunkedDigest, digest);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldSuppressUnchangedContent, ContentChangeDetectorTests)
+{
+    ContentChangeDetector detector(
+        [&](Notification) { promisedResult_.set_value(true); },
+        [&](Notification) { promisedResult_.set_value(false); });
+
+    write(firstFile_, "content");
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(!nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    write(firstFile_, "changed content");
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    auto statistics = detector.getStatistics();
+    BOOST_CHECK_EQUAL(3u, statistics.hashedFiles);
+    BOOST_CHECK_EQUAL(2u, statistics.changedFiles);
+    BOOST_CHECK_EQUAL(1u, statistics.unchangedFiles);
+    BOOST_CHECK_EQUAL(29u, statistics.hashedBytes);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReportUnreadableFilesAsChanged, ContentChangeDetectorTests)
+{
+    ContentChangeDetector detector(
+        [&](Notification) { promisedResult_.set_value(true); },
+        [&](Notification) { promisedResult_.set_value(false); });
+
+    write(firstFile_, "content");
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    inotifypp::filesystem::remove(firstFile_);
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    write(firstFile_, "content");
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+    BOOST_CHECK_EQUAL(1u, detector.getStatistics().failedFiles);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldEvictLeastRecentlyUsedDigests, ContentChangeDetectorTests)
+{
+    ContentChangeOptions options;
+    options.cacheSize = 1;
+    ContentChangeDetector detector(
+        [&](Notification) { promisedResult_.set_value(true); },
+        [&](Notification) { promisedResult_.set_value(false); },
+        options);
+
+    write(firstFile_, "first");
+    write(secondFile_, "second");
+
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    detector.submit(closeWrite(secondFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+
+    promisedResult_ = std::promise<bool>();
+    detector.submit(closeWrite(firstFile_));
+    BOOST_CHECK(nextResult(promisedResult_.get_future()));
+}
@@ -0,0 +1,117 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventAggregator.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+
+using namespace inotify;
+
+struct EventAggregatorTests {
+    EventAggregatorTests()
+        : watchPaths_ { { 1, "data/tenantX/2026/10" },
+                        { 2, "data/tenantX/2026/11" },
+                        { 3, "data/tenantY" },
+                        { 4, "other/directory" } }
+        , now_(std::chrono::steady_clock::now())
+    {
+        options_.roots = { "data/" };
+        options_.window = std::chrono::hours(1);
+    }
+
+    std::map<int, inotifypp::filesystem::path> watchPaths_;
+    std::map<std::string, EventSummary> summaries_;
+    AggregationOptions options_;
+    std::chrono::steady_clock::time_point now_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldAggregateEventsBelowRoots, EventAggregatorTests)
+{
+    options_.sampleSize = 2;
+    EventAggregator aggregator(
+        options_,
+        [this](int wd) { return watchPaths_[wd]; },
+        [this](EventSummary summary) { summaries_[summary.directory.string()] = summary; });
+
+    for (auto i = 0; i < 5; ++i) {
+        aggregator.add(1, IN_CREATE, "data/tenantX/2026/10/file" + std::to_string(i), now_);
+    }
+    aggregator.add(2, IN_MODIFY, "data/tenantX/2026/11/file", now_ + std::chrono::seconds(1));
+    aggregator.add(3, IN_DELETE, "data/tenantY/file", now_);
+    aggregator.add(4, IN_CREATE, "other/directory/file", now_);
+    aggregator.flush();
+
+    BOOST_REQUIRE_EQUAL(3u, summaries_.size());
+    auto& tenantX = summaries_["data/tenantX"];
+    BOOST_CHECK_EQUAL(6u, tenantX.count);
+    BOOST_CHECK(tenantX.events == (Event::create | Event::modify));
+    BOOST_CHECK(tenantX.firstEventTime == now_);
+    BOOST_CHECK(tenantX.lastEventTime == now_ + std::chrono::seconds(1));
+    BOOST_REQUIRE_EQUAL(2u, tenantX.sampleNames.size());
+    BOOST_CHECK_EQUAL("file0", tenantX.sampleNames[0]);
+    BOOST_CHECK_EQUAL(1u, summaries_["data/tenantY"].count);
+    BOOST_CHECK_EQUAL(1u, summaries_["other/directory"].count);
+    BOOST_CHECK_EQUAL(8u, aggregator.getAggregatedEventCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldAggregateToDepth, EventAggregatorTests)
+{
+    options_.roots.clear();
+    options_.depth = 3;
+    options_.events = Event::create;
+    EventAggregator aggregator(
+        options_,
+        [this](int wd) { return watchPaths_[wd]; },
+        [this](EventSummary summary) { summaries_[summary.directory.string()] = summary; });
+
+    aggregator.add(1, IN_CREATE, "data/tenantX/2026/10/file", now_);
+    aggregator.add(2, IN_CREATE, "data/tenantX/2026/11/file", now_);
+    aggregator.add(2, IN_MODIFY, "data/tenantX/2026/11/file", now_);
+    aggregator.add(3, IN_CREATE, "data/tenantY/file", now_);
+    aggregator.flush();
+
+    BOOST_REQUIRE_EQUAL(2u, summaries_.size());
+    BOOST_CHECK_EQUAL(2u, summaries_["data/tenantX/2026"].count);
+    BOOST_CHECK_EQUAL(1u, summaries_["data/tenantY"].count);
+
+    summaries_.clear();
+    aggregator.flush();
+    BOOST_CHECK(summaries_.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldResolveReusedWatchDescriptorAgain, EventAggregatorTests)
+{
+    options_.depth = 2;
+    EventAggregator aggregator(
+        options_,
+        [this](int wd) { return watchPaths_[wd]; },
+        [this](EventSummary summary) { summaries_[summary.directory.string()] = summary; });
+
+    aggregator.add(1, IN_CREATE, "data/tenantX/2026/10/file", now_);
+    aggregator.forgetWatch(1);
+    watchPaths_[1] = "data/tenantY/2026";
+    aggregator.add(1, IN_CREATE, "data/tenantY/2026/file", now_);
+    aggregator.flush();
+
+    BOOST_REQUIRE_EQUAL(2u, summaries_.size());
+    BOOST_CHECK_EQUAL(1u, summaries_["data/tenantX/2026"].count);
+    BOOST_CHECK_EQUAL(1u, summaries_["data/tenantY/2026"].count);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldResolveEntriesWithoutWatchPaths, EventAggregatorTests)
+{
+    options_.depth = 2;
+    EventAggregator aggregator(
+        options_,
+        std::function<inotifypp::filesystem::path(int)>(),
+        [this](EventSummary summary) { summaries_[summary.directory.string()] = summary; });
+
+    aggregator.add(1, IN_OPEN | IN_ISDIR, "data/tenantX/2026", now_);
+    aggregator.add(1, IN_CREATE, "data/tenantX/2026/file", now_);
+    aggregator.add(1, IN_CREATE | IN_ISDIR, "data/tenantX/2026/directory", now_);
+    aggregator.flush();
+
+    BOOST_CHECK_EQUAL(1u, summaries_["data/tenantX"].count);
+    BOOST_CHECK_EQUAL(2u, summaries_["data/tenantX/2026"].count);
+}
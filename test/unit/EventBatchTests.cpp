@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventBatch.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+namespace {
+void appendRecord(std::vector<std::uint8_t>& buffer, int wd, uint32_t mask, const std::string& name)
+{
+    inotify_event record {};
+    record.wd = wd;
+    record.mask = mask;
+    record.len = name.empty() ? 0 : (name.size() / sizeof(inotify_event) + 1) * sizeof(inotify_event);
+
+    auto offset = buffer.size();
+    buffer.resize(offset + sizeof(inotify_event) + record.len, 0);
+    std::memcpy(buffer.data() + offset, &record, sizeof(inotify_event));
+    std::memcpy(buffer.data() + offset + sizeof(inotify_event), name.data(), name.size());
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldDecodeRecordsIntoArrays)
+{
+    std::vector<std::string> names { "", "a", "fifteen_chars__", "sixteen_chars___", "a_name_that_is_longer_than_32_chars" };
+    std::vector<std::uint8_t> buffer;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        appendRecord(buffer, static_cast<int>(i % 2), i % 2 ? IN_MODIFY : IN_CREATE, names[i]);
+    }
+
+    EventBatch batch;
+    BOOST_CHECK_EQUAL(buffer.size(), decodeEventBatch(buffer.data(), buffer.size(), batch));
+    BOOST_REQUIRE_EQUAL(names.size(), batch.size());
+
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        BOOST_CHECK_EQUAL(names[i], batch.name(i));
+        BOOST_CHECK_EQUAL(static_cast<int>(i % 2), batch.wds[i]);
+    }
+
+    BOOST_CHECK_EQUAL(2u, batch.countMatching(IN_MODIFY));
+
+    std::unordered_map<int, std::uint64_t> counts;
+    batch.countByWd(IN_CREATE | IN_MODIFY, counts);
+    BOOST_CHECK_EQUAL(3u, counts[0]);
+    BOOST_CHECK_EQUAL(2u, counts[1]);
+}
+
+BOOST_AUTO_TEST_CASE(shouldNotDecodeIncompleteRecords)
+{
+    std::vector<std::uint8_t> buffer;
+    appendRecord(buffer, 1, IN_CREATE, "complete");
+    auto complete = buffer.size();
+    appendRecord(buffer, 1, IN_CREATE, "truncated");
+    buffer.resize(buffer.size() - 4);
+
+    EventBatch batch;
+    BOOST_CHECK_EQUAL(complete, decodeEventBatch(buffer.data(), buffer.size(), batch));
+    BOOST_CHECK_EQUAL(1u, batch.size());
+}
@@ -0,0 +1,108 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventHistory.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+namespace {
+void append(EventHistory& history, std::size_t events, const std::string& prefix = "file")
+{
+    for (std::size_t i = 0; i < events; ++i) {
+        history.append(FileSystemEvent(
+            1,
+            IN_MODIFY,
+            static_cast<uint32_t>(i),
+            prefix + std::to_string(i % 4),
+            std::chrono::steady_clock::now()));
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldResumeFromCursorInBatches)
+{
+    EventHistory history;
+    append(history, 10);
+
+    std::vector<HistoryEntry> entries;
+    BOOST_CHECK(history.read(0, 4, entries) == HistoryStatus::ok);
+    BOOST_REQUIRE_EQUAL(4u, entries.size());
+    BOOST_CHECK_EQUAL(1u, entries[0].sequence);
+    BOOST_CHECK(entries[0].event == Event::modify);
+    BOOST_CHECK_EQUAL("file0", entries[0].path.string());
+
+    BOOST_CHECK(history.read(entries.back().sequence, 100, entries) == HistoryStatus::ok);
+    BOOST_REQUIRE_EQUAL(6u, entries.size());
+    BOOST_CHECK_EQUAL(5u, entries[0].sequence);
+    BOOST_CHECK_EQUAL(5u, entries[1].cookie);
+    BOOST_CHECK_EQUAL("file1", entries[1].path.string());
+    BOOST_CHECK_EQUAL(10u, history.getLastSequence());
+
+    BOOST_CHECK(history.read(10, 100, entries) == HistoryStatus::ok);
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(shouldSignalAgedOutCursor)
+{
+    EventHistory history(2048);
+    append(history, 100, std::string(100, 'x'));
+
+    BOOST_CHECK(history.getSizeInBytes() <= 2048u);
+    BOOST_CHECK(history.getFirstSequence() > 1u);
+    BOOST_CHECK_EQUAL(100u, history.getLastSequence());
+    BOOST_CHECK_EQUAL(
+        history.getLastSequence() - history.getFirstSequence() + 1, history.size());
+
+    std::vector<HistoryEntry> entries;
+    BOOST_CHECK(history.read(0, 10, entries) == HistoryStatus::aged_out);
+    BOOST_CHECK(entries.empty());
+
+    BOOST_CHECK(history.read(history.getFirstSequence() - 1, 1, entries) == HistoryStatus::ok);
+    BOOST_REQUIRE_EQUAL(1u, entries.size());
+    BOOST_CHECK_EQUAL(history.getFirstSequence(), entries[0].sequence);
+}
+
+BOOST_AUTO_TEST_CASE(shouldSignalCursorAheadOfHistory)
+{
+    EventHistory history;
+    append(history, 10);
+
+    // The cursor of a consumer that outlived a restart of the producer
+    std::vector<HistoryEntry> entries;
+    BOOST_CHECK(history.read(42, 10, entries) == HistoryStatus::ahead);
+    BOOST_CHECK(entries.empty());
+    BOOST_CHECK(history.waitFor(42, std::chrono::milliseconds(0)));
+    BOOST_CHECK(history.read(10, 10, entries) == HistoryStatus::ok);
+}
+
+BOOST_AUTO_TEST_CASE(shouldReleaseEvictedPaths)
+{
+    EventHistory history(1024);
+    for (auto i = 0; i < 1000; ++i) {
+        append(history, 1, "unique" + std::to_string(i) + "-");
+    }
+
+    BOOST_CHECK(history.getSizeInBytes() <= 1024u);
+    BOOST_CHECK(history.size() < 10u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldWakeWaitingConsumer)
+{
+    EventHistory history;
+    BOOST_CHECK(!history.waitFor(0, std::chrono::milliseconds(10)));
+
+    std::thread producer([&history]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        append(history, 1);
+    });
+
+    BOOST_CHECK(history.waitFor(0, std::chrono::seconds(1)));
+    producer.join();
+    BOOST_CHECK(!history.waitFor(1, std::chrono::milliseconds(10)));
+}
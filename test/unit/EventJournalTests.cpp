@@ -0,0 +1,133 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventJournal.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+struct EventJournalTests {
+    EventJournalTests()
+        : journalDirectory_("journalDirectory")
+    {
+        inotifypp::filesystem::remove_all(journalDirectory_);
+    }
+
+    ~EventJournalTests()
+    {
+        inotifypp::filesystem::remove_all(journalDirectory_);
+    }
+
+    JournalOptions options(std::size_t segmentSize)
+    {
+        JournalOptions options;
+        options.directory = journalDirectory_;
+        options.segmentSize = segmentSize;
+        options.batchSize = 256;
+        options.durability = JournalDurability::none;
+        return options;
+    }
+
+    void append(EventJournalWriter& writer, std::size_t events)
+    {
+        for (std::size_t i = 0; i < events; ++i) {
+            writer.append(FileSystemEvent(
+                1,
+                IN_MODIFY,
+                static_cast<uint32_t>(i),
+                "dir/file" + std::to_string(i % 3),
+                std::chrono::steady_clock::now()));
+        }
+    }
+
+    inotifypp::filesystem::path journalDirectory_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldReplayJournalAcrossSegments, EventJournalTests)
+{
+    {
+        EventJournalWriter writer(options(512));
+        append(writer, 100);
+    }
+
+    EventJournalReader reader(journalDirectory_);
+    JournalEntry entry;
+    std::uint64_t expectedSequence = 0;
+    while (reader.next(entry)) {
+        BOOST_CHECK_EQUAL(expectedSequence, entry.sequence);
+        BOOST_CHECK_EQUAL("dir/file" + std::to_string(expectedSequence % 3), entry.path);
+        BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), entry.mask);
+        BOOST_CHECK_EQUAL(expectedSequence, entry.cookie);
+        ++expectedSequence;
+    }
+    BOOST_CHECK_EQUAL(100u, expectedSequence);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldSeekBySequence, EventJournalTests)
+{
+    {
+        EventJournalWriter writer(options(512));
+        append(writer, 100);
+    }
+
+    EventJournalReader reader(journalDirectory_);
+    JournalEntry entry;
+    BOOST_REQUIRE(reader.seek(57));
+    BOOST_REQUIRE(reader.next(entry));
+    BOOST_CHECK_EQUAL(57u, entry.sequence);
+    BOOST_CHECK_EQUAL("dir/file0", entry.path);
+    BOOST_CHECK(!reader.seek(100));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldContinueSequenceOfExistingJournal, EventJournalTests)
+{
+    {
+        EventJournalWriter writer(options(4096));
+        append(writer, 10);
+    }
+
+    EventJournalWriter writer(options(4096));
+    BOOST_CHECK_EQUAL(10u, writer.getNextSequence());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldSkipFilesThatAreNoSegments, EventJournalTests)
+{
+    {
+        EventJournalWriter writer(options(512));
+        append(writer, 100);
+    }
+    std::ofstream((journalDirectory_ / "segment-backup.journal").string());
+    std::ofstream((journalDirectory_ / "segment-00000000000000000000.journal.tmp").string());
+
+    EventJournalWriter writer(options(512));
+    BOOST_CHECK_EQUAL(100u, writer.getNextSequence());
+
+    EventJournalReader reader(journalDirectory_);
+    BOOST_CHECK_EQUAL(0u, reader.getFirstSequence());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldFlushQuietJournalAfterInterval, EventJournalTests)
+{
+    auto journalOptions = options(4096);
+    journalOptions.durability = JournalDurability::batch;
+    journalOptions.flushInterval = std::chrono::milliseconds(10);
+    EventJournalWriter writer(journalOptions);
+    append(writer, 1);
+
+    JournalEntry entry;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    bool flushed = false;
+    while (!flushed && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        EventJournalReader reader(journalDirectory_);
+        flushed = reader.next(entry);
+    }
+
+    BOOST_CHECK(flushed);
+    BOOST_CHECK_EQUAL(0u, entry.sequence);
+}
@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventQueue.h>
+
+#include <chrono>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+namespace {
+FileSystemEvent makeEvent(const char* path, uint32_t mask = IN_MODIFY)
+{
+    return FileSystemEvent(1, mask, path, std::chrono::steady_clock::now());
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldDropOldestEvents)
+{
+    EventQueue queue;
+    queue.setCapacity(2, QueueOverflowPolicy::drop_oldest);
+
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK(queue.push(makeEvent("b")));
+    BOOST_CHECK(!queue.push(makeEvent("c")));
+
+    BOOST_CHECK_EQUAL(2u, queue.size());
+    BOOST_CHECK_EQUAL("b", queue.front().path.string());
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().droppedOldestEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldDropNewestEvents)
+{
+    EventQueue queue;
+    queue.setCapacity(1, QueueOverflowPolicy::drop_newest);
+
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK(!queue.push(makeEvent("b")));
+
+    BOOST_CHECK_EQUAL(1u, queue.size());
+    BOOST_CHECK_EQUAL("a", queue.front().path.string());
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().droppedNewestEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldCoalesceEventsOfSamePath)
+{
+    EventQueue queue;
+    queue.setCapacity(2, QueueOverflowPolicy::coalesce);
+
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK(queue.push(makeEvent("b")));
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK(!queue.push(makeEvent("a", IN_OPEN)));
+
+    BOOST_CHECK_EQUAL(2u, queue.size());
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().coalescedEvents);
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().droppedOldestEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldNotCoalesceAcrossOtherEventsOfSamePath)
+{
+    EventQueue queue;
+    queue.setCapacity(2, QueueOverflowPolicy::coalesce);
+
+    queue.push(makeEvent("a"));
+    queue.push(makeEvent("a", IN_DELETE));
+    BOOST_CHECK(!queue.push(makeEvent("a")));
+
+    BOOST_CHECK_EQUAL(0u, queue.getStatistics().coalescedEvents);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_DELETE), queue.front().mask);
+    queue.pop();
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), queue.front().mask);
+
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK(queue.push(makeEvent("a")));
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().coalescedEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldCountCoalescedEvents)
+{
+    EventQueue queue;
+    queue.setCapacity(2, QueueOverflowPolicy::coalesce);
+
+    queue.push(makeEvent("a"));
+    queue.push(makeEvent("b"));
+    queue.push(makeEvent("b"));
+    queue.push(makeEvent("b"));
+    queue.pop();
+    queue.push(makeEvent("a"));
+    queue.push(makeEvent("a"));
+
+    BOOST_CHECK_EQUAL(2u, queue.size());
+    BOOST_CHECK_EQUAL("b", queue.front().path.string());
+    BOOST_CHECK_EQUAL(3u, queue.front().count);
+    queue.pop();
+    BOOST_CHECK_EQUAL("a", queue.front().path.string());
+    BOOST_CHECK_EQUAL(2u, queue.front().count);
+}
+
+BOOST_AUTO_TEST_CASE(shouldReportAvailableSpaceOnlyWhenBlocking)
+{
+    EventQueue queue;
+    queue.setCapacity(2, QueueOverflowPolicy::block);
+    queue.push(makeEvent("a"));
+    BOOST_CHECK_EQUAL(1u, queue.available());
+
+    queue.setCapacity(2, QueueOverflowPolicy::drop_newest);
+    BOOST_CHECK(queue.available() > 2u);
+}
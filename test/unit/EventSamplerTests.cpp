@@ -0,0 +1,65 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/EventSampler.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+namespace {
+std::vector<std::uint32_t> sample(
+    EventSampler& sampler, int wd, std::uint32_t mask, const std::string& name, int times)
+{
+    std::vector<std::uint32_t> counts;
+    for (auto i = 0; i < times; ++i) {
+        std::uint32_t count = 0;
+        if (sampler.accept(wd, mask, name.c_str(), name.size(), count)) {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldDeliverEveryNthEventPerPath)
+{
+    SamplingOptions options;
+    options.rate = 4;
+    EventSampler sampler(options);
+
+    BOOST_CHECK((std::vector<std::uint32_t> { 4, 4 }) == sample(sampler, 1, IN_ACCESS, "a", 9));
+    BOOST_CHECK((std::vector<std::uint32_t> { 4 }) == sample(sampler, 1, IN_ACCESS, "b", 4));
+    BOOST_CHECK((std::vector<std::uint32_t> { 4 }) == sample(sampler, 1, IN_ACCESS, "a", 3));
+    BOOST_CHECK((std::vector<std::uint32_t> {}) == sample(sampler, 1, IN_OPEN, "a", 3));
+
+    auto statistics = sampler.getStatistics();
+    BOOST_CHECK_EQUAL(4u, statistics.deliveredEvents);
+    BOOST_CHECK_EQUAL(15u, statistics.sampledEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldAlwaysDeliverMustDeliverEvents)
+{
+    SamplingOptions options;
+    options.rate = 100;
+    EventSampler sampler(options);
+
+    BOOST_CHECK((std::vector<std::uint32_t> { 1, 1, 1 }) == sample(sampler, 1, IN_CREATE, "a", 3));
+    BOOST_CHECK(sample(sampler, 1, IN_ACCESS, "a", 3).empty());
+    BOOST_CHECK_EQUAL(0u, sampler.getStatistics().deliveredEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldDeliverOneEventPerInterval)
+{
+    SamplingOptions options;
+    options.interval = std::chrono::milliseconds(50);
+    EventSampler sampler(options);
+
+    BOOST_CHECK((std::vector<std::uint32_t> { 1 }) == sample(sampler, 1, IN_OPEN, "a", 5));
+    std::this_thread::sleep_for(options.interval);
+    BOOST_CHECK((std::vector<std::uint32_t> { 5 }) == sample(sampler, 1, IN_OPEN, "a", 1));
+}
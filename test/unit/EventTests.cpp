@@ -20,3 +20,28 @@ BOOST_AUTO_TEST_CASE(shouldOutputEventsCorrectly)
     eventSStream << Event::close;
     BOOST_CHECK_EQUAL("close (close_write  | close_nowrite) ", eventSStream.str());
 }
+
+BOOST_AUTO_TEST_CASE(shouldDeriveWatchMaskOfEvents)
+{
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), watchMaskOf(Event::modify));
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_CLOSE_WRITE | IN_CLOSE_NOWRITE), watchMaskOf(Event::close));
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_CREATE), watchMaskOf(Event::create | Event::is_dir));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_ALL_EVENTS), watchMaskOf(Event::all));
+}
+
+BOOST_AUTO_TEST_CASE(shouldNotWidenWatchMaskForEventsTheKernelAlwaysReports)
+{
+    BOOST_CHECK_EQUAL(0u, watchMaskOf(Event::q_overflow));
+    BOOST_CHECK_EQUAL(0u, watchMaskOf(Event::unmount));
+    BOOST_CHECK_EQUAL(0u, watchMaskOf(Event::ignored));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_ALL_EVENTS), watchMaskOf(Event::is_dir));
+}
+
+BOOST_AUTO_TEST_CASE(shouldKeepWatchesOfObservedEventsInstalled)
+{
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), observedWatchMask(IN_MODIFY));
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_DELETE_SELF), observedWatchMask(watchMaskOf(Event::unmount)));
+}
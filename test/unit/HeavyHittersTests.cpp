@@ -0,0 +1,72 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/HeavyHitters.h>
+
+#include <string>
+
+using namespace inotify;
+
+namespace {
+void add(HeavyHitters& heavyHitters, int wd, const std::string& name, int times)
+{
+    for (auto i = 0; i < times; ++i) {
+        heavyHitters.add(wd, name.c_str(), name.size());
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldRankBusiestWatchesAndNames)
+{
+    HeavyHitters heavyHitters(2);
+    add(heavyHitters, 1, "quiet", 3);
+    add(heavyHitters, 2, "app.log", 50);
+    add(heavyHitters, 3, "cache", 20);
+    add(heavyHitters, 2, "other.log", 1);
+
+    auto directories = heavyHitters.getDirectories();
+    BOOST_REQUIRE_EQUAL(2u, directories.size());
+    BOOST_CHECK_EQUAL(2, directories[0].wd);
+    BOOST_CHECK_EQUAL(51u, directories[0].count);
+    BOOST_CHECK(directories[0].name.empty());
+    BOOST_CHECK_EQUAL(3, directories[1].wd);
+
+    auto files = heavyHitters.getFiles();
+    BOOST_REQUIRE_EQUAL(2u, files.size());
+    BOOST_CHECK_EQUAL("app.log", files[0].name);
+    BOOST_CHECK_EQUAL(50u, files[0].count);
+    BOOST_CHECK_EQUAL("cache", files[1].name);
+    BOOST_CHECK_EQUAL(74u, heavyHitters.getEventCount());
+}
+
+BOOST_AUTO_TEST_CASE(shouldNeverUnderestimateInSmallSketch)
+{
+    HeavyHitters heavyHitters(4, 8, 2);
+    for (auto wd = 1; wd <= 100; ++wd) {
+        add(heavyHitters, wd, "file", 1);
+    }
+    add(heavyHitters, 7, "hot", 500);
+
+    auto files = heavyHitters.getFiles();
+    BOOST_REQUIRE(!files.empty());
+    BOOST_CHECK_EQUAL("hot", files[0].name);
+    BOOST_CHECK_EQUAL(7, files[0].wd);
+    BOOST_CHECK(files[0].count >= 500u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldForgetCandidatesOfRemovedWatch)
+{
+    HeavyHitters heavyHitters;
+    add(heavyHitters, 1, "a", 5);
+    add(heavyHitters, 2, "b", 3);
+
+    heavyHitters.forgetWatch(1);
+
+    auto directories = heavyHitters.getDirectories();
+    BOOST_REQUIRE_EQUAL(1u, directories.size());
+    BOOST_CHECK_EQUAL(2, directories[0].wd);
+    BOOST_REQUIRE_EQUAL(1u, heavyHitters.getFiles().size());
+
+    heavyHitters.clear();
+    BOOST_CHECK(heavyHitters.getDirectories().empty());
+    BOOST_CHECK_EQUAL(0u, heavyHitters.getEventCount());
+}
@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/MountTable.h>
+
+#include <sstream>
+#include <string>
+
+#include <sys/sysmacros.h>
+
+using namespace inotify;
+
+namespace {
+const std::string mountInfo
+    = "22 1 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n"
+      "23 22 0:5 / /proc rw,nosuid - proc proc rw\n"
+      "24 22 0:40 / /mnt/backup\\040volume rw shared:7 master:2 - nfs4 server:/backup rw\n"
+      "25 22 0:41 / /tmp rw - tmpfs tmpfs rw\n";
+
+MountTable parse()
+{
+    std::istringstream stream(mountInfo);
+    return MountTable::parse(stream);
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldParseMountsByDevice)
+{
+    auto mountTable = parse();
+
+    auto backup = mountTable.find(makedev(0, 40));
+    BOOST_REQUIRE(backup != nullptr);
+    BOOST_CHECK_EQUAL("/mnt/backup volume", backup->mountPoint.string());
+    BOOST_CHECK_EQUAL("nfs4", backup->type);
+    BOOST_CHECK_EQUAL("proc", mountTable.find(makedev(0, 5))->type);
+    BOOST_CHECK(mountTable.find(makedev(0, 99)) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(shouldAdmitMountsByOptions)
+{
+    auto mountTable = parse();
+    auto backup = makedev(0, 40);
+    auto tmp = makedev(0, 41);
+
+    BOOST_CHECK(mountTable.admits(backup, "/mnt/backup volume", MountOptions()));
+
+    MountOptions oneFileSystem;
+    oneFileSystem.oneFileSystem = true;
+    BOOST_CHECK(!mountTable.admits(tmp, "/tmp", oneFileSystem));
+
+    MountOptions excludeNetwork;
+    excludeNetwork.excludedTypes = { "nfs4", "cifs" };
+    BOOST_CHECK(!mountTable.admits(backup, "/mnt/backup volume", excludeNetwork));
+    BOOST_CHECK(mountTable.admits(tmp, "/tmp", excludeNetwork));
+
+    MountOptions onlyTmpfs;
+    onlyTmpfs.includedTypes = { "tmpfs" };
+    BOOST_CHECK(!mountTable.admits(backup, "/mnt/backup volume", onlyTmpfs));
+    BOOST_CHECK(mountTable.admits(tmp, "/tmp", onlyTmpfs));
+
+    // Excluded by the mount point, although the crawl reached it through a symlink
+    MountOptions excludePath;
+    excludePath.excludedPaths = { "/tmp" };
+    BOOST_CHECK(!mountTable.admits(tmp, "/home/user/scratch", excludePath));
+}
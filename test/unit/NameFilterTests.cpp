@@ -0,0 +1,33 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/NameFilter.h>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldAcceptAllNamesWithoutRules)
+{
+    NameFilter filter;
+    BOOST_CHECK(filter.empty());
+    BOOST_CHECK(filter.accepts("main.o"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldExcludeNames)
+{
+    auto filter = NameFilter().excludeExtension(".o").excludeGlob("*.sw?").excludeRegex("~.*");
+
+    BOOST_CHECK(filter.accepts("main.cpp"));
+    BOOST_CHECK(!filter.accepts("main.o"));
+    BOOST_CHECK(!filter.accepts(".main.cpp.swp"));
+    BOOST_CHECK(!filter.accepts("~lock"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldIncludeNamesOnly)
+{
+    auto filter = NameFilter().includeExtension(".conf").includeGlob("*.yaml").excludeGlob("old*");
+
+    BOOST_CHECK(filter.accepts("app.conf"));
+    BOOST_CHECK(filter.accepts("app.yaml"));
+    BOOST_CHECK(!filter.accepts("app.json"));
+    BOOST_CHECK(!filter.accepts("old.conf"));
+    BOOST_CHECK(filter.accepts(""));
+}
@@ -1,12 +1,20 @@
 #include <inotify-cpp/NotifierBuilder.h>
+#include <inotify-cpp/StaticNotifier.h>
 
 #include <boost/filesystem/fstream.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <set>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mount.h>
 
 using namespace inotify;
 
@@ -286,6 +294,59 @@ BOOST_FIXTURE_TEST_CASE(shouldNotTriggerEventsOnWatchRecursively, NotifierBuilde
     thread.join();
 }
 
+BOOST_FIXTURE_TEST_CASE(shouldCrawlSymlinkedDirectoriesOnce, NotifierBuilderTests)
+{
+    auto store = testDirectory_ / "store";
+    inotifypp::filesystem::create_directories(store / "shared");
+    inotifypp::filesystem::create_directory_symlink("store/shared", testDirectory_ / "release");
+    inotifypp::filesystem::create_directory_symlink("..", store / "shared" / "cycle");
+
+    auto paths = Inotify::collectWatchPaths(testDirectory_);
+    auto contains = [&](const inotifypp::filesystem::path& path) {
+        return std::find(paths.begin(), paths.end(), path) != paths.end();
+    };
+
+    BOOST_CHECK_EQUAL(6u, paths.size());
+    BOOST_CHECK(contains(store / "shared"));
+    BOOST_CHECK(contains(testDirectory_ / "release"));
+
+    paths = Inotify::collectWatchPaths(testDirectory_, SymlinkPolicy::first_path);
+    BOOST_CHECK_EQUAL(4u, paths.size());
+
+    paths = Inotify::collectWatchPaths(testDirectory_, SymlinkPolicy::skip);
+    BOOST_CHECK_EQUAL(4u, paths.size());
+    BOOST_CHECK(!contains(testDirectory_ / "release"));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyEveryPathOfSymlinkedDirectory, NotifierBuilderTests)
+{
+    auto shared = testDirectory_ / "store" / "shared";
+    inotifypp::filesystem::create_directories(shared);
+    inotifypp::filesystem::create_directory_symlink("store/shared", testDirectory_ / "release");
+
+    std::set<inotifypp::filesystem::path> paths;
+    std::promise<void> promisedPaths;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .onEvent(Event::create, [&](Notification notification) {
+                            paths.insert(notification.path);
+                            if (paths.size() == 2) {
+                                promisedPaths.set_value();
+                            }
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    createFile(shared / "created.txt");
+
+    BOOST_CHECK(promisedPaths.get_future().wait_for(timeout_) == std::future_status::ready);
+    notifier.stop();
+    thread.join();
+
+    BOOST_CHECK(paths.count(shared / "created.txt"));
+    BOOST_CHECK(paths.count(testDirectory_ / "release" / "created.txt"));
+}
+
 BOOST_FIXTURE_TEST_CASE(shouldWatchCreatedFile, NotifierBuilderTests)
 {
 
@@ -330,6 +391,65 @@ BOOST_FIXTURE_TEST_CASE(shouldUnwatchPath, NotifierBuilderTests)
     thread.join();
 }
 
+BOOST_FIXTURE_TEST_CASE(shouldReportStaleEventsOfRemovedWatch, NotifierBuilderTests)
+{
+    std::vector<StaleEvent> staleEvents;
+    auto notifier = BuildNotifier()
+                        .watchFile(testFile_)
+                        .watchPathRecursively(recursiveTestDirectory_)
+                        .onStaleEvent([&](StaleEvent staleEvent) {
+                            staleEvents.push_back(staleEvent);
+                        })
+                        .onEvent(Event::open, [](Notification) {})
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    // The records of the open are queued, but not read before the watch is removed
+    openFile(testFile_);
+    notifier.unwatchFile(testFile_);
+    createFile(recursiveTestDirectory_ / "created.txt");
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    notifier.stop();
+    thread.join();
+
+    BOOST_REQUIRE(!staleEvents.empty());
+    BOOST_CHECK(staleEvents[0].mask & IN_OPEN);
+    BOOST_CHECK(staleEvents[0].reason == StaleReason::removed);
+    BOOST_CHECK(staleEvents[0].generation > 0);
+    BOOST_CHECK_EQUAL(staleEvents.size(), notifier.getStaleEventCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWatchRecreatedFileBeforeIgnoredRecordIsRead, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedModify;
+    auto notifier = BuildNotifier().watchFile(testFile_).onEvent(
+        Event::modify, [&](Notification notification) {
+            promisedModify.set_value(notification);
+        });
+
+    // The IN_IGNORED record of the deleted file is still queued when it is watched again
+    inotifypp::filesystem::remove(testFile_);
+    createFile(testFile_);
+    notifier.watchFile(testFile_);
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    std::ofstream stream(testFile_.string(), std::ios::app);
+    stream << "appended";
+    stream.close();
+
+    auto futureModify = promisedModify.get_future();
+    BOOST_REQUIRE(futureModify.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(futureModify.get().path, testFile_);
+    notifier.stop();
+    thread.join();
+}
+
 BOOST_FIXTURE_TEST_CASE(shouldCallUserDefinedUnexpectedExceptionObserver, NotifierBuilderTests)
 {
     std::promise<void> observerCalled;
@@ -396,3 +516,870 @@ BOOST_FIXTURE_TEST_CASE(shouldNotAppendSlashOnWatchingFiles, NotifierBuilderTest
     notifier.stop();
     thread.join();
 }
+
+BOOST_FIXTURE_TEST_CASE(shouldCalculateStaticEventMaskAtCompileTime, NotifierBuilderTests)
+{
+    auto handler = [](const Notification&) {};
+    using OpenAndCreate = decltype(BuildStaticNotifier(
+        on<Event::open>(handler), on<Event::create | Event::is_dir>(handler)));
+    using IsDirOnly = decltype(BuildStaticNotifier(on<Event::is_dir>(handler)));
+    using UnmountOnly = decltype(BuildStaticNotifier(on<Event::unmount>(handler)));
+
+    static_assert(OpenAndCreate::eventMask == (IN_OPEN | IN_CREATE), "mask of handled events");
+    static_assert(IsDirOnly::eventMask == IN_ALL_EVENTS, "flag only handlers need all events");
+    static_assert(UnmountOnly::eventMask == IN_DELETE_SELF, "unmount needs an installed watch");
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldInstallWatchesForUnmountOnlyObserver, NotifierBuilderTests)
+{
+    auto mountPoint = testDirectory_ / "mountPoint";
+    inotifypp::filesystem::create_directories(mountPoint);
+    if (mount("tmpfs", mountPoint.c_str(), "tmpfs", 0, nullptr) == -1) {
+        BOOST_TEST_MESSAGE("Mounting a tmpfs needs privileges, test skipped");
+        return;
+    }
+
+    std::promise<Notification> promisedUnmount;
+    auto notifier = BuildNotifier()
+                        .onEvent(
+                            Event::unmount | Event::is_dir,
+                            [&](Notification notification) {
+                                promisedUnmount.set_value(notification);
+                            })
+                        .watchFile(mountPoint);
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    BOOST_REQUIRE_EQUAL(0, umount(mountPoint.c_str()));
+
+    auto future = promisedUnmount.get_future();
+    BOOST_CHECK(future.wait_for(timeout_) == std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyStaticHandlerOnOpenEvent, NotifierBuilderTests)
+{
+    auto notifier = BuildStaticNotifier(
+        on<Event::close_nowrite>(
+            [&](const Notification& notification) { promisedCloseNoWrite_.set_value(notification); }),
+        on<Event::open>(
+            [&](const Notification& notification) { promisedOpen_.set_value(notification); }));
+    notifier.watchFile(testFile_);
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    openFile(testFile_);
+
+    auto futureOpen = promisedOpen_.get_future();
+    auto futureCloseNoWrite = promisedCloseNoWrite_.get_future();
+    BOOST_CHECK(futureOpen.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureOpen.get().path == testFile_);
+    BOOST_CHECK(futureCloseNoWrite.wait_for(timeout_) == std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldCallStaticUnexpectedEventObserver, NotifierBuilderTests)
+{
+    std::promise<void> observerCalled;
+
+    auto notifier = BuildStaticNotifier(on<Event::create>([](const Notification&) {}));
+    notifier.watchFile(testFile_).onUnexpectedEvent(
+        [&](Notification) { observerCalled.set_value(); });
+
+    std::thread thread([&notifier]() { notifier.runOnce(); });
+
+    openFile(testFile_);
+
+    BOOST_CHECK(observerCalled.get_future().wait_for(timeout_) == std::future_status::ready);
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldInstallOnlyObservedEventsInWatchMask, NotifierBuilderTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testFile_);
+    inotify.watchFile(recursiveTestFile_, IN_OPEN | IN_MODIFY);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_ALL_EVENTS), inotify.getWatchMask(testFile_));
+
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_WRITE);
+    inotify.updateWatchMasks();
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_OPEN | IN_CLOSE_WRITE), inotify.getWatchMask(testFile_));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_OPEN), inotify.getWatchMask(recursiveTestFile_));
+
+    inotify.ignoreFile(testFile_);
+    inotify.updateWatchMasks();
+    BOOST_CHECK_EQUAL(0u, inotify.getWatchMask(testFile_));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReportRemovedWatches, NotifierBuilderTests)
+{
+    std::vector<int> removedWatches;
+    Inotify inotify;
+    inotify.onWatchRemoved([&removedWatches](int wd) { removedWatches.push_back(wd); });
+    inotify.watchFile(testFile_);
+    inotify.watchFile(recursiveTestFile_);
+
+    inotify.unwatchFile(testFile_);
+
+    BOOST_CHECK_EQUAL(1u, removedWatches.size());
+    BOOST_CHECK(inotify.getWatchPath(removedWatches.front()).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepAliasMasksInSharedWatch, NotifierBuilderTests)
+{
+    auto link = testDirectory_ / "link.txt";
+    inotifypp::filesystem::create_symlink("test.txt", link);
+
+    Inotify inotify;
+    inotify.watchFile(testFile_, IN_OPEN);
+    inotify.watchFile(link, IN_MODIFY);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_OPEN | IN_MODIFY), inotify.getWatchMask(testFile_));
+
+    inotify.setEventMask(IN_OPEN | IN_MODIFY | IN_CLOSE_WRITE);
+    inotify.updateWatchMasks();
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_OPEN | IN_MODIFY), inotify.getWatchMask(testFile_));
+
+    // The parked watch is installed again with the mask of its alias
+    inotify.setEventMask(IN_CLOSE_WRITE);
+    inotify.updateWatchMasks();
+    BOOST_CHECK_EQUAL(0u, inotify.getWatchMask(testFile_));
+
+    inotify.setEventMask(IN_OPEN | IN_MODIFY);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_OPEN | IN_MODIFY), inotify.getWatchMask(testFile_));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldFollowReplacedFileOnMaskUpdate, NotifierBuilderTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testFile_);
+    inotify.setEventMask(IN_OPEN);
+    inotify.updateWatchMasks();
+
+    // The path gets another inode, which the kernel watches with a new descriptor
+    auto replacement = testDirectory_ / "replacement.txt";
+    createFile(replacement);
+    inotifypp::filesystem::rename(replacement, testFile_);
+    inotify.setEventMask(IN_ALL_EVENTS);
+
+    auto futureEvent = std::async(std::launch::async, [&inotify]() { return inotify.getNextEvent(); });
+
+    openFile(testFile_);
+
+    auto status = futureEvent.wait_for(timeout_);
+    inotify.stop();
+    BOOST_REQUIRE(status == std::future_status::ready);
+    auto event = futureEvent.get();
+    BOOST_REQUIRE(event);
+    BOOST_CHECK_EQUAL(event->path, testFile_);
+    BOOST_CHECK(event->mask & IN_OPEN);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWidenWatchMaskForLateObservers, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier().onEvent(Event::create, [](Notification) {}).watchFile(testFile_);
+    notifier.onEvent(
+        Event::open, [&](Notification notification) { promisedOpen_.set_value(notification); });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    openFile(testFile_);
+
+    BOOST_CHECK(promisedOpen_.get_future().wait_for(timeout_) == std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRouteEventsToSubtreeObservers, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedOtherSubtree;
+    auto otherSubtree = testDirectory_ / "otherSubtree";
+    inotifypp::filesystem::create_directories(otherSubtree);
+
+    auto notifier = BuildNotifier()
+                        .onEvent(
+                            recursiveTestDirectory_,
+                            Event::open,
+                            [&](Notification notification) {
+                                promisedOpen_.set_value(notification);
+                            })
+                        .onEvent(
+                            otherSubtree,
+                            Event::open,
+                            [&](Notification notification) {
+                                promisedOtherSubtree.set_value(notification);
+                            })
+                        .watchPathRecursively(testDirectory_);
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    openFile(recursiveTestFile_);
+
+    auto futureOpen = promisedOpen_.get_future();
+    BOOST_CHECK(futureOpen.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureOpen.get().path == recursiveTestFile_);
+    BOOST_CHECK(
+        promisedOtherSubtree.get_future().wait_for(std::chrono::milliseconds { 100 })
+        != std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldFilterEventsByName, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .setNameFilter(NameFilter().excludeExtension(".tmp"))
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    createFile(testDirectory_ / "ignored.tmp");
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_CHECK(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureCreate.get().path == createdFile_);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotFilterCreatedDirectoriesByName, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedDirectory;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .setNameFilter(NameFilter().includeExtension(".log"))
+                        .onEvent(Event::create | Event::is_dir, [&](Notification notification) {
+                            promisedDirectory.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    inotifypp::filesystem::create_directory(testDirectory_ / "logs");
+
+    auto futureDirectory = promisedDirectory.get_future();
+    BOOST_CHECK(futureDirectory.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureDirectory.get().path == testDirectory_ / "logs");
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyOnLostEvents, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedLost;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .setEventQueueCapacity(1, QueueOverflowPolicy::drop_newest)
+                        .onEvent(Event::create, [](Notification) {})
+                        .onEvent(Event::q_overflow, [&](Notification notification) {
+                            promisedLost.set_value(notification);
+                        });
+
+    for (auto i = 0; i < 10; ++i) {
+        createFile(testDirectory_ / ("burst" + std::to_string(i)));
+    }
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    auto futureLost = promisedLost.get_future();
+    BOOST_CHECK(futureLost.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureLost.get().path.empty());
+
+    notifier.stop();
+    thread.join();
+    BOOST_CHECK(notifier.getEventQueueStatistics().droppedNewestEvents > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReadEventBatch, NotifierBuilderTests)
+{
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE);
+    inotify.watchDirectoryRecursively(testDirectory_);
+
+    createFile(createdFile_);
+
+    EventBatch batch;
+    BOOST_REQUIRE_EQUAL(1u, inotify.readEventBatch(batch));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_CREATE), batch.masks[0]);
+    BOOST_CHECK_EQUAL(createdFile_.filename().string(), batch.name(0));
+    BOOST_CHECK(inotify.getWatchPath(batch.wds[0]) == testDirectory_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReceiveEventsFromSharedEventBus, NotifierBuilderTests)
+{
+    auto publisher = std::make_shared<SharedEventPublisher>();
+    auto subscriber = std::make_shared<SharedEventSubscriber>(publisher->getPath());
+
+    auto publishingNotifier = BuildNotifier().watchFile(testFile_).publishTo(publisher);
+    auto subscribingNotifier = BuildNotifier(subscriber).onEvent(
+        Event::open, [&](Notification notification) { promisedOpen_.set_value(notification); });
+
+    std::thread publishingThread([&publishingNotifier]() { publishingNotifier.run(); });
+    std::thread subscribingThread([&subscribingNotifier]() { subscribingNotifier.run(); });
+
+    openFile(testFile_);
+
+    auto futureOpen = promisedOpen_.get_future();
+    BOOST_CHECK(futureOpen.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureOpen.get().path == testFile_);
+
+    publishingNotifier.stop();
+    subscribingNotifier.stop();
+    publishingThread.join();
+    subscribingThread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldPublishEventsNoLocalObserverWants, NotifierBuilderTests)
+{
+    auto publisher = std::make_shared<SharedEventPublisher>();
+    auto subscriber = std::make_shared<SharedEventSubscriber>(publisher->getPath());
+
+    std::promise<EventSummary> promisedSummary;
+    AggregationOptions options;
+    options.events = Event::open;
+    options.window = std::chrono::milliseconds(10);
+
+    auto publishingNotifier = BuildNotifier()
+                                  .watchFile(testFile_)
+                                  .onEvent(Event::close_write, [](Notification) {})
+                                  .publishTo(publisher);
+    auto subscribingNotifier = BuildNotifier(subscriber).aggregateEvents(
+        options, [&](EventSummary summary) { promisedSummary.set_value(summary); });
+    BOOST_CHECK_THROW(subscribingNotifier.watchFile(testFile_), std::runtime_error);
+
+    std::thread publishingThread([&publishingNotifier]() { publishingNotifier.run(); });
+    std::thread subscribingThread([&subscribingNotifier]() { subscribingNotifier.run(); });
+
+    openFile(testFile_);
+
+    auto futureSummary = promisedSummary.get_future();
+    BOOST_REQUIRE(futureSummary.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(futureSummary.get().directory, testDirectory_);
+
+    publishingNotifier.stop();
+    subscribingNotifier.stop();
+    publishingThread.join();
+    subscribingThread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyOnContentChangeOnly, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedChanged;
+    std::promise<Notification> promisedUnchanged;
+    auto notifier = BuildNotifier().watchFile(testFile_).onContentChange(
+        [&](Notification notification) { promisedChanged.set_value(notification); },
+        [&](Notification notification) { promisedUnchanged.set_value(notification); });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    {
+        std::ofstream stream(testFile_.string());
+        stream << "content";
+    }
+    auto futureChanged = promisedChanged.get_future();
+    BOOST_CHECK(futureChanged.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureChanged.get().path == testFile_);
+
+    {
+        std::ofstream stream(testFile_.string());
+        stream << "content";
+    }
+    auto futureUnchanged = promisedUnchanged.get_future();
+    BOOST_CHECK(futureUnchanged.wait_for(timeout_) == std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+    BOOST_CHECK_EQUAL(2u, notifier.getContentHashStatistics().hashedFiles);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldAggregateEventsPerDirectory, NotifierBuilderTests)
+{
+    std::promise<EventSummary> promisedSummary;
+    std::atomic<bool> summarized { false };
+    AggregationOptions options;
+    options.roots = { testDirectory_ };
+    options.depth = 0;
+    options.window = std::chrono::milliseconds(100);
+    options.events = Event::create;
+
+    auto notifier = BuildNotifier().watchPathRecursively(testDirectory_).aggregateEvents(
+        options, [&](EventSummary summary) {
+            if (!summarized.exchange(true)) {
+                promisedSummary.set_value(summary);
+            }
+        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    createFile(createdFile_);
+    createFile(recursiveTestDirectory_ / "created.txt");
+
+    auto futureSummary = promisedSummary.get_future();
+    BOOST_REQUIRE(futureSummary.wait_for(timeout_) == std::future_status::ready);
+    auto summary = futureSummary.get();
+    BOOST_CHECK(summary.directory == testDirectory_);
+    BOOST_CHECK(summary.events == Event::create);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWatchFileWhileEventLoopRuns, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier().watchFile(testFile_).onEvent(
+        Event::open, [&](Notification notification) {
+            if (notification.path == recursiveTestFile_) {
+                promisedOpen_.set_value(notification);
+            }
+        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+
+    for (auto i = 0; i < 100; ++i) {
+        auto directory = recursiveTestDirectory_ / ("live" + std::to_string(i));
+        inotifypp::filesystem::create_directories(directory);
+        notifier.watchPathRecursively(directory);
+        openFile(testFile_);
+    }
+    notifier.watchFile(recursiveTestFile_);
+    BOOST_CHECK_THROW(notifier.watchFile("/not/existing/file"), std::invalid_argument);
+
+    openFile(recursiveTestFile_);
+
+    auto futureOpen = promisedOpen_.get_future();
+    BOOST_CHECK(futureOpen.wait_for(timeout_) == std::future_status::ready);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyOnceWhenFileSettled, NotifierBuilderTests)
+{
+    std::promise<Notification> promisedSettled;
+    std::atomic<int> settledFiles { 0 };
+    auto notifier = BuildNotifier().watchPathRecursively(testDirectory_).onFileSettled(
+        std::chrono::milliseconds { 100 }, [&](Notification notification) {
+            if (settledFiles++ == 0) {
+                promisedSettled.set_value(notification);
+            }
+        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    for (auto i = 0; i < 3; ++i) {
+        std::ofstream stream(createdFile_.string(), std::ofstream::app);
+        stream << "chunk" << i;
+    }
+
+    auto futureSettled = promisedSettled.get_future();
+    BOOST_CHECK(futureSettled.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureSettled.get().path == createdFile_);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds { 200 });
+    BOOST_CHECK_EQUAL(1, settledFiles);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchPriorityLaneFirst, NotifierBuilderTests)
+{
+    std::atomic<bool> created { false };
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .setPriorityLane(recursiveTestDirectory_, 1)
+                        .onEvent(Event::create, [&](Notification notification) {
+                            if (!created.exchange(true)) {
+                                promisedCreate_.set_value(notification);
+                            }
+                        });
+
+    for (auto i = 0; i < 100; ++i) {
+        createFile(testDirectory_ / ("flood" + std::to_string(i)));
+    }
+    createFile(recursiveTestDirectory_ / "critical");
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureCreate.get().path == recursiveTestDirectory_ / "critical");
+
+    notifier.stop();
+    thread.join();
+
+    auto statistics = notifier.getLaneStatistics();
+    BOOST_REQUIRE_EQUAL(2u, statistics.size());
+    BOOST_CHECK_EQUAL(1u, statistics[0].priority);
+    BOOST_CHECK(statistics[0].dispatchedEvents > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldIgnoreHotDirectory, NotifierBuilderTests)
+{
+    HeavyHittersOptions options;
+    options.hotShare = 0.5;
+    options.checkInterval = 20;
+    options.action = HotPathAction::ignore;
+
+    std::promise<HotPath> promisedHotPath;
+    std::atomic<bool> reported { false };
+    std::atomic<bool> lateCreated { false };
+    std::atomic<bool> siblingCreated { false };
+    auto sibling = testDirectory_ / "recursiveTestDirectory2";
+    inotifypp::filesystem::create_directories(sibling);
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .onEvent(Event::create,
+                                 [&](Notification notification) {
+                                     if (notification.path == recursiveTestDirectory_ / "late") {
+                                         lateCreated = true;
+                                     }
+                                     if (notification.path == sibling / "late") {
+                                         siblingCreated = true;
+                                     }
+                                     if (notification.path == createdFile_) {
+                                         promisedCreate_.set_value(notification);
+                                     }
+                                 })
+                        .trackHotPaths(options, [&](HotPath hotPath) {
+                            if (!reported.exchange(true)) {
+                                promisedHotPath.set_value(hotPath);
+                            }
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    for (auto i = 0; i < 20; ++i) {
+        createFile(recursiveTestDirectory_ / ("flood" + std::to_string(i)));
+    }
+
+    auto futureHotPath = promisedHotPath.get_future();
+    BOOST_REQUIRE(futureHotPath.wait_for(timeout_) == std::future_status::ready);
+    auto hotPath = futureHotPath.get();
+    BOOST_CHECK(hotPath.path == recursiveTestDirectory_);
+    BOOST_CHECK(hotPath.share >= 0.5);
+
+    // A sibling that shares the prefix of the hot directory is not ignored
+    createFile(recursiveTestDirectory_ / "late");
+    createFile(sibling / "late");
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_CHECK(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(!lateCreated);
+    BOOST_CHECK(siblingCreated);
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReportHotDirectories, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .onEvent(Event::create,
+                                 [&](Notification notification) {
+                                     if (notification.path == createdFile_) {
+                                         promisedCreate_.set_value(notification);
+                                     }
+                                 })
+                        .trackHotPaths();
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    for (auto i = 0; i < 10; ++i) {
+        createFile(recursiveTestDirectory_ / ("flood" + std::to_string(i)));
+    }
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+
+    auto hotDirectories = notifier.getHotDirectories();
+    BOOST_REQUIRE_EQUAL(2u, hotDirectories.size());
+    BOOST_CHECK(hotDirectories[0].path == recursiveTestDirectory_);
+    BOOST_CHECK(hotDirectories[0].count >= 10u);
+    BOOST_CHECK(hotDirectories[1].path == testDirectory_);
+    BOOST_CHECK(!notifier.getHotFiles().empty());
+
+    notifier.stop();
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldJournalEventsNoObserverWants, NotifierBuilderTests)
+{
+    JournalOptions options;
+    options.directory = testDirectory_ / "journal";
+    options.durability = JournalDurability::none;
+    auto journal = std::make_shared<EventJournalWriter>(options);
+
+    std::promise<Notification> promisedCloseWrite;
+    auto notifier = BuildNotifier()
+                        .watchFile(testFile_)
+                        .journalTo(journal)
+                        .onEvent(Event::close_write, [&](Notification notification) {
+                            promisedCloseWrite.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    std::ofstream(testFile_.string()) << "written";
+
+    BOOST_CHECK(
+        promisedCloseWrite.get_future().wait_for(timeout_) == std::future_status::ready);
+    notifier.stop();
+    thread.join();
+    journal->flush();
+
+    EventJournalReader reader(options.directory);
+    JournalEntry entry;
+    std::uint32_t journaledEvents = 0;
+    while (reader.next(entry)) {
+        journaledEvents |= entry.mask;
+    }
+    BOOST_CHECK(journaledEvents & IN_OPEN);
+    BOOST_CHECK(journaledEvents & IN_MODIFY);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepHistoryOfDispatchedEvents, NotifierBuilderTests)
+{
+    auto history = std::make_shared<EventHistory>();
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .keepHistory(history)
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.runOnce(); });
+
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    thread.join();
+
+    std::vector<HistoryEntry> entries;
+    BOOST_CHECK(history->read(0, 10, entries) == HistoryStatus::ok);
+    BOOST_REQUIRE_EQUAL(1u, entries.size());
+    BOOST_CHECK_EQUAL(1u, entries[0].sequence);
+    BOOST_CHECK(entries[0].event == Event::create);
+    BOOST_CHECK(entries[0].path == createdFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyWhileBusyPolling, NotifierBuilderTests)
+{
+    BusyPollOptions options;
+    options.cpu = sched_getcpu();
+    options.idleThreshold = std::chrono::milliseconds(50);
+
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .enableBusyPolling(options)
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.runOnce(); });
+
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureCreate.get().path == createdFile_);
+    thread.join();
+
+    auto statistics = notifier.getBusyPollStatistics();
+    BOOST_CHECK(statistics.spinReads + statistics.epollReads > 0);
+    BOOST_CHECK(statistics.pinned);
+    BOOST_CHECK(statistics.spinTime.count() > 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRestoreAffinityOfReaderThread, NotifierBuilderTests)
+{
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE);
+    inotify.watchDirectoryRecursively(testDirectory_);
+
+    BusyPollOptions options;
+    options.cpu = sched_getcpu();
+    inotify.enableBusyPolling(options);
+
+    bool pinned = false;
+    bool restored = false;
+    std::thread thread([&]() {
+        cpu_set_t before;
+        cpu_set_t after;
+        pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+
+        createFile(createdFile_);
+        pinned = inotify.getNextEvent() && inotify.getBusyPollStatistics().pinned;
+        inotify.disableBusyPolling();
+
+        pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+        restored = CPU_EQUAL(&before, &after);
+    });
+    thread.join();
+
+    BOOST_CHECK(pinned);
+    BOOST_CHECK(restored);
+    BOOST_CHECK(!inotify.getBusyPollStatistics().pinned);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReadBurstLargerThanReadBuffer, NotifierBuilderTests)
+{
+    ReadBufferOptions options;
+    options.maximumSize = 4096;
+
+    const std::size_t files = 100;
+    std::atomic<std::size_t> created { 0 };
+    std::promise<void> promisedAll;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(recursiveTestDirectory_)
+                        .setReadBufferOptions(options)
+                        .onEvent(Event::create, [&](Notification) {
+                            if (++created == files) {
+                                promisedAll.set_value();
+                            }
+                        });
+
+    // Queued before the loop runs, so a single wakeup has to read them all
+    for (std::size_t i = 0; i < files; ++i) {
+        createFile(recursiveTestDirectory_ / (std::string(200, 'f') + std::to_string(i)));
+    }
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    BOOST_CHECK(promisedAll.get_future().wait_for(timeout_) == std::future_status::ready);
+    notifier.stop();
+    thread.join();
+
+    auto statistics = notifier.getReadBufferStatistics();
+    BOOST_CHECK_EQUAL(4096u, statistics.size);
+    BOOST_CHECK(statistics.truncatedReads > 0);
+    BOOST_CHECK(statistics.largestBurst > 4096);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDeliverSampledOpenEventsWithCount, NotifierBuilderTests)
+{
+    SamplingOptions options;
+    options.rate = 5;
+
+    std::vector<std::uint32_t> openCounts;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .sampleEvents(options)
+                        .onEvent(Event::open,
+                                 [&](Notification notification) {
+                                     if (notification.path == testFile_) {
+                                         openCounts.push_back(notification.count);
+                                     }
+                                 })
+                        // Interleaved closes keep the kernel from coalescing the opens
+                        .onEvent(Event::close_nowrite, [](Notification) {})
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    for (auto i = 0; i < 10; ++i) {
+        openFile(testFile_);
+    }
+    createFile(createdFile_);
+
+    auto futureCreate = promisedCreate_.get_future();
+    BOOST_REQUIRE(futureCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(1u, futureCreate.get().count);
+
+    notifier.stop();
+    thread.join();
+
+    BOOST_CHECK(!openCounts.empty());
+    for (auto count : openCounts) {
+        BOOST_CHECK_EQUAL(5u, count);
+    }
+    BOOST_CHECK(notifier.getSamplingStatistics().sampledEvents > 0);
+}
+
+BOOST_AUTO_TEST_CASE(shouldReportOverwrittenEventsOfSharedEventBus)
+{
+    SharedEventPublisher publisher(4);
+    SharedEventSubscriber subscriber(publisher.getFd());
+
+    for (auto i = 0; i < 10; ++i) {
+        publisher.publish(FileSystemEvent(
+            1, IN_MODIFY, "file" + std::to_string(i), std::chrono::steady_clock::now()));
+    }
+
+    auto lost = subscriber.getNextEvent();
+    BOOST_REQUIRE(lost);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_Q_OVERFLOW), lost->mask);
+    BOOST_CHECK(subscriber.getLostEventCount() >= 6u);
+
+    auto event = subscriber.getNextEvent();
+    BOOST_REQUIRE(event);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), event->mask);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDeliverPendingSampleCountsOnStop, NotifierBuilderTests)
+{
+    SamplingOptions options;
+    options.rate = 10;
+
+    std::vector<std::uint32_t> openCounts;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .sampleEvents(options)
+                        .onEvent(Event::open,
+                                 [&](Notification notification) {
+                                     if (notification.path == testFile_) {
+                                         openCounts.push_back(notification.count);
+                                     }
+                                 })
+                        .onEvent(Event::close_nowrite, [](Notification) {})
+                        .onEvent(Event::create, [&](Notification notification) {
+                            promisedCreate_.set_value(notification);
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    for (auto i = 0; i < 3; ++i) {
+        openFile(testFile_);
+    }
+    createFile(createdFile_);
+
+    BOOST_REQUIRE(promisedCreate_.get_future().wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(openCounts.empty());
+
+    notifier.stop();
+    thread.join();
+
+    BOOST_REQUIRE_EQUAL(1u, openCounts.size());
+    BOOST_CHECK_EQUAL(3u, openCounts[0]);
+}
+
+BOOST_AUTO_TEST_CASE(shouldCarryCountOverSharedEventBus)
+{
+    SharedEventPublisher publisher;
+    SharedEventSubscriber subscriber(publisher.getPath());
+
+    FileSystemEvent event(1, IN_OPEN, 0, "sampled", std::chrono::steady_clock::now());
+    event.count = 7;
+    publisher.publish(event);
+
+    auto received = subscriber.getNextEvent();
+    BOOST_REQUIRE(received);
+    BOOST_CHECK_EQUAL(7u, received->count);
+}
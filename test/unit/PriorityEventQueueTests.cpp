@@ -0,0 +1,111 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/PriorityEventQueue.h>
+
+#include <chrono>
+#include <string>
+
+#include <sys/inotify.h>
+
+using namespace inotify;
+
+namespace {
+FileSystemEvent makeEvent(int wd, const char* path)
+{
+    return FileSystemEvent(wd, IN_MODIFY, path, std::chrono::steady_clock::now());
+}
+
+std::string popPath(PriorityEventQueue& queue)
+{
+    auto path = queue.front().path.string();
+    queue.pop();
+    return path;
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldDrainHigherLanesFirst)
+{
+    PriorityEventQueue queue;
+    queue.addLane("config", 2, 1);
+    queue.addLane("logs/important.log", 1, 1);
+
+    queue.push(makeEvent(1, "logs/a.log"));
+    queue.push(makeEvent(1, "logs/important.log"));
+    queue.push(makeEvent(2, "config/app.conf"));
+    queue.push(makeEvent(1, "logs/b.log"));
+
+    BOOST_CHECK_EQUAL(4u, queue.size());
+    BOOST_CHECK_EQUAL("config/app.conf", popPath(queue));
+    BOOST_CHECK_EQUAL("logs/important.log", popPath(queue));
+    BOOST_CHECK_EQUAL("logs/a.log", popPath(queue));
+    BOOST_CHECK_EQUAL("logs/b.log", popPath(queue));
+    BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(shouldShareDispatchesByWeight)
+{
+    PriorityEventQueue queue;
+    queue.addLane("config", 1, 2);
+    queue.setScheduling(LaneScheduling::weighted);
+
+    for (auto i = 0; i < 4; ++i) {
+        queue.push(makeEvent(1, "config/file"));
+        queue.push(makeEvent(2, "logs/file"));
+    }
+
+    std::string order;
+    while (!queue.empty()) {
+        order += popPath(queue)[0];
+    }
+    BOOST_CHECK_EQUAL("cclcclll", order);
+}
+
+BOOST_AUTO_TEST_CASE(shouldReportLaneStatistics)
+{
+    PriorityEventQueue queue;
+    queue.addLane("config", 1, 1);
+    queue.setCapacity(1, QueueOverflowPolicy::drop_oldest);
+
+    queue.push(makeEvent(1, "logs/a"));
+    BOOST_CHECK(!queue.push(makeEvent(1, "logs/b")));
+    queue.push(makeEvent(2, "config/a"));
+    queue.front();
+    queue.pop();
+
+    auto statistics = queue.getLaneStatistics();
+    BOOST_REQUIRE_EQUAL(2u, statistics.size());
+    BOOST_CHECK_EQUAL(1u, statistics[0].priority);
+    BOOST_CHECK_EQUAL(0u, statistics[0].depth);
+    BOOST_CHECK_EQUAL(1u, statistics[0].dispatchedEvents);
+    BOOST_CHECK_EQUAL(0u, statistics[1].priority);
+    BOOST_CHECK_EQUAL(1u, statistics[1].depth);
+    BOOST_CHECK_EQUAL(1u, statistics[1].queue.droppedOldestEvents);
+    BOOST_CHECK_EQUAL(1u, queue.getStatistics().droppedOldestEvents);
+}
+
+BOOST_AUTO_TEST_CASE(shouldBlockOnlyOnRecordsOfFullLane)
+{
+    PriorityEventQueue queue;
+    queue.addLane("config", 1, 1);
+    queue.setCapacity(2, QueueOverflowPolicy::block);
+    BOOST_CHECK(queue.blocksPerLane());
+
+    queue.push(makeEvent(1, "logs/a"));
+    BOOST_CHECK(queue.reserve(1, "logs/b"));
+    BOOST_CHECK(!queue.reserve(1, "logs/c"));
+    BOOST_CHECK(queue.reserve(2, "config/a"));
+    BOOST_CHECK(queue.reserve(2, "config/b"));
+    BOOST_CHECK(!queue.reserve(2, "config/c"));
+    queue.countBlockedRead();
+
+    queue.clearReservations();
+    queue.push(makeEvent(1, "logs/b"));
+    BOOST_CHECK(!queue.reserve(1, "logs/c"));
+    BOOST_CHECK(queue.reserve(2, "config/a"));
+    queue.countBlockedRead();
+
+    auto statistics = queue.getLaneStatistics();
+    BOOST_REQUIRE_EQUAL(2u, statistics.size());
+    BOOST_CHECK_EQUAL(1u, statistics[0].queue.blockedReads);
+    BOOST_CHECK_EQUAL(1u, statistics[1].queue.blockedReads);
+}
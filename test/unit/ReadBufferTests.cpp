@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/ReadBuffer.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldGrowToPendingBytesWithinBounds)
+{
+    ReadBufferOptions options;
+    options.minimumSize = 4096;
+    options.maximumSize = 64 * 1024;
+    ReadBuffer buffer(options);
+    BOOST_CHECK_EQUAL(4096u, buffer.size());
+
+    buffer.reserve(5000);
+    BOOST_CHECK_EQUAL(8192u, buffer.size());
+
+    buffer.reserve(1000 * 1000);
+    buffer.countRead(1000 * 1000);
+    BOOST_CHECK_EQUAL(64u * 1024, buffer.size());
+
+    auto statistics = buffer.getStatistics();
+    BOOST_CHECK_EQUAL(2u, statistics.grows);
+    BOOST_CHECK_EQUAL(1u, statistics.truncatedReads);
+    BOOST_CHECK_EQUAL(1000u * 1000, statistics.largestBurst);
+}
+
+BOOST_AUTO_TEST_CASE(shouldShrinkToLargestBurstOfPeriod)
+{
+    ReadBufferOptions options;
+    options.idleTimeout = std::chrono::milliseconds(10);
+    ReadBuffer buffer(options);
+
+    buffer.reserve(60 * 1024);
+    BOOST_CHECK_EQUAL(64u * 1024, buffer.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // The period with the burst is over, the next one starts with this read
+    buffer.reserve(10 * 1024);
+    BOOST_CHECK_EQUAL(64u * 1024, buffer.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    buffer.reserve(100);
+    BOOST_CHECK_EQUAL(16u * 1024, buffer.size());
+    BOOST_CHECK(buffer.isReleasable());
+
+    buffer.release();
+    BOOST_CHECK_EQUAL(4096u, buffer.size());
+    BOOST_CHECK(!buffer.isReleasable());
+    BOOST_CHECK_EQUAL(2u, buffer.getStatistics().shrinks);
+}
+
+BOOST_AUTO_TEST_CASE(shouldShareIdleBuffersThroughPool)
+{
+    ReadBufferOptions options;
+    options.pool = std::make_shared<ReadBufferPool>();
+
+    ReadBuffer first(options);
+    first.release();
+    BOOST_CHECK_EQUAL(0u, first.size());
+    BOOST_CHECK_EQUAL(4096u, options.pool->getRetainedBytes());
+
+    ReadBuffer second(options);
+    BOOST_CHECK_EQUAL(4096u, second.size());
+    BOOST_CHECK_EQUAL(0u, options.pool->getRetainedBytes());
+
+    first.reserve(100);
+    BOOST_CHECK_EQUAL(4096u, first.size());
+}
@@ -0,0 +1,94 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/SubtreeRouter.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldRouteOnlyToEnclosingSubtrees)
+{
+    SubtreeRouter router;
+    int rootCalls = 0;
+    int teamCalls = 0;
+    int otherCalls = 0;
+
+    router.subscribe("/srv", Event::all, [&](Notification) { ++rootCalls; });
+    router.subscribe("/srv/team", Event::modify, [&](Notification) { ++teamCalls; });
+    router.subscribe("/srv/other", Event::modify, [&](Notification) { ++otherCalls; });
+
+    auto now = std::chrono::steady_clock::now();
+    BOOST_CHECK(router.route(1, Notification { Event::modify, "/srv/team/a.txt", now }));
+    BOOST_CHECK(router.route(1, Notification { Event::modify, "/srv/team/b.txt", now }));
+    BOOST_CHECK(router.route(2, Notification { Event::open, "/srv/other/c.txt", now }));
+    BOOST_CHECK(!router.route(3, Notification { Event::modify, "/var/log/d.txt", now }));
+
+    BOOST_CHECK_EQUAL(3, rootCalls);
+    BOOST_CHECK_EQUAL(2, teamCalls);
+    BOOST_CHECK_EQUAL(0, otherCalls);
+}
+
+BOOST_AUTO_TEST_CASE(shouldCalculateEventMaskOfSubtree)
+{
+    SubtreeRouter router;
+    router.subscribe("/srv/team", Event::modify, [](Notification) {});
+    router.subscribe("/srv/team/deep/deeper", Event::create, [](Notification) {});
+
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), router.eventMaskFor("/srv/team"));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), router.eventMaskFor("/srv/team/x/y"));
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_MODIFY | IN_CREATE), router.eventMaskFor("/srv/team/deep"));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), router.eventMaskFor("/srv"));
+    BOOST_CHECK_EQUAL(0u, router.eventMaskFor("/"));
+    BOOST_CHECK_EQUAL(0u, router.eventMaskFor("/var"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldNotWidenEventMaskForOverflowObserver)
+{
+    SubtreeRouter router;
+    router.subscribe("/srv/team", Event::modify, [](Notification) {});
+    router.subscribe("/srv/team", Event::q_overflow, [](Notification) {});
+
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), router.eventMaskFor("/srv/team"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldKeepWatchesOfUnmountObserverInstalled)
+{
+    SubtreeRouter router;
+    router.subscribe("/srv/team", Event::unmount, [](Notification) {});
+
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_DELETE_SELF), router.eventMaskFor("/srv/team"));
+    BOOST_CHECK_EQUAL(0u, router.eventMaskFor("/var"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldSubscribeWhileRouting)
+{
+    SubtreeRouter router;
+    std::atomic<int> calls { 0 };
+    router.subscribe("/srv", Event::modify, [&](Notification) {
+        // Observers may subscribe further observers
+        router.subscribe("/srv/nested", Event::modify, [](Notification) {});
+        ++calls;
+    });
+
+    std::thread subscriber([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            auto subtree = "/srv/team" + std::to_string(i % 10);
+            router.subscribe(subtree, Event::modify, [](Notification) {});
+            router.eventMaskFor("/srv/team");
+        }
+    });
+
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 1000; ++i) {
+        auto path = "/srv/team" + std::to_string(i % 10) + "/a";
+        router.route(i % 10, Notification { Event::modify, path, now });
+    }
+    subscriber.join();
+
+    BOOST_CHECK_EQUAL(1000, calls);
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), router.eventMaskFor("/srv/team0"));
+}
@@ -0,0 +1,152 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/WatchHub.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <thread>
+
+using namespace inotify;
+
+struct WatchHubTests {
+    WatchHubTests()
+        : testDirectory_("hubTestDirectory")
+        , subDirectory_(testDirectory_ / "sub")
+        , timeout_(1)
+    {
+        inotifypp::filesystem::create_directories(subDirectory_);
+    }
+
+    ~WatchHubTests()
+    {
+        inotifypp::filesystem::remove_all(testDirectory_);
+    }
+
+    WatchSubscription subscription(
+        inotifypp::filesystem::path root, Event events, std::promise<Notification>& promise)
+    {
+        WatchSubscription subscription;
+        subscription.roots = { root };
+        subscription.events = events;
+        subscription.observer = [&promise](Notification notification) {
+            try {
+                promise.set_value(notification);
+            } catch (const std::future_error&) {
+            }
+        };
+        return subscription;
+    }
+
+    void createFile(const inotifypp::filesystem::path& file)
+    {
+        std::ofstream stream(file.string());
+    }
+
+    inotifypp::filesystem::path testDirectory_;
+    inotifypp::filesystem::path subDirectory_;
+    std::chrono::seconds timeout_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldShareWatchesOfOverlappingSubscribers, WatchHubTests)
+{
+    WatchHub hub;
+    std::promise<Notification> promisedTreeCreate;
+    std::promise<Notification> promisedSubModify;
+
+    auto tree = hub.subscribe(subscription(testDirectory_, Event::create, promisedTreeCreate));
+    auto sub = hub.subscribe(subscription(subDirectory_, Event::modify, promisedSubModify));
+
+    BOOST_CHECK_EQUAL(2u, hub.getSubscriberCount());
+    BOOST_CHECK_EQUAL(2u, hub.getWatchCount());
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_CREATE), hub.getWatchMask(testDirectory_));
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_CREATE | IN_MODIFY), hub.getWatchMask(subDirectory_));
+
+    {
+        std::ofstream stream((subDirectory_ / "file").string());
+        stream << "content";
+    }
+
+    auto futureTreeCreate = promisedTreeCreate.get_future();
+    auto futureSubModify = promisedSubModify.get_future();
+    BOOST_CHECK(futureTreeCreate.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureTreeCreate.get().path == subDirectory_ / "file");
+    BOOST_CHECK(futureSubModify.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureSubModify.get().event == Event::modify);
+
+    hub.unsubscribe(tree);
+    BOOST_CHECK_EQUAL(1u, hub.getWatchCount());
+    BOOST_CHECK_EQUAL(0u, hub.getWatchMask(testDirectory_));
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), hub.getWatchMask(subDirectory_));
+
+    hub.unsubscribe(sub);
+    BOOST_CHECK_EQUAL(0u, hub.getWatchCount());
+    BOOST_CHECK_EQUAL(0u, hub.getWatchMask(subDirectory_));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldFanOutToMatchingSubscribersOnly, WatchHubTests)
+{
+    WatchHub hub;
+    std::promise<Notification> promisedLog;
+    std::promise<Notification> promisedOther;
+    std::atomic<int> otherNotifications { 0 };
+
+    auto logSubscription = subscription(testDirectory_, Event::create, promisedLog);
+    logSubscription.nameFilter = NameFilter().includeExtension(".log");
+    hub.subscribe(logSubscription);
+
+    auto otherSubscription = subscription(subDirectory_, Event::create, promisedOther);
+    otherSubscription.observer = [&](Notification) { ++otherNotifications; };
+    hub.subscribe(otherSubscription);
+
+    createFile(testDirectory_ / "ignored.txt");
+    createFile(testDirectory_ / "app.log");
+
+    auto futureLog = promisedLog.get_future();
+    BOOST_CHECK(futureLog.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureLog.get().path == testDirectory_ / "app.log");
+    BOOST_CHECK_EQUAL(0, otherNotifications);
+}
+
+BOOST_AUTO_TEST_CASE(shouldShareProcessHub)
+{
+    auto hub = WatchHub::processHub();
+    BOOST_CHECK(hub == WatchHub::processHub());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldInstallWatchesOfUnmountSubscribers, WatchHubTests)
+{
+    WatchHub hub;
+    std::promise<Notification> promisedUnmount;
+
+    auto id = hub.subscribe(subscription(testDirectory_, Event::unmount, promisedUnmount));
+
+    BOOST_CHECK_EQUAL(
+        static_cast<std::uint32_t>(IN_DELETE_SELF), hub.getWatchMask(testDirectory_));
+
+    hub.unsubscribe(id);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepWatchOfConcurrentResubscription, WatchHubTests)
+{
+    WatchHub hub;
+    std::promise<Notification> promisedFirst;
+    std::promise<Notification> promisedSecond;
+
+    auto churn = [&](std::promise<Notification>& promise) {
+        for (int i = 0; i < 200; ++i) {
+            hub.unsubscribe(hub.subscribe(subscription(subDirectory_, Event::modify, promise)));
+        }
+    };
+    std::thread first([&]() { churn(promisedFirst); });
+    std::thread second([&]() { churn(promisedSecond); });
+    auto id = hub.subscribe(subscription(subDirectory_, Event::modify, promisedFirst));
+    first.join();
+    second.join();
+
+    BOOST_CHECK_EQUAL(1u, hub.getWatchCount());
+    BOOST_CHECK_EQUAL(static_cast<std::uint32_t>(IN_MODIFY), hub.getWatchMask(subDirectory_));
+    hub.unsubscribe(id);
+}
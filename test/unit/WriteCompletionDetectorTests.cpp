@@ -0,0 +1,72 @@
+#include <boost/test/unit_test.hpp>
+
+#include <inotify-cpp/WriteCompletionDetector.h>
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace inotify;
+
+struct WriteCompletionDetectorTests {
+    WriteCompletionDetectorTests()
+        : file_("upload.bin")
+        , quietPeriod_(50)
+        , timeout_(1)
+    {
+    }
+
+    Notification notification(Event event)
+    {
+        return Notification(event, file_, std::chrono::steady_clock::now());
+    }
+
+    inotifypp::filesystem::path file_;
+    std::chrono::milliseconds quietPeriod_;
+    std::chrono::seconds timeout_;
+    std::promise<Notification> promisedSettled_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldSettleOnceAfterLastWriterClosed, WriteCompletionDetectorTests)
+{
+    WriteCompletionDetector detector(
+        quietPeriod_, [&](Notification notification) { promisedSettled_.set_value(notification); });
+
+    detector.add(notification(Event::create));
+    detector.add(notification(Event::open));
+    detector.add(notification(Event::open));
+    detector.add(notification(Event::modify));
+    detector.add(notification(Event::close_write));
+
+    // The second writer keeps the file open beyond the quiet period
+    std::this_thread::sleep_for(quietPeriod_ * 2);
+    BOOST_CHECK_EQUAL(0u, detector.getSettledFileCount());
+
+    detector.add(notification(Event::modify));
+    detector.add(notification(Event::close_write));
+
+    auto futureSettled = promisedSettled_.get_future();
+    BOOST_REQUIRE(futureSettled.wait_for(timeout_) == std::future_status::ready);
+    auto settled = futureSettled.get();
+    BOOST_CHECK(settled.path == file_);
+    BOOST_CHECK(settled.event == Event::close_write);
+    BOOST_CHECK_EQUAL(1u, detector.getSettledFileCount());
+    BOOST_CHECK_EQUAL(0u, detector.getTrackedFileCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldForgetRemovedAndReadOnlyFiles, WriteCompletionDetectorTests)
+{
+    WriteCompletionDetector detector(
+        quietPeriod_, [&](Notification notification) { promisedSettled_.set_value(notification); });
+
+    detector.add(notification(Event::open));
+    detector.add(notification(Event::close_nowrite));
+    BOOST_CHECK_EQUAL(0u, detector.getTrackedFileCount());
+
+    detector.add(notification(Event::create));
+    detector.add(notification(Event::remove));
+    BOOST_CHECK_EQUAL(0u, detector.getTrackedFileCount());
+
+    std::this_thread::sleep_for(quietPeriod_ * 2);
+    BOOST_CHECK_EQUAL(0u, detector.getSettledFileCount());
+}